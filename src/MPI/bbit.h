@@ -0,0 +1,43 @@
+#ifndef MULTICOREMINHASH_BBIT_H
+#define MULTICOREMINHASH_BBIT_H
+
+#include <stdint.h>
+
+/**
+ * Number of 32-bit words storing a signature whose rows are reduced to their low b bits
+ * (rows are packed, 32 / b per word, and never straddle two words).
+ *
+ * @param signature_size Number of rows in a signature
+ * @param bbit Bits kept of each row (1, 2, 4 or 8; 0 keeps the whole rows)
+ * @return The number of words
+ */
+static inline int bbit_words(const int signature_size, const int bbit) {
+	return bbit ? (signature_size * bbit + 31) / 32 : signature_size;
+}
+
+/**
+ * Pack the rows of consecutive signatures to their low b bits, in place: the packed signature of row i
+ * is stored at i * bbit_words(signature_size, bbit) words from the start of the matrix.
+ *
+ * @param p_signature_matrix Signature matrix, with full rows on input and packed ones on output
+ * @param n_docs Number of signatures
+ * @param signature_size Number of rows in a signature
+ * @param bbit Bits kept of each row (1, 2, 4 or 8)
+ */
+void bbit_pack(uint32_t *p_signature_matrix, int n_docs, int signature_size, int bbit);
+
+/**
+ * Estimate the similarity of two packed signatures. <br>
+ * Equal rows are counted with XOR and popcount (a row differs if any of its b bits does),
+ * then corrected for the rows that are equal by chance: b random bits collide with probability 2^-b,
+ * so the similarity is (equal fraction - 2^-b) / (1 - 2^-b), clamped at 0.
+ *
+ * @param p_signature1 First packed signature
+ * @param p_signature2 Second packed signature
+ * @param signature_size Number of rows in a signature
+ * @param bbit Bits kept of each row (1, 2, 4 or 8)
+ * @return The estimated similarity
+ */
+float bbit_similarity(const uint32_t *p_signature1, const uint32_t *p_signature2, int signature_size, int bbit);
+
+#endif //MULTICOREMINHASH_BBIT_H
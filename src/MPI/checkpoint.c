@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+#include "utils.h"
+
+// Identifies a state file ("MHCK" and format version)
+#define CHECKPOINT_MAGIC 0x4d48434b
+#define CHECKPOINT_VERSION 3
+
+/**
+ * Beginning of the state file, followed by the completion flag of each row.
+ */
+struct CheckpointHeader {
+	uint32_t magic;
+	uint32_t version;
+	// Arguments the rows and the results depend on
+	int n_docs;
+	int doc_offset;
+	int shingle_size;
+	int shingle_mode;
+	int hash;
+	int signature_size;
+	int bbit;
+	int dedup;
+	int seed;
+	int n_band_rows;
+	int band_key;
+	float threshold;
+	// Rows owned by the process
+	int rank;
+	int n_procs;
+	int first_row;
+	int n_rows;
+	// Comparison progress
+	int compare_next;
+	long csv_size;
+};
+
+/**
+ * Fill the header describing a checkpoint.
+ */
+static void ckpt_fill_header(const struct Checkpoint *ckpt, struct CheckpointHeader *header);
+
+/**
+ * Save the state (the lock must be held).
+ */
+static void ckpt_save_locked(struct Checkpoint *ckpt);
+
+/**
+ * Load the saved state, if any. Returns false if there is no saved state.
+ */
+static bool ckpt_load_state(struct Checkpoint *ckpt);
+
+struct Checkpoint *ckpt_open(struct Arguments args, int rank, int n_procs, int first_row, int n_rows) {
+
+	struct Checkpoint *ckpt = calloc(1, sizeof(struct Checkpoint));
+
+	ckpt->args = args;
+	ckpt->rank = rank;
+	ckpt->n_procs = n_procs;
+	ckpt->first_row = first_row;
+	ckpt->n_rows = n_rows;
+	ckpt->row_size = args.signature_size;
+	ckpt->p_done = calloc(n_rows > 0 ? n_rows : 1, sizeof(uint8_t));
+	ckpt->compare_next = 0;
+	ckpt->csv_size = 0;
+	ckpt->interval = args.checkpoint_interval;
+	ckpt->last_save = wall_time();
+	pthread_mutex_init(&ckpt->lock, NULL);
+
+	// Every process may be the first one to create the directory
+	if (mkdir(args.checkpoint_dir, 0755) != 0 && errno != EEXIST) {
+		printf("Error creating checkpoint directory %s\n", args.checkpoint_dir);
+		exit(2);
+	}
+
+	const size_t path_len = strlen(args.checkpoint_dir) + 32;
+	ckpt->rows_path = malloc(path_len);
+	ckpt->state_path = malloc(path_len);
+	snprintf(ckpt->rows_path, path_len, "%s/rank_%d.rows", args.checkpoint_dir, rank);
+	snprintf(ckpt->state_path, path_len, "%s/rank_%d.state", args.checkpoint_dir, rank);
+
+	// Saved rows are kept only if resuming from a saved state
+	const bool resumed = args.resume && ckpt_load_state(ckpt);
+
+	ckpt->fd_rows = open(ckpt->rows_path, resumed ? O_RDWR | O_CREAT : O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (ckpt->fd_rows < 0) {
+		printf("Error opening checkpoint file %s\n", ckpt->rows_path);
+		exit(2);
+	}
+
+	if (args.verbose && resumed)
+		printf("[Rank %2d] Resuming: %d of %d rows computed, compared up to document %d\n",
+			   rank, ckpt->n_done, n_rows, ckpt->compare_next + args.doc_offset);
+
+	return ckpt;
+}
+
+bool ckpt_row_done(const struct Checkpoint *ckpt, int row) {
+	return ckpt->p_done[row];
+}
+
+void ckpt_load_rows(struct Checkpoint *ckpt, uint32_t *p_rows) {
+
+	const size_t row_bytes = ckpt->row_size * sizeof(uint32_t);
+
+	// Read runs of consecutive complete rows at once
+	for (int row = 0; row < ckpt->n_rows;) {
+
+		if (!ckpt->p_done[row]) {
+			++row;
+			continue;
+		}
+
+		int end = row;
+		while (end < ckpt->n_rows && ckpt->p_done[end])
+			++end;
+
+		size_t size = (end - row) * row_bytes;
+		off_t offset = (off_t) row * row_bytes;
+		char *p_dest = (char *) (p_rows + (size_t) row * ckpt->row_size);
+
+		while (size > 0) {
+			ssize_t n_read = pread(ckpt->fd_rows, p_dest, size, offset);
+
+			if (n_read <= 0) {
+				printf("Error reading checkpoint file %s\n", ckpt->rows_path);
+				exit(2);
+			}
+
+			p_dest += n_read;
+			size -= n_read;
+			offset += n_read;
+		}
+
+		row = end;
+	}
+
+}
+
+void ckpt_row_computed(struct Checkpoint *ckpt, int row, const uint32_t *p_row) {
+
+	const size_t row_bytes = ckpt->row_size * sizeof(uint32_t);
+
+	// Rows don't overlap, so they are written outside the lock
+	if (pwrite(ckpt->fd_rows, p_row, row_bytes, (off_t) row * row_bytes) != (ssize_t) row_bytes) {
+		printf("Error writing checkpoint file %s\n", ckpt->rows_path);
+		exit(2);
+	}
+
+	pthread_mutex_lock(&ckpt->lock);
+
+	ckpt->p_done[row] = 1;
+	ckpt->n_done++;
+
+	if (wall_time() - ckpt->last_save >= ckpt->interval)
+		ckpt_save_locked(ckpt);
+
+	pthread_mutex_unlock(&ckpt->lock);
+
+}
+
+void ckpt_compare_progress(struct Checkpoint *ckpt, int next_row, FILE *f_csv, bool force) {
+
+	if (!force && wall_time() - ckpt->last_save < ckpt->interval)
+		return;
+
+	// Results must be on disk before they are recorded
+	fflush(f_csv);
+	fsync(fileno(f_csv));
+
+	pthread_mutex_lock(&ckpt->lock);
+
+	ckpt->compare_next = next_row;
+	ckpt->csv_size = ftell(f_csv);
+	ckpt_save_locked(ckpt);
+
+	pthread_mutex_unlock(&ckpt->lock);
+
+}
+
+FILE *ckpt_reopen_csv(struct Checkpoint *ckpt, const char *path) {
+
+	// Drop results written after the last save
+	if (truncate(path, ckpt->csv_size) != 0) {
+		printf("Error truncating file %s\n", path);
+		exit(2);
+	}
+
+	FILE *f_csv = fopen(path, "a");
+
+	if (f_csv == NULL) {
+		printf("Error opening file %s\n", path);
+		exit(2);
+	}
+
+	fseek(f_csv, 0, SEEK_END);
+
+	return f_csv;
+}
+
+void ckpt_save(struct Checkpoint *ckpt) {
+
+	pthread_mutex_lock(&ckpt->lock);
+	ckpt_save_locked(ckpt);
+	pthread_mutex_unlock(&ckpt->lock);
+
+}
+
+void ckpt_close(struct Checkpoint *ckpt, bool remove_files) {
+
+	close(ckpt->fd_rows);
+
+	if (remove_files) {
+		unlink(ckpt->rows_path);
+		unlink(ckpt->state_path);
+
+		// Fails while other processes still have files in it
+		rmdir(ckpt->args.checkpoint_dir);
+	}
+
+	pthread_mutex_destroy(&ckpt->lock);
+	free(ckpt->rows_path);
+	free(ckpt->state_path);
+	free(ckpt->p_done);
+	free(ckpt);
+
+}
+
+static void ckpt_fill_header(const struct Checkpoint *ckpt, struct CheckpointHeader *header) {
+
+	// Zero the padding too, as headers are compared with memcmp
+	memset(header, 0, sizeof(struct CheckpointHeader));
+
+	header->magic = CHECKPOINT_MAGIC;
+	header->version = CHECKPOINT_VERSION;
+	header->n_docs = ckpt->args.n_docs;
+	header->doc_offset = ckpt->args.doc_offset;
+	header->shingle_size = ckpt->args.shingle_size;
+	header->shingle_mode = ckpt->args.shingle_mode;
+	header->hash = ckpt->args.hash;
+	header->signature_size = ckpt->args.signature_size;
+	header->bbit = ckpt->args.bbit;
+	header->dedup = ckpt->args.dedup;
+	header->seed = ckpt->args.seed;
+	header->n_band_rows = ckpt->args.n_band_rows;
+	header->band_key = ckpt->args.band_key;
+	header->threshold = ckpt->args.threshold;
+	header->rank = ckpt->rank;
+	header->n_procs = ckpt->n_procs;
+	header->first_row = ckpt->first_row;
+	header->n_rows = ckpt->n_rows;
+	header->compare_next = ckpt->compare_next;
+	header->csv_size = ckpt->csv_size;
+
+}
+
+static void ckpt_save_locked(struct Checkpoint *ckpt) {
+
+	struct CheckpointHeader header;
+	ckpt_fill_header(ckpt, &header);
+
+	// Rows marked as complete must be on disk before the state
+	fdatasync(ckpt->fd_rows);
+
+	// Write the new state aside, then replace the old one
+	char tmp_path[strlen(ckpt->state_path) + 5];
+	sprintf(tmp_path, "%s.tmp", ckpt->state_path);
+
+	FILE *f_state = fopen(tmp_path, "wb");
+
+	if (f_state == NULL) {
+		printf("Error opening checkpoint file %s\n", tmp_path);
+		exit(2);
+	}
+
+	if (fwrite(&header, sizeof(header), 1, f_state) != 1 ||
+		fwrite(ckpt->p_done, sizeof(uint8_t), ckpt->n_rows, f_state) != (size_t) ckpt->n_rows ||
+		fflush(f_state) != 0 || fsync(fileno(f_state)) != 0) {
+		printf("Error writing checkpoint file %s\n", tmp_path);
+		exit(2);
+	}
+
+	fclose(f_state);
+
+	if (rename(tmp_path, ckpt->state_path) != 0) {
+		printf("Error writing checkpoint file %s\n", ckpt->state_path);
+		exit(2);
+	}
+
+	ckpt->last_save = wall_time();
+
+}
+
+static bool ckpt_load_state(struct Checkpoint *ckpt) {
+
+	FILE *f_state = fopen(ckpt->state_path, "rb");
+
+	// Nothing saved yet
+	if (f_state == NULL)
+		return false;
+
+	struct CheckpointHeader saved, expected;
+	ckpt_fill_header(ckpt, &expected);
+
+	if (fread(&saved, sizeof(saved), 1, f_state) != 1) {
+		printf("Error reading checkpoint file %s\n", ckpt->state_path);
+		exit(2);
+	}
+
+	// Progress is the only thing that can differ
+	struct CheckpointHeader saved_args = saved;
+	saved_args.compare_next = 0;
+	saved_args.csv_size = 0;
+
+	if (memcmp(&saved_args, &expected, sizeof(struct CheckpointHeader)) != 0) {
+		printf("The checkpoint in %s was saved with different arguments.\n", ckpt->args.checkpoint_dir);
+		exit(1);
+	}
+
+	if (fread(ckpt->p_done, sizeof(uint8_t), ckpt->n_rows, f_state) != (size_t) ckpt->n_rows) {
+		printf("Error reading checkpoint file %s\n", ckpt->state_path);
+		exit(2);
+	}
+
+	fclose(f_state);
+
+	for (int row = 0; row < ckpt->n_rows; ++row)
+		ckpt->n_done += ckpt->p_done[row];
+
+	ckpt->compare_next = saved.compare_next;
+	ckpt->csv_size = saved.csv_size;
+
+	return true;
+}
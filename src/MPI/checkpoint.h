@@ -0,0 +1,127 @@
+#ifndef MULTICOREMINHASH_CHECKPOINT_H
+#define MULTICOREMINHASH_CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "structures.h"
+
+// Number of rows compared between two checks of the checkpoint interval
+#define CHECKPOINT_COMPARE_ROWS 64
+
+/**
+ * Progress of a run, saved periodically to a directory so that the run can be resumed after a crash. <br>
+ * Each process owns a range of signature rows: computed rows are written to a rows file,
+ * while a state file records which rows are complete and how far the comparison went
+ * (the rows compared so far and the size of the CSV file at that point). <br>
+ * The state file is replaced atomically, and only after the rows it marks as complete are on disk.
+ */
+struct Checkpoint {
+	// Paths of the rows and state files
+	char *rows_path;
+	char *state_path;
+	// Rows file
+	int fd_rows;
+	// Owner process and its range of rows (document indices)
+	int rank;
+	int n_procs;
+	int first_row;
+	int n_rows;
+	// Number of uint32_t in a row
+	int row_size;
+	// Whether each row is complete (indices relative to first_row)
+	uint8_t *p_done;
+	// Number of complete rows
+	int n_done;
+	// Rows before this one (document index) are compared, and their results are in the first csv_size bytes
+	int compare_next;
+	long csv_size;
+	// Seconds between two saves, and time of the last save
+	double interval;
+	double last_save;
+	// Guards the state, as rows are completed by several threads
+	pthread_mutex_t lock;
+	// Arguments the saved work depends on
+	struct Arguments args;
+};
+
+/**
+ * Open the checkpoint of a process, creating the checkpoint directory if needed.
+ * If resuming and a saved state exists, it is loaded (the program exits if it doesn't match the arguments),
+ * otherwise the checkpoint starts empty.
+ *
+ * @param args Algorithm's arguments (checkpoint_dir, resume and checkpoint_interval are used)
+ * @param rank Index of the process
+ * @param n_procs Number of processes
+ * @param first_row Index of the first document owned by the process
+ * @param n_rows Number of documents owned by the process
+ * @return The opened checkpoint, to be closed with ckpt_close
+ */
+struct Checkpoint *ckpt_open(struct Arguments args, int rank, int n_procs, int first_row, int n_rows);
+
+/**
+ * Returns whether a row was completed (in this run or in the resumed one).
+ *
+ * @param ckpt The checkpoint
+ * @param row Row index, relative to the first row of the process
+ * @return True if the row is complete
+ */
+bool ckpt_row_done(const struct Checkpoint *ckpt, int row);
+
+/**
+ * Copy the rows completed by the resumed run into the signature matrix.
+ *
+ * @param ckpt The checkpoint
+ * @param p_rows Signature rows of the process
+ */
+void ckpt_load_rows(struct Checkpoint *ckpt, uint32_t *p_rows);
+
+/**
+ * Record a computed row, saving the state if the checkpoint interval has elapsed.
+ * Can be called by several threads at once.
+ *
+ * @param ckpt The checkpoint
+ * @param row Row index, relative to the first row of the process
+ * @param p_row Signature of the row
+ */
+void ckpt_row_computed(struct Checkpoint *ckpt, int row, const uint32_t *p_row);
+
+/**
+ * Record the comparison progress if the checkpoint interval has elapsed (or if forced).
+ * The CSV file is flushed to disk before its size is recorded.
+ *
+ * @param ckpt The checkpoint
+ * @param next_row Rows before this one (document index) are compared and their results written
+ * @param f_csv Open CSV file where the results are written
+ * @param force Whether to save regardless of the interval
+ */
+void ckpt_compare_progress(struct Checkpoint *ckpt, int next_row, FILE *f_csv, bool force);
+
+/**
+ * Open the CSV file of a resumed comparison: results written after the last save are discarded
+ * and new ones are appended.
+ *
+ * @param ckpt The checkpoint
+ * @param path Path of the CSV file
+ * @return The open CSV file
+ */
+FILE *ckpt_reopen_csv(struct Checkpoint *ckpt, const char *path);
+
+/**
+ * Save the state, regardless of the interval.
+ *
+ * @param ckpt The checkpoint
+ */
+void ckpt_save(struct Checkpoint *ckpt);
+
+/**
+ * Close the checkpoint, and optionally delete its files (once the run is complete).
+ *
+ * @param ckpt The checkpoint
+ * @param remove_files Whether to delete the files
+ */
+void ckpt_close(struct Checkpoint *ckpt, bool remove_files);
+
+#endif //MULTICOREMINHASH_CHECKPOINT_H
@@ -0,0 +1,103 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "collective.h"
+
+struct CollectiveReader *collective_open(struct Arguments args) {
+
+	struct CollectiveReader *reader = calloc(1, sizeof(struct CollectiveReader));
+
+	reader->pack = args.doc_pack;
+	reader->loader = loader_create(args, 1);
+
+	// Reads go through the aggregators even if the ranges are contiguous (ROMIO hints, ignored by others)
+	MPI_Info info;
+	char aggregators[16];
+
+	sprintf(aggregators, "%d", args.collective_io);
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "romio_cb_read", "enable");
+	MPI_Info_set(info, "cb_nodes", aggregators);
+
+	if (MPI_File_open(MPI_COMM_WORLD, args.pack, MPI_MODE_RDONLY, info, &reader->file) != MPI_SUCCESS) {
+		printf("Error opening pack %s with MPI-IO\n", args.pack);
+		exit(2);
+	}
+
+	MPI_Info_free(&info);
+
+	return reader;
+}
+
+void collective_read(struct CollectiveReader *reader, const int *doc_numbers, struct DocBuffer **buffers, int count) {
+
+	const struct DocPack *pack = reader->pack;
+	long first = LONG_MAX, end = 0;
+
+	// Byte range of the documents of the batch
+	for (int k = 0; k < count; ++k) {
+
+		const int index = doc_numbers[k] - pack->first_doc;
+
+		if (index < 0 || index >= pack->n_docs || pack->p_offsets[index] < 0) {
+			printf("Error: document %d is not in the index of %s\n", doc_numbers[k], pack->path);
+			exit(2);
+		}
+
+		if (pack->p_offsets[index] < first)
+			first = pack->p_offsets[index];
+		if (pack->p_offsets[index] + pack->p_sizes[index] > end)
+			end = pack->p_offsets[index] + pack->p_sizes[index];
+	}
+
+	const size_t size = count > 0 ? (size_t) (end - first) : 0;
+
+	if (size > INT_MAX) {
+		printf("Error: batch of %zu bytes too large for a collective read, use a smaller --batch\n", size);
+		exit(2);
+	}
+
+	if (size > reader->capacity) {
+		reader->p_range = realloc(reader->p_range, size);
+		reader->capacity = size;
+	}
+
+	// Every process takes part, even without documents
+	MPI_Status status;
+	int n_read;
+
+	MPI_File_read_at_all(reader->file, count > 0 ? (MPI_Offset) first : 0, reader->p_range, (int) size, MPI_BYTE,
+						 &status);
+	MPI_Get_count(&status, MPI_BYTE, &n_read);
+
+	if ((size_t) n_read != size) {
+		printf("Error reading %zu bytes from %s at %ld\n", size, pack->path, first);
+		exit(2);
+	}
+
+	reader->n_reads++;
+	reader->bytes += (double) size;
+
+	// Cut the documents out of the range
+	char name[32];
+
+	for (int k = 0; k < count; ++k) {
+
+		const int index = doc_numbers[k] - pack->first_doc;
+
+		sprintf(name, "%d", doc_numbers[k]);
+		loader_decode(reader->loader, reader->p_range + (pack->p_offsets[index] - first),
+					  (size_t) pack->p_sizes[index], name, buffers[k]);
+	}
+
+}
+
+void collective_close(struct CollectiveReader *reader) {
+
+	MPI_File_close(&reader->file);
+	loader_destroy(reader->loader);
+	free(reader->p_range);
+	free(reader);
+
+}
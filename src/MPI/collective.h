@@ -0,0 +1,59 @@
+#ifndef MULTICOREMINHASH_COLLECTIVE_H
+#define MULTICOREMINHASH_COLLECTIVE_H
+
+#include <mpi/mpi.h>
+
+#include "structures.h"
+#include "doc_loader.h"
+
+/**
+ * Reader of the packed corpus shared by all the processes through MPI-IO. <br>
+ * The pack is opened once by all the processes, and each batch is a single collective read
+ * (MPI_File_read_at_all) of the byte range of every process: the aggregator processes read the ranges
+ * in a few large requests and send each process its part, so the file system never sees an open per document.
+ * Documents of a batch are then cut out of the range (and decompressed) by their process.
+ */
+struct CollectiveReader {
+	MPI_File file;
+	// Index of the pack
+	const struct DocPack *pack;
+	// Loader decompressing the documents cut out of the ranges
+	struct DocLoader *loader;
+	// Byte range of the current batch
+	char *p_range;
+	size_t capacity;
+	// Collective reads and bytes read by the current process
+	int n_reads;
+	double bytes;
+};
+
+/**
+ * Open the pack of the arguments for collective reads, with args.collective_io aggregators. <br>
+ * Collective: all processes must call it.
+ *
+ * @param args Algorithm's arguments (pack, doc_pack, compression and collective_io are used)
+ * @return The reader, to be closed with collective_close
+ */
+struct CollectiveReader *collective_open(struct Arguments args);
+
+/**
+ * Read a batch of documents of the pack into the given buffers, decompressed. <br>
+ * Collective: all processes must call it the same number of times, with no documents if they have none left.
+ * Documents of a batch should be next to each other in the pack, since their whole range is read.
+ *
+ * @param reader The reader
+ * @param doc_numbers Numbers of the documents to load
+ * @param buffers Buffers where to load each document
+ * @param count Number of documents (0 to only take part in the read)
+ */
+void collective_read(struct CollectiveReader *reader, const int *doc_numbers, struct DocBuffer **buffers, int count);
+
+/**
+ * Close the pack and free the reader. <br>
+ * Collective: all processes must call it.
+ *
+ * @param reader The reader
+ */
+void collective_close(struct CollectiveReader *reader);
+
+#endif //MULTICOREMINHASH_COLLECTIVE_H
@@ -0,0 +1,828 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "doc_loader.h"
+
+// Initial size of a document buffer
+#define MIN_BUFFER_CAPACITY (64UL * 1024UL)
+
+// Compressed bytes read at once
+#define COMPRESSED_CHUNK (64UL * 1024UL)
+
+/**
+ * Minimal io_uring instance, driven directly through the system calls (no liburing needed).
+ */
+struct URing {
+	int fd;
+	// Submission queue ring
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	// Completion queue ring
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	// Mapped memory
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	size_t sqes_size;
+	// Queued requests not yet submitted to the kernel
+	unsigned to_submit;
+};
+
+struct DocLoader {
+	// Maximum number of documents in a batch
+	int batch_size;
+	// Whether the io_uring instance is in use
+	bool use_uring;
+	struct URing ring;
+	// Paths and descriptors of the current batch
+	char *paths;
+	size_t path_len;
+	int *fds;
+	// Bytes requested by the pending read of each document
+	size_t *requested;
+	// Compression of the documents, and the packed corpus they are read from (NULL = one file per document)
+	enum Compression compression;
+	const struct DocPack *pack;
+	// Chunk of compressed bytes being decompressed
+	unsigned char *p_chunk;
+	// Decompression state, reset for each document
+	z_stream inflater;
+#ifdef HAVE_ZSTD
+	ZSTD_DCtx *zstd;
+#endif
+};
+
+/**
+ * Create an io_uring instance and check that it supports all the needed operations.
+ *
+ * @param ring Ring to initialize
+ * @param entries Number of submission queue entries
+ * @return True if the ring is usable, false otherwise
+ */
+static bool uring_setup(struct URing *ring, unsigned entries);
+
+/**
+ * Release the io_uring instance.
+ *
+ * @param ring Ring to release
+ */
+static void uring_teardown(struct URing *ring);
+
+/**
+ * Get the next free submission queue entry (zeroed), tagged with the given user data.
+ * The entry is queued once uring_push is called.
+ *
+ * @param ring The ring
+ * @param user_data Value returned in the request's completion
+ * @return The entry to fill
+ */
+static struct io_uring_sqe *uring_sqe(struct URing *ring, unsigned user_data);
+
+/**
+ * Make the last entry returned by uring_sqe visible to the kernel.
+ *
+ * @param ring The ring
+ */
+static void uring_push(struct URing *ring);
+
+/**
+ * Submit all queued requests and wait until the given number of completions is available.
+ *
+ * @param ring The ring
+ * @param wait_nr Number of completions to wait for
+ */
+static void uring_submit_and_wait(struct URing *ring, unsigned wait_nr);
+
+/**
+ * Pop a completion from the completion queue.
+ *
+ * @param ring The ring
+ * @param p_user_data Address where to store the request's user data
+ * @return The request's result
+ */
+static int uring_pop(struct URing *ring, unsigned *p_user_data);
+
+/**
+ * Make sure a buffer can hold at least the given number of bytes.
+ *
+ * @param buffer The buffer
+ * @param capacity Minimum capacity
+ */
+static void buffer_reserve(struct DocBuffer *buffer, size_t capacity);
+
+/**
+ * Load a batch of documents using io_uring: all opens are submitted at once, then all reads, then all closes.
+ */
+static void loader_read_uring(struct DocLoader *loader, struct DocBuffer **buffers, int count);
+
+/**
+ * Load a document of the pack.
+ */
+static void loader_read_packed(struct DocLoader *loader, int doc_number, struct DocBuffer *buffer);
+
+/**
+ * Read the bytes of a file from offset up to end (-1 = end of file), decompressing them into a buffer.
+ *
+ * @param loader The loader
+ * @param fd Descriptor of the file
+ * @param offset Offset of the first compressed byte
+ * @param end Offset after the last compressed byte (-1 = end of file)
+ * @param name Name of the document, for the errors
+ * @param buffer Buffer where to store the decompressed content
+ */
+static void read_compressed(struct DocLoader *loader, int fd, off_t offset, off_t end, const char *name,
+							struct DocBuffer *buffer);
+
+/**
+ * Start decompressing a document into an empty buffer.
+ */
+static void decoder_reset(struct DocLoader *loader, struct DocBuffer *buffer);
+
+/**
+ * Decompress the next chunk of a document into its buffer.
+ *
+ * @return Whether the last member (or frame) of the document is complete
+ */
+static bool decode_chunk(struct DocLoader *loader, const unsigned char *p_chunk, size_t size, const char *name,
+						 struct DocBuffer *buffer);
+
+/**
+ * Inflate the next chunk of a gzip document into its buffer (the chunk is the next input of the inflater).
+ *
+ * @return Whether the last member of the document is complete
+ */
+static bool inflate_chunk(z_stream *inflater, const char *name, struct DocBuffer *buffer);
+
+#ifdef HAVE_ZSTD
+
+/**
+ * Decompress the next chunk of a Zstandard document into its buffer.
+ *
+ * @return Whether the last frame of the document is complete
+ */
+static bool zstd_chunk(ZSTD_DCtx *zstd, const void *p_chunk, size_t size, const char *name,
+					   struct DocBuffer *buffer);
+
+#endif
+
+struct DocLoader *loader_create(struct Arguments args, int batch_size) {
+
+	struct DocLoader *loader = calloc(1, sizeof(struct DocLoader));
+
+	loader->batch_size = batch_size;
+	loader->fds = calloc(batch_size, sizeof(int));
+	loader->requested = calloc(batch_size, sizeof(size_t));
+	loader->compression = args.compression;
+	loader->pack = args.doc_pack;
+
+	if (args.compression != COMPRESSION_NONE)
+		loader->p_chunk = malloc(COMPRESSED_CHUNK);
+
+	// Either gzip or zlib headers (15 window bits, +32 to detect the header)
+	if (args.compression == COMPRESSION_GZIP && inflateInit2(&loader->inflater, 15 + 32) != Z_OK) {
+		printf("Error initializing zlib\n");
+		exit(2);
+	}
+
+#ifdef HAVE_ZSTD
+	if (args.compression == COMPRESSION_ZSTD)
+		loader->zstd = ZSTD_createDCtx();
+#endif
+
+	// Fall back to pread if io_uring is not available (it only loads plain document files)
+	if (args.io_backend == IO_URING && args.compression == COMPRESSION_NONE && !args.doc_pack)
+		loader->use_uring = uring_setup(&loader->ring, (unsigned) batch_size);
+
+	return loader;
+}
+
+bool loader_uses_uring(const struct DocLoader *loader) {
+	return loader->use_uring;
+}
+
+void loader_read(struct DocLoader *loader, const char *directory, const int *doc_numbers,
+				 struct DocBuffer **buffers, int count) {
+
+	// Documents of the pack don't have a path
+	if (loader->pack) {
+		for (int i = 0; i < count; ++i)
+			loader_read_packed(loader, doc_numbers[i], buffers[i]);
+		return;
+	}
+
+	// Grow paths buffer if the directory changed
+	size_t path_len = strlen(directory) + 20UL;
+	if (path_len > loader->path_len) {
+		loader->path_len = path_len;
+		loader->paths = realloc(loader->paths, path_len * loader->batch_size);
+	}
+
+	// Compute the path of the document files (they are numbered)
+	for (int i = 0; i < count; ++i)
+		sprintf(loader->paths + i * loader->path_len, "%s/%d%s", directory, doc_numbers[i],
+				loader_suffix(loader->compression));
+
+	if (loader->use_uring) {
+		loader_read_uring(loader, buffers, count);
+		return;
+	}
+
+	// Compressed documents are decompressed while they are read
+	if (loader->compression != COMPRESSION_NONE) {
+		for (int i = 0; i < count; ++i) {
+
+			const char *path = loader->paths + i * loader->path_len;
+			int fd = open(path, O_RDONLY);
+
+			if (fd < 0) {
+				printf("Error opening file %s\n", path);
+				exit(2);
+			}
+
+			read_compressed(loader, fd, 0, -1, path, buffers[i]);
+			close(fd);
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; ++i)
+		read_file_to_buffer(loader->paths + i * loader->path_len, buffers[i]);
+
+}
+
+static void loader_read_uring(struct DocLoader *loader, struct DocBuffer **buffers, int count) {
+
+	struct URing *ring = &loader->ring;
+	unsigned user_data;
+	int res;
+
+	// Open all documents
+	for (int i = 0; i < count; ++i) {
+		struct io_uring_sqe *sqe = uring_sqe(ring, i);
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (unsigned long) (loader->paths + i * loader->path_len);
+		sqe->open_flags = O_RDONLY;
+		uring_push(ring);
+	}
+
+	uring_submit_and_wait(ring, count);
+
+	for (int i = 0; i < count; ++i) {
+		res = uring_pop(ring, &user_data);
+
+		// Check if file was opened
+		if (res < 0) {
+			printf("Error opening file %s\n", loader->paths + user_data * loader->path_len);
+			exit(2);
+		}
+
+		loader->fds[user_data] = res;
+	}
+
+	// Read all documents, reading again the ones that filled their buffer
+	for (int i = 0; i < count; ++i) {
+		buffers[i]->size = 0;
+		buffer_reserve(buffers[i], MIN_BUFFER_CAPACITY);
+	}
+
+	int pending = count;
+	for (int i = 0; i < count; ++i) {
+		struct io_uring_sqe *sqe = uring_sqe(ring, i);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = loader->fds[i];
+		sqe->addr = (unsigned long) buffers[i]->data;
+		sqe->len = (unsigned) buffers[i]->capacity;
+		sqe->off = 0;
+		loader->requested[i] = buffers[i]->capacity;
+		uring_push(ring);
+	}
+
+	while (pending > 0) {
+
+		uring_submit_and_wait(ring, pending);
+
+		int completed = pending;
+		for (int k = 0; k < completed; ++k) {
+			res = uring_pop(ring, &user_data);
+			struct DocBuffer *buffer = buffers[user_data];
+
+			if (res < 0) {
+				printf("Error reading file %s\n", loader->paths + user_data * loader->path_len);
+				exit(2);
+			}
+
+			buffer->size += res;
+
+			// A short read means the end of the file was reached
+			if ((size_t) res < loader->requested[user_data]) {
+				pending--;
+				continue;
+			}
+
+			// Buffer is full, grow it and read the rest
+			buffer_reserve(buffer, buffer->capacity * 2);
+
+			struct io_uring_sqe *sqe = uring_sqe(ring, user_data);
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = loader->fds[user_data];
+			sqe->addr = (unsigned long) (buffer->data + buffer->size);
+			sqe->len = (unsigned) (buffer->capacity - buffer->size);
+			sqe->off = buffer->size;
+			loader->requested[user_data] = buffer->capacity - buffer->size;
+			uring_push(ring);
+		}
+	}
+
+	// Close all documents
+	for (int i = 0; i < count; ++i) {
+		struct io_uring_sqe *sqe = uring_sqe(ring, i);
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd = loader->fds[i];
+		uring_push(ring);
+	}
+
+	uring_submit_and_wait(ring, count);
+
+	for (int i = 0; i < count; ++i)
+		uring_pop(ring, &user_data);
+
+}
+
+static void loader_read_packed(struct DocLoader *loader, int doc_number, struct DocBuffer *buffer) {
+
+	const struct DocPack *pack = loader->pack;
+	const int index = doc_number - pack->first_doc;
+
+	// Check that the index locates the document
+	if (index < 0 || index >= pack->n_docs || pack->p_offsets[index] < 0) {
+		printf("Error: document %d is not in the index of %s\n", doc_number, pack->path);
+		exit(2);
+	}
+
+	const off_t offset = pack->p_offsets[index];
+	const size_t size = (size_t) pack->p_sizes[index];
+
+	if (loader->compression != COMPRESSION_NONE) {
+		char name[32];
+		sprintf(name, "%d", doc_number);
+		read_compressed(loader, pack->fd, offset, offset + (off_t) size, name, buffer);
+		return;
+	}
+
+	buffer_reserve(buffer, size);
+	buffer->size = 0;
+
+	while (buffer->size < size) {
+
+		ssize_t n_read = pread(pack->fd, buffer->data + buffer->size, size - buffer->size,
+							   offset + (off_t) buffer->size);
+
+		if (n_read <= 0) {
+			printf("Error reading document %d from %s\n", doc_number, pack->path);
+			exit(2);
+		}
+
+		buffer->size += n_read;
+	}
+
+}
+
+static void read_compressed(struct DocLoader *loader, int fd, off_t offset, off_t end, const char *name,
+							struct DocBuffer *buffer) {
+
+	bool complete = false;
+
+	decoder_reset(loader, buffer);
+
+	// Only a chunk of compressed bytes is in memory at once
+	while (end < 0 || offset < end) {
+
+		const size_t chunk = (end >= 0 && (size_t) (end - offset) < COMPRESSED_CHUNK) ? (size_t) (end - offset)
+																					   : COMPRESSED_CHUNK;
+		ssize_t n_read = pread(fd, loader->p_chunk, chunk, offset);
+
+		if (n_read < 0 || (n_read == 0 && end >= 0)) {
+			printf("Error reading file %s\n", name);
+			exit(2);
+		}
+
+		if (n_read == 0)
+			break;
+
+		offset += n_read;
+		complete = decode_chunk(loader, loader->p_chunk, (size_t) n_read, name, buffer);
+	}
+
+	if (!complete) {
+		printf("Error decompressing file %s: truncated\n", name);
+		exit(2);
+	}
+
+}
+
+void loader_decode(struct DocLoader *loader, const char *data, size_t size, const char *name,
+				   struct DocBuffer *buffer) {
+
+	if (loader->compression == COMPRESSION_NONE) {
+		buffer_reserve(buffer, size);
+		memcpy(buffer->data, data, size);
+		buffer->size = size;
+		return;
+	}
+
+	bool complete = false;
+
+	decoder_reset(loader, buffer);
+
+	for (size_t done = 0; done < size; done += COMPRESSED_CHUNK)
+		complete = decode_chunk(loader, (const unsigned char *) data + done,
+								size - done < COMPRESSED_CHUNK ? size - done : COMPRESSED_CHUNK, name, buffer);
+
+	if (!complete) {
+		printf("Error decompressing file %s: truncated\n", name);
+		exit(2);
+	}
+
+}
+
+static void decoder_reset(struct DocLoader *loader, struct DocBuffer *buffer) {
+
+	buffer_reserve(buffer, MIN_BUFFER_CAPACITY);
+	buffer->size = 0;
+
+	if (loader->compression == COMPRESSION_GZIP)
+		inflateReset(&loader->inflater);
+#ifdef HAVE_ZSTD
+	else
+		ZSTD_DCtx_reset(loader->zstd, ZSTD_reset_session_only);
+#endif
+
+}
+
+static bool decode_chunk(struct DocLoader *loader, const unsigned char *p_chunk, size_t size, const char *name,
+						 struct DocBuffer *buffer) {
+
+	if (loader->compression == COMPRESSION_GZIP) {
+		loader->inflater.next_in = (Bytef *) p_chunk;
+		loader->inflater.avail_in = (uInt) size;
+		return inflate_chunk(&loader->inflater, name, buffer);
+	}
+
+#ifdef HAVE_ZSTD
+	return zstd_chunk(loader->zstd, p_chunk, size, name, buffer);
+#else
+	return false;
+#endif
+}
+
+static bool inflate_chunk(z_stream *inflater, const char *name, struct DocBuffer *buffer) {
+
+	bool complete = false;
+
+	// Inflate until the chunk is consumed and no output is pending (a full buffer may hide some)
+	do {
+
+		if (buffer->size == buffer->capacity)
+			buffer_reserve(buffer, buffer->capacity * 2);
+
+		const uInt avail_in = inflater->avail_in;
+		const size_t avail_out = buffer->capacity - buffer->size;
+
+		inflater->next_out = (Bytef *) (buffer->data + buffer->size);
+		inflater->avail_out = avail_out < UINT32_MAX ? (uInt) avail_out : UINT32_MAX;
+
+		int ret = inflate(inflater, Z_NO_FLUSH);
+		buffer->size = (char *) inflater->next_out - buffer->data;
+
+		if (ret == Z_STREAM_END) {
+			// Another member may follow (concatenated gzip files)
+			complete = true;
+			inflateReset(inflater);
+		} else if (ret == Z_OK) {
+			if (inflater->avail_in < avail_in)
+				complete = false;
+		} else if (ret != Z_BUF_ERROR) {
+			printf("Error decompressing file %s: %s\n", name, inflater->msg ? inflater->msg : "invalid data");
+			exit(2);
+		}
+
+	} while (inflater->avail_in > 0 || inflater->avail_out == 0);
+
+	return complete;
+}
+
+#ifdef HAVE_ZSTD
+
+static bool zstd_chunk(ZSTD_DCtx *zstd, const void *p_chunk, size_t size, const char *name,
+					   struct DocBuffer *buffer) {
+
+	ZSTD_inBuffer input = {p_chunk, size, 0};
+	size_t ret;
+
+	// Decompress until the chunk is consumed and no output is pending (frames follow each other)
+	do {
+
+		if (buffer->size == buffer->capacity)
+			buffer_reserve(buffer, buffer->capacity * 2);
+
+		ZSTD_outBuffer output = {buffer->data, buffer->capacity, buffer->size};
+		ret = ZSTD_decompressStream(zstd, &output, &input);
+		buffer->size = output.pos;
+
+		if (ZSTD_isError(ret)) {
+			printf("Error decompressing file %s: %s\n", name, ZSTD_getErrorName(ret));
+			exit(2);
+		}
+
+	} while (input.pos < input.size || buffer->size == buffer->capacity);
+
+	// A frame is complete once it is decoded and flushed
+	return ret == 0;
+}
+
+#endif
+
+const char *loader_suffix(enum Compression compression) {
+	return (const char *[]) {".txt", ".txt.gz", ".txt.zst"}[compression];
+}
+
+struct DocPack *pack_open(const char *path, int first_doc, int n_docs) {
+
+	struct DocPack *pack = malloc(sizeof(struct DocPack));
+
+	pack->path = path;
+	pack->first_doc = first_doc;
+	pack->n_docs = n_docs;
+	pack->p_offsets = malloc((n_docs > 0 ? n_docs : 1) * sizeof(long));
+	pack->p_sizes = malloc((n_docs > 0 ? n_docs : 1) * sizeof(long));
+	pack->fd = open(path, O_RDONLY);
+
+	if (pack->fd < 0) {
+		printf("Error opening pack %s\n", path);
+		exit(2);
+	}
+
+	for (int i = 0; i < n_docs; ++i)
+		pack->p_offsets[i] = pack->p_sizes[i] = -1;
+
+	// Index lines: document number, offset and size in bytes
+	char index_path[strlen(path) + 5];
+	sprintf(index_path, "%s.idx", path);
+
+	FILE *f_index = fopen(index_path, "r");
+
+	if (f_index == NULL) {
+		printf("Error opening index %s\n", index_path);
+		exit(2);
+	}
+
+	int doc_number;
+	long offset, size;
+
+	while (fscanf(f_index, "%d %ld %ld", &doc_number, &offset, &size) == 3)
+		if (doc_number >= first_doc && doc_number - first_doc < n_docs) {
+			pack->p_offsets[doc_number - first_doc] = offset;
+			pack->p_sizes[doc_number - first_doc] = size;
+		}
+
+	fclose(f_index);
+
+	return pack;
+}
+
+void pack_close(struct DocPack *pack) {
+
+	close(pack->fd);
+	free(pack->p_offsets);
+	free(pack->p_sizes);
+	free(pack);
+
+}
+
+void loader_destroy(struct DocLoader *loader) {
+
+	if (loader->use_uring)
+		uring_teardown(&loader->ring);
+
+	if (loader->compression == COMPRESSION_GZIP)
+		inflateEnd(&loader->inflater);
+#ifdef HAVE_ZSTD
+	if (loader->zstd)
+		ZSTD_freeDCtx(loader->zstd);
+#endif
+
+	free(loader->p_chunk);
+	free(loader->paths);
+	free(loader->fds);
+	free(loader->requested);
+	free(loader);
+
+}
+
+void read_file_to_buffer(const char *filepath, struct DocBuffer *buffer) {
+
+	int fd = open(filepath, O_RDONLY);
+
+	// Check if file was opened
+	if (fd < 0) {
+		printf("Error opening file %s\n", filepath);
+		exit(2);
+	}
+
+	// Reserve the whole file (plus one byte, to detect a file that grew)
+	struct stat st;
+	fstat(fd, &st);
+	buffer_reserve(buffer, (size_t) st.st_size + 1UL);
+
+	buffer->size = 0;
+
+	while (1) {
+
+		ssize_t n_read = pread(fd, buffer->data + buffer->size, buffer->capacity - buffer->size, (off_t) buffer->size);
+
+		if (n_read <= 0)
+			break;
+
+		buffer->size += n_read;
+
+		// Grow buffer when full
+		if (buffer->size == buffer->capacity)
+			buffer_reserve(buffer, buffer->capacity * 2);
+	}
+
+	close(fd);
+
+}
+
+static void buffer_reserve(struct DocBuffer *buffer, size_t capacity) {
+
+	if (buffer->capacity >= capacity)
+		return;
+
+	if (capacity < MIN_BUFFER_CAPACITY)
+		capacity = MIN_BUFFER_CAPACITY;
+
+	buffer->data = realloc(buffer->data, capacity);
+	buffer->capacity = capacity;
+
+}
+
+static bool uring_setup(struct URing *ring, unsigned entries) {
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	memset(ring, 0, sizeof(struct URing));
+
+	int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0)
+		return false;
+
+	ring->fd = fd;
+
+	// Map the rings (a single mapping holds both if supported)
+	ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->sq_size)
+			ring->sq_size = ring->cq_size;
+		ring->cq_size = 0;
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+						IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	if (ring->cq_size) {
+		ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+							IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) {
+			munmap(ring->sq_ptr, ring->sq_size);
+			close(fd);
+			return false;
+		}
+	} else
+		ring->cq_ptr = ring->sq_ptr;
+
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+					  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		if (ring->cq_size)
+			munmap(ring->cq_ptr, ring->cq_size);
+		munmap(ring->sq_ptr, ring->sq_size);
+		close(fd);
+		return false;
+	}
+
+	ring->sq_tail = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.array);
+	ring->cq_head = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.head);
+	ring->cq_tail = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ptr + params.cq_off.cqes);
+
+	// Check that the kernel knows all the needed operations
+	const int n_probe_ops = IORING_OP_CLOSE + 1;
+	struct io_uring_probe *probe = calloc(1, sizeof(struct io_uring_probe)
+											 + n_probe_ops * sizeof(struct io_uring_probe_op));
+
+	bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, n_probe_ops) == 0
+					 && probe->last_op >= IORING_OP_CLOSE
+					 && (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED)
+					 && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+					 && (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED);
+
+	free(probe);
+
+	if (!supported)
+		uring_teardown(ring);
+
+	return supported;
+}
+
+static void uring_teardown(struct URing *ring) {
+
+	munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_size)
+		munmap(ring->cq_ptr, ring->cq_size);
+	munmap(ring->sq_ptr, ring->sq_size);
+	close(ring->fd);
+
+}
+
+static struct io_uring_sqe *uring_sqe(struct URing *ring, unsigned user_data) {
+
+	unsigned index = *ring->sq_tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->user_data = user_data;
+	ring->sq_array[index] = index;
+
+	return sqe;
+}
+
+static void uring_push(struct URing *ring) {
+
+	// Publish the entry only after it was completely written
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+	ring->to_submit++;
+
+}
+
+static void uring_submit_and_wait(struct URing *ring, unsigned wait_nr) {
+
+	while (syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait_nr, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+		// Keep waiting only if interrupted
+		if (errno != EINTR) {
+			perror("io_uring_enter");
+			exit(2);
+		}
+		ring->to_submit = 0;
+	}
+
+	ring->to_submit = 0;
+
+}
+
+static int uring_pop(struct URing *ring, unsigned *p_user_data) {
+
+	unsigned head = *ring->cq_head;
+
+	// Completions were waited for with uring_submit_and_wait
+	while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE));
+
+	struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+	*p_user_data = (unsigned) cqe->user_data;
+	int res = cqe->res;
+
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return res;
+}
@@ -0,0 +1,371 @@
+#include <string.h>
+
+#include "hash.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HASH_X86
+#include <nmmintrin.h>
+#endif
+
+/*
+ * XXH3, following the reference implementation (xxhash.h, version 0.8).
+ */
+
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+#define XXH_PRIME_MX1 0x165667919E3779F9ULL
+#define XXH_PRIME_MX2 0x9FB21C651E98DF25ULL
+
+// Sizes of the long input loop
+#define XXH_SECRET_SIZE 192
+#define XXH_STRIPE_LEN 64
+#define XXH_SECRET_CONSUME_RATE 8
+#define XXH_SECRET_LASTACC_START 7
+#define XXH_SECRET_MERGEACCS_START 11
+#define XXH_MIDSIZE_STARTOFFSET 3
+#define XXH_MIDSIZE_LASTOFFSET 17
+#define XXH_SECRET_SIZE_MIN 136
+
+/**
+ * Default secret of XXH3 (seeded hashes of long inputs derive theirs from it).
+ */
+static const uint8_t xxh3_secret[XXH_SECRET_SIZE] = {
+		0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+		0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+		0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+		0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+		0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+		0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+		0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+		0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+		0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+		0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+		0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+		0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+	const __uint128_t product = (__uint128_t) a * b;
+	return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h) {
+	h ^= h >> 37;
+	h *= XXH_PRIME_MX1;
+	return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len) {
+	h ^= rotl64(h, 49) ^ rotl64(h, 24);
+	h *= XXH_PRIME_MX2;
+	h ^= (h >> 35) + len;
+	h *= XXH_PRIME_MX2;
+	return h ^ (h >> 28);
+}
+
+static inline uint64_t xxh3_mix16(const uint8_t *p, const uint8_t *secret, uint64_t seed) {
+	return mul128_fold64(read64(p) ^ (read64(secret) + seed), read64(p + 8) ^ (read64(secret + 8) - seed));
+}
+
+static uint64_t xxh3_len_0to16(const uint8_t *p, size_t len, uint64_t seed) {
+
+	const uint8_t *secret = xxh3_secret;
+
+	if (len > 8) {
+		const uint64_t bitflip1 = (read64(secret + 24) ^ read64(secret + 32)) + seed;
+		const uint64_t bitflip2 = (read64(secret + 40) ^ read64(secret + 48)) - seed;
+		const uint64_t input_lo = read64(p) ^ bitflip1;
+		const uint64_t input_hi = read64(p + len - 8) ^ bitflip2;
+		const uint64_t acc = len + __builtin_bswap64(input_lo) + input_hi + mul128_fold64(input_lo, input_hi);
+		return xxh3_avalanche(acc);
+	}
+
+	if (len >= 4) {
+		seed ^= (uint64_t) __builtin_bswap32((uint32_t) seed) << 32;
+		const uint64_t bitflip = (read64(secret + 8) ^ read64(secret + 16)) - seed;
+		const uint64_t input = read32(p + len - 4) + ((uint64_t) read32(p) << 32);
+		return xxh3_rrmxmx(input ^ bitflip, len);
+	}
+
+	if (len > 0) {
+		const uint32_t combined = ((uint32_t) p[0] << 16) | ((uint32_t) p[len >> 1] << 24) | (uint32_t) p[len - 1]
+								  | ((uint32_t) len << 8);
+		const uint64_t bitflip = (read32(secret) ^ read32(secret + 4)) + seed;
+		return xxh64_avalanche((uint64_t) combined ^ bitflip);
+	}
+
+	return xxh64_avalanche(seed ^ (read64(secret + 56) ^ read64(secret + 64)));
+}
+
+static uint64_t xxh3_len_17to128(const uint8_t *p, size_t len, uint64_t seed) {
+
+	const uint8_t *secret = xxh3_secret;
+	uint64_t acc = len * XXH_PRIME64_1;
+
+	if (len > 32) {
+		if (len > 64) {
+			if (len > 96) {
+				acc += xxh3_mix16(p + 48, secret + 96, seed);
+				acc += xxh3_mix16(p + len - 64, secret + 112, seed);
+			}
+			acc += xxh3_mix16(p + 32, secret + 64, seed);
+			acc += xxh3_mix16(p + len - 48, secret + 80, seed);
+		}
+		acc += xxh3_mix16(p + 16, secret + 32, seed);
+		acc += xxh3_mix16(p + len - 32, secret + 48, seed);
+	}
+	acc += xxh3_mix16(p, secret, seed);
+	acc += xxh3_mix16(p + len - 16, secret + 16, seed);
+
+	return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_129to240(const uint8_t *p, size_t len, uint64_t seed) {
+
+	const uint8_t *secret = xxh3_secret;
+	const int n_rounds = (int) len / 16;
+	uint64_t acc = len * XXH_PRIME64_1;
+
+	for (int i = 0; i < 8; ++i)
+		acc += xxh3_mix16(p + 16 * i, secret + 16 * i, seed);
+	acc = xxh3_avalanche(acc);
+
+	for (int i = 8; i < n_rounds; ++i)
+		acc += xxh3_mix16(p + 16 * i, secret + 16 * (i - 8) + XXH_MIDSIZE_STARTOFFSET, seed);
+
+	acc += xxh3_mix16(p + len - 16, secret + XXH_SECRET_SIZE_MIN - XXH_MIDSIZE_LASTOFFSET, seed);
+
+	return xxh3_avalanche(acc);
+}
+
+static inline void xxh3_accumulate_512(uint64_t *acc, const uint8_t *p, const uint8_t *secret) {
+
+	for (int i = 0; i < 8; ++i) {
+		const uint64_t value = read64(p + 8 * i);
+		const uint64_t key = value ^ read64(secret + 8 * i);
+		acc[i ^ 1] += value;
+		acc[i] += (uint64_t) (uint32_t) key * (key >> 32);
+	}
+
+}
+
+static inline void xxh3_scramble(uint64_t *acc, const uint8_t *secret) {
+
+	for (int i = 0; i < 8; ++i) {
+		uint64_t a = acc[i];
+		a ^= a >> 47;
+		a ^= read64(secret + 8 * i);
+		acc[i] = a * XXH_PRIME32_1;
+	}
+
+}
+
+static uint64_t xxh3_long(const uint8_t *p, size_t len, uint64_t seed) {
+
+	// Secret of the seed
+	uint8_t secret[XXH_SECRET_SIZE];
+
+	for (int i = 0; i < XXH_SECRET_SIZE / 16; ++i) {
+		const uint64_t lo = read64(xxh3_secret + 16 * i) + seed;
+		const uint64_t hi = read64(xxh3_secret + 16 * i + 8) - seed;
+		memcpy(secret + 16 * i, &lo, sizeof(lo));
+		memcpy(secret + 16 * i + 8, &hi, sizeof(hi));
+	}
+
+	uint64_t acc[8] = {XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+					   XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1};
+
+	const size_t stripes_per_block = (XXH_SECRET_SIZE - XXH_STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+	const size_t block_len = XXH_STRIPE_LEN * stripes_per_block;
+	const size_t n_blocks = (len - 1) / block_len;
+
+	for (size_t b = 0; b < n_blocks; ++b) {
+		for (size_t s = 0; s < stripes_per_block; ++s)
+			xxh3_accumulate_512(acc, p + b * block_len + s * XXH_STRIPE_LEN, secret + s * XXH_SECRET_CONSUME_RATE);
+		xxh3_scramble(acc, secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN);
+	}
+
+	// Last partial block, and last stripe
+	const size_t n_stripes = ((len - 1) - block_len * n_blocks) / XXH_STRIPE_LEN;
+
+	for (size_t s = 0; s < n_stripes; ++s)
+		xxh3_accumulate_512(acc, p + n_blocks * block_len + s * XXH_STRIPE_LEN, secret + s * XXH_SECRET_CONSUME_RATE);
+
+	xxh3_accumulate_512(acc, p + len - XXH_STRIPE_LEN,
+						secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN - XXH_SECRET_LASTACC_START);
+
+	// Merge the accumulators
+	uint64_t result = len * XXH_PRIME64_1;
+
+	for (int i = 0; i < 4; ++i)
+		result += mul128_fold64(acc[2 * i] ^ read64(secret + XXH_SECRET_MERGEACCS_START + 16 * i),
+								acc[2 * i + 1] ^ read64(secret + XXH_SECRET_MERGEACCS_START + 16 * i + 8));
+
+	return xxh3_avalanche(result);
+}
+
+uint64_t xxh3_64(const void *key, size_t len, uint64_t seed) {
+
+	const uint8_t *p = (const uint8_t *) key;
+
+	if (len <= 16)
+		return xxh3_len_0to16(p, len, seed);
+	if (len <= 128)
+		return xxh3_len_17to128(p, len, seed);
+	if (len <= 240)
+		return xxh3_len_129to240(p, len, seed);
+
+	return xxh3_long(p, len, seed);
+}
+
+uint32_t hash_xxh3(const void *key, int len, uint32_t seed) {
+	return (uint32_t) xxh3_64(key, len, seed);
+}
+
+/*
+ * CRC32C
+ */
+
+/**
+ * CRC32C of every byte value (reflected polynomial 0x82F63B78).
+ */
+static const uint32_t crc32c_table[256] = {
+		0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+		0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+		0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+		0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+		0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+		0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+		0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+		0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+		0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+		0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+		0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+		0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+		0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+		0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+		0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+		0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+		0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+		0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+		0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+		0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+		0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+		0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+		0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+		0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+		0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+		0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+		0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+		0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+		0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+		0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+		0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+		0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+		0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+		0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+		0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+		0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+		0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+		0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+		0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+		0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+		0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+		0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+		0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
+};
+
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t len) {
+
+	const uint8_t *p = (const uint8_t *) data;
+
+	for (size_t k = 0; k < len; ++k)
+		crc = crc32c_table[(crc ^ p[k]) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#ifdef HASH_X86
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse42(uint32_t crc, const void *data, size_t len) {
+
+	const uint8_t *p = (const uint8_t *) data;
+	uint64_t crc64 = crc;
+	size_t k = 0;
+
+	for (; k + 8 <= len; k += 8)
+		crc64 = _mm_crc32_u64(crc64, read64(p + k));
+
+	crc = (uint32_t) crc64;
+
+	for (; k < len; ++k)
+		crc = _mm_crc32_u8(crc, p[k]);
+
+	return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+
+#ifdef HASH_X86
+	if (__builtin_cpu_supports("sse4.2"))
+		return crc32c_sse42(crc, data, len);
+#endif
+
+	return crc32c_software(crc, data, len);
+}
+
+uint32_t hash_crc32c(const void *key, int len, uint32_t seed) {
+
+	uint32_t h = crc32c(seed, key, len);
+
+	// MurmurHash3 finalizer
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	return h ^ (h >> 16);
+}
+
+hash_fn hash_select(enum HashFamily family) {
+
+	switch (family) {
+		case HASH_XXH3:
+			return hash_xxh3;
+		case HASH_CRC32C:
+			return hash_crc32c;
+		default:
+			return murmur_hash;
+	}
+
+}
@@ -3,7 +3,7 @@
 #include <string.h>
 
 #include "io_interface.h"
-#include "utils.h"
+#include "kernels.h"
 
 struct Arguments input_arguments(const int argc, const char *argv[]) {
 
@@ -11,12 +11,32 @@ struct Arguments input_arguments(const int argc, const char *argv[]) {
 	const char *help_msg = "Usage: %s "
 						   "[--offset <doc_offset>]"
 						   "[--shingle <shingle_size>] "
+						   "[--shingle-mode words|chars] "
+						   "[--hash murmur2|xxh3|crc32c] "
 						   "[--signature <signature_size>] "
+						   "[--bbit 0|1|2|4|8] "
+						   "[--dedup <0|1>] "
+						   "[--exact-dups <0|1>] "
 						   "[--docs <n_docs>] "
 						   "[--bandrows <n_band_rows>] "
+						   "[--bandkey xor|mix64] "
 						   "[--seed <seed>] "
 						   "[--verbose <step>] "
 						   "[--threshold <threshold>] "
+						   "[--io pread|uring] "
+						   "[--batch <io_batch>] "
+						   "[--compression none|gzip|zstd] "
+						   "[--pack <packed_corpus>] "
+						   "[--collective <n_aggregators>] "
+						   "[--shared-windows <0|1>] "
+						   "[--memory-limit <MB>] "
+						   "[--spill <spill_file>] "
+						   "[--checkpoint <checkpoint_dir>] "
+						   "[--checkpoint-interval <seconds>] "
+						   "[--resume <0|1>] "
+						   "[--schedule static|lpt] "
+						   "[--manifest <manifest_file>] "
+						   "[--plan <n_sample_docs>] "
 						   "<docs_directory>\n";
 
 	// Check if there are enough arguments
@@ -34,12 +54,64 @@ struct Arguments input_arguments(const int argc, const char *argv[]) {
 		else if (strcmp(argv[i], "--shingle") == 0)
 			args.shingle_size = atoi(argv[++i]);
 
+		else if (strcmp(argv[i], "--shingle-mode") == 0) {
+			i++;
+			if (strcmp(argv[i], "words") == 0)
+				args.shingle_mode = SHINGLE_WORDS;
+			else if (strcmp(argv[i], "chars") == 0)
+				args.shingle_mode = SHINGLE_CHARS;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
 		else if (strcmp(argv[i], "--signature") == 0)
 			args.signature_size = atoi(argv[++i]);
 
+		else if (strcmp(argv[i], "--bbit") == 0) {
+			args.bbit = atoi(argv[++i]);
+			if (args.bbit != 0 && args.bbit != 1 && args.bbit != 2 && args.bbit != 4 && args.bbit != 8) {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--dedup") == 0)
+			args.dedup = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--exact-dups") == 0)
+			args.exact_dups = atoi(argv[++i]);
+
 		else if (strcmp(argv[i], "--docs") == 0)
 			args.n_docs = atoi(argv[++i]);
 
+		else if (strcmp(argv[i], "--hash") == 0) {
+			i++;
+			if (strcmp(argv[i], "murmur2") == 0)
+				args.hash = HASH_MURMUR2;
+			else if (strcmp(argv[i], "xxh3") == 0)
+				args.hash = HASH_XXH3;
+			else if (strcmp(argv[i], "crc32c") == 0)
+				args.hash = HASH_CRC32C;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--bandkey") == 0) {
+			i++;
+			if (strcmp(argv[i], "xor") == 0)
+				args.band_key = BANDKEY_XOR;
+			else if (strcmp(argv[i], "mix64") == 0)
+				args.band_key = BANDKEY_MIX64;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
 		else if (strcmp(argv[i], "--bandrows") == 0)
 			args.n_band_rows = atoi(argv[++i]);
 
@@ -52,13 +124,84 @@ struct Arguments input_arguments(const int argc, const char *argv[]) {
 		else if (strcmp(argv[i], "--threshold") == 0)
 			args.threshold = (float) atof(argv[++i]);
 
+		else if (strcmp(argv[i], "--io") == 0) {
+			i++;
+			if (strcmp(argv[i], "pread") == 0)
+				args.io_backend = IO_PREAD;
+			else if (strcmp(argv[i], "uring") == 0)
+				args.io_backend = IO_URING;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--batch") == 0)
+			args.io_batch = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--compression") == 0) {
+			i++;
+			if (strcmp(argv[i], "none") == 0)
+				args.compression = COMPRESSION_NONE;
+			else if (strcmp(argv[i], "gzip") == 0)
+				args.compression = COMPRESSION_GZIP;
+			else if (strcmp(argv[i], "zstd") == 0)
+				args.compression = COMPRESSION_ZSTD;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--pack") == 0)
+			args.pack = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--collective") == 0)
+			args.collective_io = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--shared-windows") == 0)
+			args.shared_windows = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--memory-limit") == 0)
+			args.memory_limit = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--spill") == 0)
+			args.spill_path = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--checkpoint") == 0)
+			args.checkpoint_dir = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--checkpoint-interval") == 0)
+			args.checkpoint_interval = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--resume") == 0)
+			args.resume = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--schedule") == 0) {
+			i++;
+			if (strcmp(argv[i], "static") == 0)
+				args.schedule = SCHEDULE_STATIC;
+			else if (strcmp(argv[i], "lpt") == 0)
+				args.schedule = SCHEDULE_LPT;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--manifest") == 0)
+			args.manifest = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--plan") == 0)
+			args.plan = atoi(argv[++i]);
+
 		else {
 			args.directory = (char *) argv[i++];
 			break;
 		}
 
-	// Other arguments after directory
-	if (i != argc || !args.directory) {
+	// Other arguments after directory (not needed when reading a pack)
+	if (i != argc || (!args.directory && !args.pack)) {
 		printf(help_msg, argv[0]);
 		exit(1);
 	}
@@ -70,6 +213,73 @@ struct Arguments input_arguments(const int argc, const char *argv[]) {
 	}
 
 	args.n_bands = args.signature_size / args.n_band_rows;
+	args.kernels = kernels_select(args.signature_size, args.n_band_rows, args.band_key, args.hash);
+
+	// Check that documents can be loaded in batches
+	if (args.io_batch < 1) {
+		printf("The I/O batch size must be positive.\n");
+		exit(1);
+	}
+
+	// Check that documents can be decompressed
+#ifndef HAVE_ZSTD
+	if (args.compression == COMPRESSION_ZSTD) {
+		printf("Zstandard documents need the program compiled with zstd=1.\n");
+		exit(1);
+	}
+#endif
+
+	// Check that the pack can be read collectively (every process reads its consecutive documents together)
+	if (args.collective_io < 0) {
+		printf("The number of aggregators of the collective reads must be non-negative.\n");
+		exit(1);
+	}
+
+	if (args.collective_io > 0 && (!args.pack || args.schedule != SCHEDULE_STATIC || args.memory_limit > 0)) {
+		printf("Collective reads need a pack, the static schedule and the whole matrices in memory.\n");
+		exit(1);
+	}
+
+	// Check that the matrices can be shared (every process copies its consecutive rows into them)
+	if (args.shared_windows && (args.schedule != SCHEDULE_STATIC || args.memory_limit > 0)) {
+		printf("Shared windows need the static schedule and the whole matrices in memory.\n");
+		exit(1);
+	}
+
+	// Check that signatures can be packed
+	if (args.bbit && args.memory_limit > 0) {
+		printf("B-bit signatures are not supported in out-of-core mode.\n");
+		exit(1);
+	}
+
+	// Check that checkpoints can be taken
+	if (args.checkpoint_dir && args.memory_limit > 0) {
+		printf("Checkpointing is not supported in out-of-core mode.\n");
+		exit(1);
+	}
+
+	if (args.resume && !args.checkpoint_dir) {
+		printf("Resuming needs a checkpoint directory.\n");
+		exit(1);
+	}
+
+	// Check that processes own contiguous rows where it's needed
+	if (args.schedule == SCHEDULE_LPT && (args.checkpoint_dir || args.memory_limit > 0)) {
+		printf("The lpt schedule is not supported with checkpoints or in out-of-core mode.\n");
+		exit(1);
+	}
+
+	// Check that identical documents can be grouped before hashing
+	if (args.exact_dups && (args.checkpoint_dir || args.memory_limit > 0)) {
+		printf("Checkpointing and out-of-core mode are not supported with exact duplicates.\n");
+		exit(1);
+	}
+
+	// Check that the planned run has pairs to sample
+	if (args.plan < 0 || args.plan == 1) {
+		printf("The documents sampled by the plan must be 0 (disabled) or at least 2.\n");
+		exit(1);
+	}
 
 	return args;
 }
@@ -81,13 +291,36 @@ struct Arguments default_arguments() {
 	args.directory = NULL;
 	args.doc_offset = 0;
 	args.shingle_size = 3;
+	args.shingle_mode = SHINGLE_WORDS;
+	args.hash = HASH_MURMUR2;
 	args.signature_size = 100;
+	args.bbit = 0;
+	args.dedup = 0;
+	args.exact_dups = 0;
+	args.dups = NULL;
 	args.n_docs = 0;
 	args.n_band_rows = 4;
 	args.n_bands = args.signature_size / args.n_band_rows;
+	args.band_key = BANDKEY_XOR;
+	args.kernels = kernels_select(args.signature_size, args.n_band_rows, args.band_key, args.hash);
 	args.seed = 13;
 	args.verbose = 25;
 	args.threshold = .1f;
+	args.io_backend = IO_PREAD;
+	args.io_batch = 32;
+	args.compression = COMPRESSION_NONE;
+	args.pack = NULL;
+	args.doc_pack = NULL;
+	args.collective_io = 0;
+	args.shared_windows = 0;
+	args.memory_limit = 0;
+	args.spill_path = "minhash_spill.bin";
+	args.checkpoint_dir = NULL;
+	args.checkpoint_interval = 60;
+	args.resume = 0;
+	args.schedule = SCHEDULE_STATIC;
+	args.manifest = NULL;
+	args.plan = 0;
 
 	// MPI default values
 	args.proc.my_rank = 0;
@@ -101,81 +334,61 @@ struct Arguments default_arguments() {
 void print_arguments(struct Arguments args) {
 	printf("-----------------\n");
 	printf("[Using arguments]\n");
-	printf("- Directory: \"%s\"\n", args.directory);
+	if (args.pack)
+		printf("- Pack: \"%s\" (index \"%s.idx\")\n", args.pack, args.pack);
+	else
+		printf("- Directory: \"%s\"\n", args.directory);
 	printf("- Number of documents: %u\n", args.n_docs);
 	printf("- First document offset: %u\n", args.doc_offset);
 	printf("- Document displacement: %u\n", args.proc.doc_disp);
 	printf("- Shingle size: %u\n", args.shingle_size);
+	printf("- Shingle mode: %s\n", (const char *[]) {"words", "chars"}[args.shingle_mode]);
+	printf("- Hash: %s\n", (const char *[]) {"murmur2", "xxh3", "crc32c"}[args.hash]);
 	printf("- Signature size: %u\n", args.signature_size);
+	printf("- Bits per row: %d%s\n", args.bbit ? args.bbit : 32, args.bbit ? " (b-bit signatures)" : "");
+	printf("- Shingle dedup: %s\n", args.dedup ? "enabled" : "disabled");
+	printf("- Exact duplicates: %s\n", args.exact_dups ? "grouped" : "compared");
 	printf("- Number of rows per band: %u\n", args.n_band_rows);
 	printf("- Number of bands: %u\n", args.n_bands);
+	printf("- Band key: %s\n", (const char *[]) {"xor", "mix64"}[args.band_key]);
+	printf("- Kernels: %s\n", args.kernels->name);
 	printf("- Seed: %d\n", args.seed);
 	printf("- Verbose step: %u\n", args.verbose);
 	printf("- Threshold: %.2f\n", args.threshold);
+	printf("- I/O backend: %s\n", (const char *[]) {"pread", "uring"}[args.io_backend]);
+	printf("- I/O batch size: %d\n", args.io_batch);
+	printf("- Compression: %s\n", (const char *[]) {"none", "gzip", "zstd"}[args.compression]);
+	printf("- Collective reads: %d%s\n", args.collective_io, args.collective_io ? " aggregators" : " (pread)");
+	printf("- Matrices: %s\n", args.shared_windows ? "shared by the processes of a node" : "a copy per process");
+	printf("- Memory limit: %d MB%s\n", args.memory_limit, args.memory_limit ? "" : " (in memory)");
+	printf("- Spill file: \"%s\"\n", args.spill_path);
+	printf("- Checkpoint directory: %s\n", args.checkpoint_dir ? args.checkpoint_dir : "(disabled)");
+	printf("- Checkpoint interval: %d s\n", args.checkpoint_interval);
+	printf("- Resume: %d\n", args.resume);
+	printf("- Schedule: %s\n", (const char *[]) {"static", "lpt"}[args.schedule]);
+	printf("- Manifest: %s\n", args.manifest ? args.manifest : "(file system)");
+	printf("- Plan: %d%s\n", args.plan, args.plan ? " sampled documents" : " (run)");
 	printf("- Comm Size: %d\n", args.proc.comm_sz);
 	printf("-----------------\n");
 }
 
-char *read_word_from_file(FILE *p_file) {
-
-	char *buffer = malloc(1024); // 1KB buffer that holds read word
-	int words; // Number of characters read
-
-	do {
-		// Read word
-		words = fscanf(p_file, "%s", buffer);
-
-		// Handle reading failure (e.g. EOF)
-		if (words != 1)
-			return NULL;
-
-		// Process word (turn it lowercase and remove non-alphanumeric characters)
-		str_tolower_trim_nonalphanum(buffer);
-
-		// Keep reading until a valid word is found (len > 0)
-	} while (*buffer == '\0');
-
-	char *ret = strdup(buffer);
-	free(buffer);
-	return ret;
-}
-
-char *read_shingle_from_file(FILE *file, const unsigned int shingle_size, char **p_words) {
-
-	// Discard oldest word (if NULL free does no-op)
-	free(p_words[0]);
+void print_compare_stats(struct Arguments args, struct CompareStats stats) {
 
-	// Shift words
-	for (int i = 1; i < shingle_size; ++i)
-		p_words[i - 1] = p_words[i];
-	p_words[shingle_size - 1] = NULL;
+	const unsigned long n_pairs = (unsigned long) args.n_docs * (args.n_docs - 1) / 2;
+	const unsigned long n_false = stats.n_candidates - stats.n_similar;
 
-	// Check if all words are present
-	for (int i = 0; i < shingle_size; ++i)
-		if (!p_words[i])
-			// Read word if not present
-			p_words[i] = read_word_from_file(file);
+	printf("Candidate pairs: %lu of %lu pairs (%s band keys)\n", stats.n_candidates, n_pairs,
+		   (const char *[]) {"xor", "mix64"}[args.band_key]);
+	printf("- Below threshold (false candidates): %lu (%.2f%%)\n", n_false,
+		   stats.n_candidates ? 100.0 * n_false / stats.n_candidates : 0.0);
+	// Packed rows can't tell equal bands from key collisions
+	if (args.bbit)
+		printf("- Without equal bands (key collisions): not counted with b-bit signatures\n");
+	else
+		printf("- Without equal bands (key collisions): %lu (%.2f%%)\n", stats.n_collisions,
+			   stats.n_candidates ? 100.0 * stats.n_collisions / stats.n_candidates : 0.0);
 
-	// Error in reading file or EOF, no new shingle of given size
-	if (!p_words[shingle_size - 1])
-		return NULL;
-
-	// Compute string length of shingle
-	unsigned int shingle_strlen = shingle_size; // (shingle_size - 1) spaces + null terminator
-	for (int i = 0; i < shingle_size; ++i)
-		shingle_strlen += strlen(p_words[i]); // + word length
-
-	// Allocate memory for shingle
-	char *shingle = malloc(shingle_strlen);
-
-	// Build shingle from words
-	unsigned int offset = 0;
-	for (int i = 0; i < shingle_size; ++i) {
-		strcpy(shingle + offset, p_words[i]);
-		offset += strlen(p_words[i]);
-		shingle[offset++] = ' ';
-	}
-	shingle[offset - 1] = '\0';
+	if (args.exact_dups)
+		printf("Results of identical documents (not compared): %lu\n", stats.n_duplicates);
 
-	return shingle;
 }
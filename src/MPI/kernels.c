@@ -0,0 +1,316 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "signature.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#define KERNELS_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+/*
+ * Kernel bodies, inlined into each variant with constant sizes.
+ */
+
+/**
+ * Update a signature with the hashes of a shingle. <br>
+ * Computes the same MurmurHash2 values as murmur_hash(shingle, shingle_len, seed * i) for every row i,
+ * but block by block for all the rows at once: the mixed blocks don't depend on the row,
+ * and the per-row updates are independent lanes the compiler can vectorize.
+ */
+static inline __attribute__((always_inline)) void signature_update_body(
+		uint32_t *signature, const int signature_size, const void *shingle, const int shingle_len, const int seed
+) {
+
+	const uint32_t m = 0x5bd1e995;
+	const uint8_t *data = (const uint8_t *) shingle;
+
+	uint32_t h[signature_size];
+
+	for (int i = 0; i < signature_size; ++i)
+		h[i] = ((uint32_t) seed * (uint32_t) i) ^ (uint32_t) shingle_len;
+
+	// Body: one 4-byte block at a time
+	for (int b = 0; b + 4 <= shingle_len; b += 4) {
+
+		uint32_t k;
+		memcpy(&k, data + b, sizeof(k));
+		k *= m;
+		k ^= k >> 24;
+		k *= m;
+
+		for (int i = 0; i < signature_size; ++i)
+			h[i] = (h[i] * m) ^ k;
+	}
+
+	// Tail: last 1 to 3 bytes
+	const uint8_t *tail = data + (shingle_len & ~3);
+	uint32_t t = 0;
+
+	switch (shingle_len & 3) {
+		case 3:
+			t ^= tail[2] << 16;
+		case 2:
+			t ^= tail[1] << 8;
+		case 1:
+			t ^= tail[0];
+			for (int i = 0; i < signature_size; ++i)
+				h[i] = (h[i] ^ t) * m;
+	}
+
+	// Finalization, and keep the minimum
+	for (int i = 0; i < signature_size; ++i) {
+		uint32_t x = h[i];
+		x ^= x >> 13;
+		x *= m;
+		x ^= x >> 15;
+		signature[i] = x < signature[i] ? x : signature[i];
+	}
+
+}
+
+static inline __attribute__((always_inline)) void compute_bands_body(
+		const uint32_t *p_signature, uint64_t *p_bands, const int n_band_rows, const int n_bands,
+		const enum BandKey band_key
+) {
+
+	for (int j = 0; j < n_bands; ++j)
+		p_bands[j] = (band_key == BANDKEY_MIX64) ? band_key_mix64(p_signature + j * n_band_rows, n_band_rows)
+												 : band_key_xor(p_signature + j * n_band_rows, n_band_rows);
+
+}
+
+/**
+ * Check all the bands without an early exit, so that the loop is vectorized.
+ */
+static inline __attribute__((always_inline)) bool is_candidate_pair_body(
+		const uint64_t *p_bands1, const uint64_t *p_bands2, const int n_bands
+) {
+
+	int equal = 0;
+
+	for (int j = 0; j < n_bands; ++j)
+		equal |= p_bands1[j] == p_bands2[j];
+
+	return equal;
+}
+
+static inline __attribute__((always_inline)) uint32_t candidate_mask_body(
+		const uint64_t *p_bands1, const uint64_t *p_block, const int n_bands
+) {
+
+	uint32_t mask = 0;
+
+	for (int j = 0; j < n_bands; ++j) {
+
+		const uint64_t key = p_bands1[j];
+		const uint64_t *p_keys = p_block + j * KERNELS_BLOCK_DOCS;
+
+		for (int d = 0; d < KERNELS_BLOCK_DOCS; ++d)
+			mask |= (uint32_t) (p_keys[d] == key) << d;
+	}
+
+	return mask;
+}
+
+#ifdef KERNELS_X86
+/**
+ * Same as candidate_mask_body, written with intrinsics: compilers vectorize the loop above across bands
+ * (gathering the keys of a document) instead of across documents. <br>
+ * Each band key is broadcast and compared with the keys of 4 documents at a time.
+ */
+KERNELS_AVX2 static inline __attribute__((always_inline)) uint32_t candidate_mask_body_avx2(
+		const uint64_t *p_bands1, const uint64_t *p_block, const int n_bands
+) {
+
+	__m256i equal_low = _mm256_setzero_si256();
+	__m256i equal_high = _mm256_setzero_si256();
+
+	for (int j = 0; j < n_bands; ++j) {
+
+		const __m256i key = _mm256_set1_epi64x((long long) p_bands1[j]);
+		const uint64_t *p_keys = p_block + j * KERNELS_BLOCK_DOCS;
+
+		equal_low = _mm256_or_si256(equal_low, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) p_keys), key));
+		equal_high = _mm256_or_si256(equal_high,
+									 _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (p_keys + 4)), key));
+	}
+
+	return (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(equal_low))
+		   | (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(equal_high)) << 4;
+}
+#endif
+
+static inline __attribute__((always_inline)) float signature_similarity_body(
+		const uint32_t *p_signature1, const uint32_t *p_signature2, const int signature_size
+) {
+
+	int common = 0;
+
+	for (int i = 0; i < signature_size; ++i)
+		common += p_signature1[i] == p_signature2[i];
+
+	return (float) common / (float) signature_size;
+}
+
+/*
+ * Generic variants (the band kernel is the only one without an equivalent in utils).
+ */
+
+static void compute_bands_xor(const uint32_t *p_signature, uint64_t *p_bands, const int n_band_rows,
+							  const int n_bands) {
+	compute_bands_body(p_signature, p_bands, n_band_rows, n_bands, BANDKEY_XOR);
+}
+
+static void compute_bands_mix64(const uint32_t *p_signature, uint64_t *p_bands, const int n_band_rows,
+								const int n_bands) {
+	compute_bands_body(p_signature, p_bands, n_band_rows, n_bands, BANDKEY_MIX64);
+}
+
+static uint32_t candidate_mask(const uint64_t *p_bands1, const uint64_t *p_block, const int n_bands) {
+	return candidate_mask_body(p_bands1, p_block, n_bands);
+}
+
+// Number of hash families (see enum HashFamily)
+#define KERNELS_N_HASHES 3
+
+#define GENERIC_KERNELS(BANDS)                                                                                         \
+	{                                                                                                                  \
+		{"generic", signature_update, BANDS, is_candidate_pair, candidate_mask, signature_similarity},                \
+		{"generic xxh3", signature_update_xxh3, BANDS, is_candidate_pair, candidate_mask, signature_similarity},      \
+		{"generic crc32c", signature_update_crc32c, BANDS, is_candidate_pair, candidate_mask, signature_similarity}    \
+	}
+
+static const struct Kernels generic_kernels[][KERNELS_N_HASHES] = {
+		GENERIC_KERNELS(compute_bands_xor),
+		GENERIC_KERNELS(compute_bands_mix64),
+};
+
+/*
+ * Specialized variants: the functions of a signature size S and a number of band rows R,
+ * compiled for the baseline instruction set (suffix "") and for AVX2 (suffix "_avx2").
+ */
+
+#define DEFINE_SIGNATURE_KERNELS(S, SUFFIX, TARGET)                                                                   \
+	TARGET static void signature_update_##S##SUFFIX(uint32_t *signature, const int signature_size,                     \
+													const void *shingle, const int shingle_len, const int seed) {      \
+		signature_update_body(signature, S, shingle, shingle_len, seed);                                               \
+	}                                                                                                                  \
+	TARGET static float signature_similarity_##S##SUFFIX(const uint32_t *p_signature1, const uint32_t *p_signature2,  \
+														 const int signature_size) {                                   \
+		return signature_similarity_body(p_signature1, p_signature2, S);                                               \
+	}
+
+#define DEFINE_BAND_KERNELS(S, R, SUFFIX, TARGET)                                                                     \
+	TARGET static void compute_bands_xor_##S##_##R##SUFFIX(const uint32_t *p_signature, uint64_t *p_bands,             \
+														   const int n_band_rows, const int n_bands) {                 \
+		compute_bands_body(p_signature, p_bands, R, (S) / (R), BANDKEY_XOR);                                           \
+	}                                                                                                                  \
+	TARGET static void compute_bands_mix64_##S##_##R##SUFFIX(const uint32_t *p_signature, uint64_t *p_bands,           \
+															 const int n_band_rows, const int n_bands) {               \
+		compute_bands_body(p_signature, p_bands, R, (S) / (R), BANDKEY_MIX64);                                         \
+	}                                                                                                                  \
+	TARGET static bool is_candidate_pair_##S##_##R##SUFFIX(const uint64_t *p_bands1, const uint64_t *p_bands2,        \
+														   const int n_bands) {                                        \
+		return is_candidate_pair_body(p_bands1, p_bands2, (S) / (R));                                                  \
+	}                                                                                                                  \
+	TARGET static uint32_t candidate_mask_##S##_##R##SUFFIX(const uint64_t *p_bands1, const uint64_t *p_block,         \
+															const int n_bands) {                                       \
+		return candidate_mask_body##SUFFIX(p_bands1, p_block, (S) / (R));                                              \
+	}
+
+// Specialized signature sizes, and configurations (signature size, band rows dividing it)
+#define FOR_SIGNATURE_SIZES(X, SUFFIX, TARGET) X(100, SUFFIX, TARGET) X(200, SUFFIX, TARGET) X(300, SUFFIX, TARGET)
+#define FOR_CONFIGURATIONS(X, SUFFIX, TARGET)                                                                          \
+	X(100, 4, SUFFIX, TARGET) X(100, 5, SUFFIX, TARGET)                                                                \
+	X(200, 4, SUFFIX, TARGET) X(200, 5, SUFFIX, TARGET)                                                                \
+	X(300, 3, SUFFIX, TARGET) X(300, 4, SUFFIX, TARGET) X(300, 5, SUFFIX, TARGET)
+
+FOR_SIGNATURE_SIZES(DEFINE_SIGNATURE_KERNELS, , )
+FOR_CONFIGURATIONS(DEFINE_BAND_KERNELS, , )
+
+#ifdef KERNELS_X86
+FOR_SIGNATURE_SIZES(DEFINE_SIGNATURE_KERNELS, _avx2, KERNELS_AVX2)
+FOR_CONFIGURATIONS(DEFINE_BAND_KERNELS, _avx2, KERNELS_AVX2)
+#endif
+
+/**
+ * Kernels of a configuration, for both band keys and every hash family
+ * (only MurmurHash2 has a specialized signature update, the other families hash one row at a time).
+ */
+struct KernelVariant {
+	int signature_size;
+	int n_band_rows;
+	struct Kernels kernels[2][KERNELS_N_HASHES];
+};
+
+#define KERNEL_ENTRY(S, R, SUFFIX, NAME, BANDS, UPDATE)                                                                \
+	{#S "/" #R NAME, UPDATE, compute_bands_##BANDS##_##S##_##R##SUFFIX, is_candidate_pair_##S##_##R##SUFFIX,           \
+	 candidate_mask_##S##_##R##SUFFIX, signature_similarity_##S##SUFFIX}
+
+#define KERNEL_VARIANT(S, R, SUFFIX, NAME)                                                                             \
+	{S, R, {                                                                                                           \
+		{KERNEL_ENTRY(S, R, SUFFIX, NAME, xor, signature_update_##S##SUFFIX),                                          \
+		 KERNEL_ENTRY(S, R, SUFFIX, NAME " xxh3", xor, signature_update_xxh3),                                         \
+		 KERNEL_ENTRY(S, R, SUFFIX, NAME " crc32c", xor, signature_update_crc32c)},                                    \
+		{KERNEL_ENTRY(S, R, SUFFIX, NAME, mix64, signature_update_##S##SUFFIX),                                        \
+		 KERNEL_ENTRY(S, R, SUFFIX, NAME " xxh3", mix64, signature_update_xxh3),                                       \
+		 KERNEL_ENTRY(S, R, SUFFIX, NAME " crc32c", mix64, signature_update_crc32c)}                                   \
+	}},
+
+#define KERNEL_VARIANT_BASE(S, R, SUFFIX, TARGET) KERNEL_VARIANT(S, R, , "")
+#define KERNEL_VARIANT_AVX2(S, R, SUFFIX, TARGET) KERNEL_VARIANT(S, R, _avx2, " avx2")
+
+static const struct KernelVariant base_variants[] = {
+		FOR_CONFIGURATIONS(KERNEL_VARIANT_BASE, , )
+};
+
+#ifdef KERNELS_X86
+static const struct KernelVariant avx2_variants[] = {
+		FOR_CONFIGURATIONS(KERNEL_VARIANT_AVX2, , )
+};
+#endif
+
+const struct Kernels *kernels_select(const int signature_size, const int n_band_rows, const enum BandKey band_key,
+									 const enum HashFamily hash) {
+
+	const struct KernelVariant *p_variants = base_variants;
+
+#ifdef KERNELS_X86
+	if (__builtin_cpu_supports("avx2"))
+		p_variants = avx2_variants;
+#endif
+
+	const int n_variants = sizeof(base_variants) / sizeof(base_variants[0]);
+
+	for (int v = 0; v < n_variants; ++v)
+		if (p_variants[v].signature_size == signature_size && p_variants[v].n_band_rows == n_band_rows)
+			return &p_variants[v].kernels[band_key][hash];
+
+	return kernels_generic(band_key, hash);
+}
+
+const struct Kernels *kernels_generic(const enum BandKey band_key, const enum HashFamily hash) {
+	return &generic_kernels[band_key][hash];
+}
+
+uint64_t *kernels_band_major(const uint64_t *p_bands, const int n_docs, const int n_bands) {
+
+	const size_t n_blocks = (size_t) (n_docs + KERNELS_BLOCK_DOCS - 1) / KERNELS_BLOCK_DOCS;
+	uint64_t *p_band_major = calloc(n_blocks * KERNELS_BLOCK_DOCS * n_bands + 1, sizeof(uint64_t));
+
+	for (int i = 0; i < n_docs; ++i) {
+
+		uint64_t *p_block = p_band_major + (size_t) (i - i % KERNELS_BLOCK_DOCS) * n_bands;
+
+		for (int j = 0; j < n_bands; ++j)
+			p_block[j * KERNELS_BLOCK_DOCS + i % KERNELS_BLOCK_DOCS] = p_bands[(size_t) i * n_bands + j];
+	}
+
+	return p_band_major;
+}
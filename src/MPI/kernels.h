@@ -0,0 +1,106 @@
+#ifndef MULTICOREMINHASH_KERNELS_H
+#define MULTICOREMINHASH_KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structures.h"
+
+// Number of documents whose bands are compared at once by candidate_mask
+#define KERNELS_BLOCK_DOCS 8
+
+/**
+ * Hot loops of the algorithm, selected once at startup for the signature size and the number of band rows. <br>
+ * Common configurations (100, 200 or 300 hashes with 3, 4 or 5 rows per band dividing them) have variants
+ * compiled with constant sizes, which the compiler fully unrolls and vectorizes (with AVX2 if available);
+ * the others use the generic functions. <br>
+ * Every function takes the runtime sizes, so that calls are the same for all the variants
+ * (specialized variants ignore them).
+ */
+struct Kernels {
+	// Name of the variant, e.g. "300/3 avx2" or "generic"
+	const char *name;
+
+	/**
+	 * Update a signature with the hashes of a shingle (same as signature_update, or its variant for the hash family).
+	 */
+	void (*signature_update)(uint32_t *signature, const int signature_size, const void *shingle,
+							 const int shingle_len, const int seed);
+
+	/**
+	 * Compute the band keys of a signature.
+	 */
+	void (*compute_bands)(const uint32_t *p_signature, uint64_t *p_bands, const int n_band_rows, const int n_bands);
+
+	/**
+	 * Check whether two documents are candidate pairs (same as is_candidate_pair).
+	 */
+	bool (*is_candidate_pair)(const uint64_t *p_bands1, const uint64_t *p_bands2, const int n_bands);
+
+	/**
+	 * Check a document against a block of KERNELS_BLOCK_DOCS documents whose bands are stored band-major
+	 * (see kernels_band_major): each band key of the document is broadcast and compared with the keys of the block.
+	 * Returns the mask of the candidate pairs (bit d for the d-th document of the block).
+	 */
+	uint32_t (*candidate_mask)(const uint64_t *p_bands1, const uint64_t *p_block, const int n_bands);
+
+	/**
+	 * Compute the similarity of two signatures (same as signature_similarity).
+	 */
+	float (*signature_similarity)(const uint32_t *p_signature1, const uint32_t *p_signature2,
+								  const int signature_size);
+};
+
+/**
+ * Select the kernels for a configuration: the specialized variant if there is one
+ * (for the instruction set of the CPU), the generic one otherwise.
+ *
+ * @param signature_size Number of hashes in a signature
+ * @param n_band_rows Number of rows in each band
+ * @param band_key How band keys are computed
+ * @param hash Hash function of the shingles
+ * @return The selected kernels (static, never freed)
+ */
+const struct Kernels *kernels_select(const int signature_size, const int n_band_rows, const enum BandKey band_key,
+									 const enum HashFamily hash);
+
+/**
+ * Returns the generic kernels, working with any configuration.
+ *
+ * @param band_key How band keys are computed
+ * @param hash Hash function of the shingles
+ * @return The generic kernels
+ */
+const struct Kernels *kernels_generic(const enum BandKey band_key, const enum HashFamily hash);
+
+/**
+ * Copy bands from the document-major layout (bands of a document are consecutive)
+ * to the band-major one used by candidate_mask: documents are grouped in blocks of KERNELS_BLOCK_DOCS,
+ * and within a block the keys of a band are consecutive. <br>
+ * Blocks stay contiguous, so that checking a document against all the others is still a sequential scan;
+ * the bands of the block of document i start at i * n_bands, the last block is padded with zeros.
+ *
+ * @param p_bands Bands of the documents, document-major
+ * @param n_docs Number of documents
+ * @param n_bands Number of bands
+ * @return Bands of the documents, band-major by block (to be freed)
+ */
+uint64_t *kernels_band_major(const uint64_t *p_bands, int n_docs, int n_bands);
+
+/**
+ * Returns the mask of the documents of a block within a range (to drop the pairs not to compare from a candidate mask).
+ *
+ * @param block Index of the first document of the block
+ * @param first Index of the first document of the range
+ * @param end Index after the last document of the range
+ * @return Bit d set if the d-th document of the block is in the range
+ */
+static inline uint32_t kernels_block_lanes(const int block, const int first, const int end) {
+
+	const int lo = (first > block) ? first - block : 0;
+	const int hi = (end - block < KERNELS_BLOCK_DOCS) ? end - block : KERNELS_BLOCK_DOCS;
+
+	return (hi <= lo) ? 0 : ((1u << hi) - 1) & ~((1u << lo) - 1);
+}
+
+#endif //MULTICOREMINHASH_KERNELS_H
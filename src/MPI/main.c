@@ -4,7 +4,9 @@
 
 #include "main.h"
 #include "io_interface.h"
+#include "kernels.h"
 #include "minhash.h"
+#include "doc_loader.h"
 
 int main(int argc, char *argv[]) {
 
@@ -19,9 +21,17 @@ int main(int argc, char *argv[]) {
 	// Read arguments and share among all processes
 	struct Arguments args = input_arguments_mpi(argc, (const char **) argv, my_rank, comm_sz);
 
+	// Index of the packed corpus, read by each process
+	struct DocPack *pack = NULL;
+	if (args.pack)
+		args.doc_pack = pack = pack_open(args.pack, args.doc_offset, args.n_docs);
+
 	// Start the MinHash algorithm
 	mh_main(args);
 
+	if (pack)
+		pack_close(pack);
+
 	// Close MPI
 	MPI_Finalize();
 
@@ -31,26 +41,23 @@ int main(int argc, char *argv[]) {
 struct Arguments input_arguments_mpi(const int argc, const char *argv[], const int my_rank, const int comm_sz) {
 
 	struct Arguments args;
-	int directory_len;
 
 	// Main process reads the arguments
-	if (my_rank == 0) {
+	if (my_rank == 0)
 		args = input_arguments(argc, argv);
-		directory_len = (int) strlen(args.directory) + 1; // Including NULL terminator
-	}
 
 	// Broadcast the arguments (main sends, others read)
 	MPI_Bcast(&args, sizeof(args), MPI_BYTE, 0, MPI_COMM_WORLD);
 
-	// Broadcast directory string length (main sends, others read)
-	MPI_Bcast(&directory_len, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-	// Allocate memory for directory string
-	if (my_rank != 0)
-		args.directory = (char *) malloc((directory_len) * sizeof(char));
+	// Broadcast the strings pointed by the arguments
+	bcast_string_mpi(&args.directory, my_rank);
+	bcast_string_mpi(&args.spill_path, my_rank);
+	bcast_string_mpi(&args.checkpoint_dir, my_rank);
+	bcast_string_mpi(&args.manifest, my_rank);
+	bcast_string_mpi(&args.pack, my_rank);
 
-	// Broadcast directory path (main sends, others read)
-	MPI_Bcast(args.directory, (int) directory_len, MPI_CHAR, 0, MPI_COMM_WORLD);
+	// Kernels are static data of each process
+	args.kernels = kernels_select(args.signature_size, args.n_band_rows, args.band_key, args.hash);
 
 	// Assign process variables
 	args.proc.my_rank = my_rank;
@@ -71,3 +78,25 @@ struct Arguments input_arguments_mpi(const int argc, const char *argv[], const i
 
 	return args;
 }
+
+void bcast_string_mpi(char **p_str, const int my_rank) {
+
+	int str_len;
+
+	if (my_rank == 0)
+		str_len = *p_str ? (int) strlen(*p_str) + 1 : 0; // Including NULL terminator (0 for a NULL string)
+
+	// Broadcast string length (main sends, others read)
+	MPI_Bcast(&str_len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+	if (str_len == 0)
+		return;
+
+	// Allocate memory for string
+	if (my_rank != 0)
+		*p_str = (char *) malloc(str_len * sizeof(char));
+
+	// Broadcast string (main sends, others read)
+	MPI_Bcast(*p_str, str_len, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+}
@@ -14,4 +14,13 @@ int main(int argc, char *argv[]);
  */
 struct Arguments input_arguments_mpi(const int argc, const char *argv[], const int my_rank, const int comm_sz);
 
+/**
+ * Broadcast a string from the main process to the other processes.
+ * The other processes allocate the memory for the string (NULL strings stay NULL).
+ *
+ * @param p_str Address of the string (read on the main process, written on the others)
+ * @param my_rank MPI rank
+ */
+void bcast_string_mpi(char **p_str, const int my_rank);
+
 #endif //MULTICOREMINHASH_MAIN_H
@@ -5,21 +5,33 @@
 
 #include "minhash.h"
 #include "io_interface.h"
+#include "doc_loader.h"
+#include "spill.h"
+#include "checkpoint.h"
+#include "schedule.h"
 #include "utils.h"
+#include "bbit.h"
+#include "plan.h"
+#include "duplicates.h"
+#include "collective.h"
+#include "shared.h"
 
 void mh_main(struct Arguments args) {
 
-	// Signature matrix - columns are documents, rows are hashes
-	// Band matrix - columns are documents, rows are bands (hashed)
-	uint32_t *signature_matrix;
-	uint32_t *bands_matrix;
-
 	uint8_t verbose = args.verbose && args.proc.my_rank == 0;
 
-	if (verbose)
-		printf("Allocating memory...\n");
+	// Estimate the run from a sample (on the main process), without touching its files
+	if (args.plan > 0) {
+		if (args.proc.my_rank == 0)
+			plan_report(args, true);
+		return;
+	}
 
-	mh_allocate(args, &signature_matrix, &bands_matrix);
+	// Progress of the run, saved periodically if requested (each process saves its own rows)
+	struct Checkpoint *p_ckpt = NULL;
+	if (args.checkpoint_dir)
+		p_ckpt = ckpt_open(args, args.proc.my_rank, args.proc.comm_sz, args.proc.my_rank * args.proc.doc_disp,
+						   args.proc.my_n_docs);
 
 	if (verbose)
 		printf("Opening report file...\n");
@@ -33,47 +45,34 @@ void mh_main(struct Arguments args) {
 	else
 		sprintf(my_csv_filename, "results_%d.csv", args.proc.my_rank);
 
-	my_csv_file = fopen(my_csv_filename, "w");
+	// Keep the results saved by the checkpoint if resuming
+	if (p_ckpt && p_ckpt->csv_size > 0)
+		my_csv_file = ckpt_reopen_csv(p_ckpt, my_csv_filename);
+	else {
+		my_csv_file = fopen(my_csv_filename, "w");
 
-	if (args.proc.my_rank == 0) {
-		fprintf(my_csv_file, "doc1,doc2,similarity\n");
+		if (args.proc.my_rank == 0) {
+			fprintf(my_csv_file, "doc1,doc2,similarity\n");
+		}
 	}
 
-	if (verbose)
-		printf("Computing signatures...\n");
-
-	// Compute the signatures of all documents
-	mh_compute_signatures(args, signature_matrix);
-
-	if (verbose)
-		printf("Computing bands...\n");
-
-	// Reduce the signatures to bands to faster comparison
-	mh_compute_bands(args, signature_matrix, bands_matrix);
-
-	if (verbose)
-		printf("Synchonizing memory...\n");
-
-	// Send other processes results to main process
-	sync_mem_mpi(args, signature_matrix, bands_matrix);
-
-	if (verbose)
-		printf("Comparing documents...\n");
-
-	// Compare all document pairs and write to CSV file
-	mh_compare(args, signature_matrix, bands_matrix, my_csv_file);
-
-	if (verbose)
-		printf("Done.\n");
-
-	// Free memory and close files
-	free(signature_matrix);
-	free(bands_matrix);
+	// Matrices bigger than the memory limit are kept on disk
+	if (args.memory_limit > 0)
+		mh_main_out_of_core(args, my_csv_file);
+	else
+		mh_main_in_memory(args, my_csv_file, p_ckpt);
 
+	// Results of the other processes must be on disk before the main process merges them
+	fflush(my_csv_file);
 	MPI_Barrier(MPI_COMM_WORLD);
 
 	if (args.proc.my_rank != 0) {
 		fclose(my_csv_file);
+
+		// Results are complete, the main process won't need them again
+		if (p_ckpt)
+			ckpt_close(p_ckpt, true);
+
 		return;
 	}
 
@@ -102,126 +101,464 @@ void mh_main(struct Arguments args) {
 	// Close main CSV file
 	fclose(my_csv_file);
 
+	// The run is complete, its checkpoint is not needed anymore
+	if (p_ckpt)
+		ckpt_close(p_ckpt, true);
+
+}
+
+void mh_main_in_memory(struct Arguments args, FILE *f_csv, struct Checkpoint *p_ckpt) {
+
+	// Signature matrix - columns are documents, rows are hashes
+	// Band matrix - columns are documents, rows are bands (hashed)
+	uint32_t *signature_matrix;
+	uint64_t *bands_matrix;
+
+	uint8_t verbose = args.verbose && args.proc.my_rank == 0;
+
+	// Identical documents are hashed and compared once, through the first of them
+	struct DupGroups *dups = NULL;
+
+	if (args.exact_dups) {
+
+		if (verbose)
+			printf("Grouping identical documents...\n");
+
+		args.dups = dups = mh_group_duplicates(args);
+	}
+
+	if (verbose)
+		printf("Allocating memory...\n");
+
+	// Matrices of the node, the current process only keeps its own rows until they are copied into them
+	struct SharedMatrices *shared = NULL;
+
+	if (args.shared_windows) {
+		shared = shared_allocate(args);
+		signature_matrix = calloc((size_t) args.proc.my_n_docs * args.signature_size + 1, sizeof(uint32_t));
+		bands_matrix = calloc((size_t) args.proc.my_n_docs * args.n_bands + 1, sizeof(uint64_t));
+	} else
+		mh_allocate(args, &signature_matrix, &bands_matrix);
+
+	if (args.schedule == SCHEDULE_LPT) {
+
+		if (verbose)
+			printf("Computing signatures and bands (lpt schedule)...\n");
+
+		// Processes own scattered rows, merged once computed
+		mh_compute_lpt(args, &signature_matrix, bands_matrix);
+
+	} else {
+
+		if (verbose)
+			printf("Computing signatures...\n");
+
+		// Compute the signatures of all documents
+		mh_compute_signatures(args, signature_matrix, p_ckpt);
+
+		if (verbose)
+			printf("Computing bands...\n");
+
+		// Reduce the signatures to bands to faster comparison
+		mh_compute_bands(args, signature_matrix, bands_matrix);
+
+		// Only the low bits of each row are kept for the comparison (and sent to the other processes)
+		if (args.bbit && shared)
+			bbit_pack(signature_matrix, args.proc.my_n_docs, args.signature_size, args.bbit);
+		else if (args.bbit)
+			signature_matrix = mh_pack_signatures(args, signature_matrix, args.proc.my_n_docs);
+
+		if (verbose)
+			printf("Synchonizing memory...\n");
+
+		if (shared) {
+
+			// Rows of every node are broadcast to the leaders of the others
+			shared_sync(args, shared, signature_matrix, bands_matrix);
+
+			free(signature_matrix);
+			free(bands_matrix);
+			signature_matrix = shared->p_signatures;
+			bands_matrix = shared->p_bands;
+
+		} else
+			// Send other processes results to main process
+			sync_mem_mpi(args, signature_matrix, bands_matrix);
+	}
+
+	if (verbose)
+		printf("Comparing documents...\n");
+
+	// Compare all document pairs and write to CSV file
+	struct CompareStats stats = {0};
+	mh_compare(args, signature_matrix, bands_matrix, f_csv, &stats, p_ckpt);
+
+	// Pairs of documents of the same group, written once by the main process
+	if (dups && args.proc.my_rank == 0)
+		stats.n_duplicates += dup_groups_write_inner(dups, 0, args.n_docs, args.doc_offset, f_csv);
+
+	if (args.verbose)
+		reduce_compare_stats_mpi(args, &stats);
+
+	if (verbose) {
+		print_compare_stats(args, stats);
+		printf("Done.\n");
+	}
+
+	// Free memory
+	if (shared)
+		shared_free(shared);
+	else {
+		free(signature_matrix);
+		free(bands_matrix);
+	}
+	if (dups)
+		dup_groups_destroy(dups);
+
+}
+
+void mh_main_out_of_core(struct Arguments args, FILE *f_csv) {
+
+	const int block_docs = spill_block_docs(args);
+	const int n_blocks = (args.n_docs + block_docs - 1) / block_docs;
+	const int my_first_doc = args.proc.my_rank * args.proc.doc_disp;
+
+	uint8_t verbose = args.verbose && args.proc.my_rank == 0;
+
+	if (verbose)
+		printf("Out-of-core mode: %d blocks of %d documents, spilled to %s\n", n_blocks, block_docs, args.spill_path);
+
+	// Main process creates the file, then the others open it
+	struct SpillFile *spill = NULL;
+	if (args.proc.my_rank == 0)
+		spill = spill_open(args, true);
+	MPI_Barrier(MPI_COMM_WORLD);
+	if (args.proc.my_rank != 0)
+		spill = spill_open(args, false);
+
+	// Rows of the part being computed
+	uint32_t *p_signatures = malloc((size_t) block_docs * args.signature_size * sizeof(uint32_t));
+	uint64_t *p_bands = malloc((size_t) block_docs * args.n_bands * sizeof(uint64_t));
+
+	if (verbose)
+		printf("Computing signatures and bands...\n");
+
+	// Every process computes its documents a block at a time, and writes their rows to the shared file
+	for (int first_doc = 0; first_doc < args.proc.my_n_docs; first_doc += block_docs) {
+
+		struct Arguments block_args = args;
+		block_args.doc_offset = args.doc_offset + first_doc;
+		block_args.proc.my_n_docs = (args.proc.my_n_docs - first_doc < block_docs)
+									? args.proc.my_n_docs - first_doc : block_docs;
+
+		mh_compute_signatures(block_args, p_signatures, NULL);
+		mh_compute_bands(block_args, p_signatures, p_bands);
+
+		spill_write(spill, my_first_doc + first_doc, block_args.proc.my_n_docs, p_signatures, p_bands);
+	}
+
+	free(p_signatures);
+	free(p_bands);
+
+	// All rows must be on disk before comparing
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	if (verbose)
+		printf("Comparing documents...\n");
+
+	// Tiles of the upper triangle of the pairs matrix, row by row, assigned round-robin to the processes
+	const int n_tiles = n_blocks * (n_blocks + 1) / 2;
+	int *p_tiles = malloc(2 * (n_tiles / args.proc.comm_sz + 1) * sizeof(int));
+	int my_n_tiles = 0;
+
+	for (int bi = 0, t = 0; bi < n_blocks; ++bi)
+		for (int bj = bi; bj < n_blocks; ++bj, ++t)
+			if (t % args.proc.comm_sz == args.proc.my_rank) {
+				p_tiles[2 * my_n_tiles] = bi;
+				p_tiles[2 * my_n_tiles + 1] = bj;
+				++my_n_tiles;
+			}
+
+	struct CompareStats stats = {0};
+	double wait_time = spill_compare_tiles(args, spill, block_docs, p_tiles, my_n_tiles, mh_compare_tile, f_csv,
+										   &stats);
+
+	if (args.verbose)
+		printf("[Rank %2d] Compared %d tiles, %.3f s waiting for the spill file\n",
+			   args.proc.my_rank, my_n_tiles, wait_time);
+
+	free(p_tiles);
+
+	// The file is removed once no process is reading it
+	MPI_Barrier(MPI_COMM_WORLD);
+	spill_close(spill, args.proc.my_rank == 0);
+
+	if (args.verbose)
+		reduce_compare_stats_mpi(args, &stats);
+
+	if (verbose) {
+		print_compare_stats(args, stats);
+		printf("Done.\n");
+	}
+
 }
 
-void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint32_t **pp_bands_matrix) {
+void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t **pp_bands_matrix) {
 
 	// Allocate matrices (calloc initializes to 0 all memory)
 	*pp_signature_matrix = calloc(args.n_docs * args.signature_size, sizeof(uint32_t));
-	*pp_bands_matrix = calloc(args.n_docs * args.n_bands, sizeof(uint32_t));
+	*pp_bands_matrix = calloc(args.n_docs * args.n_bands, sizeof(uint64_t));
 
 }
 
-void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix) {
+void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt) {
 
-	const int my_doc_offset = args.doc_offset + args.proc.my_rank * args.proc.doc_disp;
+	const int my_first_doc = args.proc.my_rank * args.proc.doc_disp;
+	const int my_doc_offset = args.doc_offset + my_first_doc;
 
-	size_t filepath_len = strlen(args.directory) + 20UL;
-	char doc_filepath[filepath_len];
+	// Start from the rows saved by the resumed run
+	if (p_ckpt)
+		ckpt_load_rows(p_ckpt, p_signature_matrix);
 
-	// Loop over all documents assigned to the current process
-	for (int i = 0; i < args.proc.my_n_docs; ++i) {
+	struct DocLoader *loader = loader_create(args, args.io_batch);
+	struct DocBuffer buffers[args.io_batch];
+	struct DocBuffer *p_buffers[args.io_batch];
+	int doc_numbers[args.io_batch];
+	int batch_rows[args.io_batch];
+	struct Tokens tokens = {0};
+	struct ShingleSet dedup = {0};
+
+	memset(buffers, 0, sizeof(buffers));
+	for (int k = 0; k < args.io_batch; ++k)
+		p_buffers[k] = &buffers[k];
+
+	if (args.verbose && args.io_backend == IO_URING && !loader_uses_uring(loader))
+		printf("[Rank %2d] io_uring not available, reading documents with pread\n", args.proc.my_rank);
+
+	// Documents of the pack are read by all processes together, a batch each
+	struct CollectiveReader *reader = args.collective_io ? collective_open(args) : NULL;
+
+	// Collective reads go on until the process with the most documents is done
+	const int n_loop_docs = reader ? args.proc.doc_disp : args.proc.my_n_docs;
 
-//		if (args.verbose && (i % args.verbose == 0))
-//			printf("[Rank %2d] Computing signature for doc %d\n", args.proc.my_rank, i + my_doc_offset);
+	// Loop over all batches of documents assigned to the current process
+	for (int first_doc = 0; first_doc < n_loop_docs; first_doc += args.io_batch) {
 
-		// Compute the path of the document file (they are numbered)
-		sprintf(doc_filepath, "%s/%d.txt", args.directory, i + my_doc_offset);
+		const int batch_docs = (args.proc.my_n_docs - first_doc < args.io_batch)
+							   ? args.proc.my_n_docs - first_doc : args.io_batch;
+		int count = 0;
+
+		// Load the documents of the batch (except the ones saved by the checkpoint and the duplicates)
+		for (int k = 0; k < batch_docs; ++k)
+			if ((!p_ckpt || !ckpt_row_done(p_ckpt, first_doc + k)) &&
+				(!args.dups || !args.dups->p_member[my_first_doc + first_doc + k])) {
+				batch_rows[count] = first_doc + k;
+				doc_numbers[count++] = first_doc + k + my_doc_offset;
+			}
+
+		if (reader)
+			collective_read(reader, doc_numbers, p_buffers, count);
+		else
+			loader_read(loader, args.directory, doc_numbers, p_buffers, count);
 
 		// Write the signature of the i-th document in the i-th matrix row
-		mh_document_signature(
-				doc_filepath,
-				(int) args.shingle_size,
-				p_signature_matrix + i * args.signature_size,
-				(int) args.signature_size,
-				args.seed
-		);
+		for (int k = 0; k < count; ++k) {
+
+			uint32_t *p_signature = p_signature_matrix + batch_rows[k] * args.signature_size;
+
+			mh_document_signature(
+					buffers[k].data,
+					buffers[k].size,
+					&tokens,
+					args.dedup ? &dedup : NULL,
+					args.shingle_size,
+					args.shingle_mode,
+					p_signature,
+					args.signature_size,
+					args.seed,
+					args.kernels
+			);
+
+			if (p_ckpt)
+				ckpt_row_computed(p_ckpt, batch_rows[k], p_signature);
+		}
 	}
 
+	// Compared rows can only be saved once all rows are
+	if (p_ckpt)
+		ckpt_save(p_ckpt);
+
+	if (args.verbose && args.dedup)
+		printf("[Rank %2d] Shingle dedup: %zu distinct shingles hashed, %zu repeated shingles skipped\n",
+			   args.proc.my_rank, dedup.n_distinct, dedup.n_repeated);
+
+	if (reader) {
+		if (args.verbose)
+			printf("[Rank %2d] Collective reads: %d (%.2f MB)\n", args.proc.my_rank, reader->n_reads,
+				   reader->bytes / (1024.0 * 1024.0));
+		collective_close(reader);
+	}
+
+	for (int k = 0; k < args.io_batch; ++k)
+		free(buffers[k].data);
+	tokens_free(&tokens);
+	shingle_set_free(&dedup);
+	loader_destroy(loader);
+
 }
 
-void mh_document_signature(
-		const char *filepath,
-		const int shingle_size,
-		uint32_t *signature,
-		const int signature_size,
-		const int seed
-) {
+void mh_compute_lpt(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t *p_bands_matrix) {
 
-	// Open file
-	FILE *file = fopen(filepath, "r");
+	uint32_t *p_signature_matrix = *pp_signature_matrix;
 
-	// Check if file was opened
-	if (file == NULL) {
-		printf("Error opening file %s\n", filepath);
-		exit(2);
+	const int my_rank = args.proc.my_rank;
+	const int comm_sz = args.proc.comm_sz;
+
+	// Sizes are read by the main process only
+	long *p_sizes = (my_rank == 0) ? sched_doc_sizes(args) : malloc((args.n_docs > 0 ? args.n_docs : 1) * sizeof(long));
+	MPI_Bcast(p_sizes, args.n_docs, MPI_LONG, 0, MPI_COMM_WORLD);
+
+	// Every process computes the same assignment
+	int *p_owner = malloc((args.n_docs > 0 ? args.n_docs : 1) * sizeof(int));
+	sched_lpt_assign(p_sizes, args.n_docs, comm_sz, args.dups ? args.dups->p_member : NULL, p_owner);
+
+	// Documents of the current process, largest first
+	int *p_order = sched_lpt_order(p_sizes, args.n_docs);
+	int my_n_docs = 0;
+
+	for (int k = 0; k < args.n_docs; ++k)
+		if (p_owner[p_order[k]] == my_rank)
+			p_order[my_n_docs++] = p_order[k];
+
+	// Time spent on each document, to report the gain of the schedule
+	double *p_doc_times = args.verbose ? calloc(args.n_docs, sizeof(double)) : NULL;
+
+	struct DocLoader *loader = loader_create(args, args.io_batch);
+	struct DocBuffer buffers[args.io_batch];
+	struct DocBuffer *p_buffers[args.io_batch];
+	int doc_numbers[args.io_batch];
+	struct Tokens tokens = {0};
+	struct ShingleSet dedup = {0};
+
+	memset(buffers, 0, sizeof(buffers));
+	for (int k = 0; k < args.io_batch; ++k)
+		p_buffers[k] = &buffers[k];
+
+	if (args.verbose) {
+		long my_bytes = 0;
+		for (int k = 0; k < my_n_docs; ++k)
+			my_bytes += p_sizes[p_order[k]];
+		printf("[Rank %2d] Documents: %d (%ld bytes)\n", my_rank, my_n_docs, my_bytes);
 	}
 
-	char *prev_words[shingle_size];
-	char *shingle;
-	uint32_t current_hash;
+	// Loop over the documents of the current process, one batch at a time
+	for (int first = 0; first < my_n_docs; first += args.io_batch) {
 
-	// Set all signature values to max
-	for (int i = 0; i < signature_size; i++) {
-		signature[i] = UINT32_MAX;
-	}
+		const int count = (my_n_docs - first < args.io_batch) ? my_n_docs - first : args.io_batch;
 
-	// Set to null all previous words
-	for (int i = 0; i < shingle_size; i++)
-		prev_words[i] = NULL;
+		for (int k = 0; k < count; ++k)
+			doc_numbers[k] = p_order[first + k] + args.doc_offset;
 
-	// Read all shingles from file
-	while ((shingle = read_shingle_from_file(file, shingle_size, prev_words))) {
+		loader_read(loader, args.directory, doc_numbers, p_buffers, count);
 
-		int shingle_len = strlen(shingle);
+		// Write the signature and bands of the i-th document in the i-th matrix rows
+		for (int k = 0; k < count; ++k) {
 
-		// Compute document signature
-		for (int i = 0; i < signature_size; ++i) {
+			const int i = p_order[first + k];
+			const double start = p_doc_times ? wall_time() : 0;
+			uint32_t *p_signature = p_signature_matrix + (size_t) i * args.signature_size;
 
-			// Hash shingle and save if min
-			current_hash = murmur_hash(shingle, shingle_len, seed * i);
-			if (current_hash < signature[i])
-				signature[i] = current_hash;
+			mh_document_signature(
+					buffers[k].data,
+					buffers[k].size,
+					&tokens,
+					args.dedup ? &dedup : NULL,
+					args.shingle_size,
+					args.shingle_mode,
+					p_signature,
+					args.signature_size,
+					args.seed,
+					args.kernels
+			);
+
+			args.kernels->compute_bands(p_signature, p_bands_matrix + (size_t) i * args.n_bands, args.n_band_rows,
+										args.n_bands);
+
+			if (p_doc_times)
+				p_doc_times[i] = wall_time() - start;
 		}
+	}
 
-		// Free shingle memory
-		free(shingle);
+	if (args.verbose && args.dedup)
+		printf("[Rank %2d] Shingle dedup: %zu distinct shingles hashed, %zu repeated shingles skipped\n",
+			   my_rank, dedup.n_distinct, dedup.n_repeated);
+
+	// Packed rows of the other processes are still zero
+	if (args.bbit)
+		*pp_signature_matrix = p_signature_matrix = mh_pack_signatures(args, p_signature_matrix, args.n_docs);
+
+	// Rows of the other processes are zero: OR-ing the matrices of all processes merges them
+	MPI_Allreduce(MPI_IN_PLACE, p_signature_matrix, args.n_docs * bbit_words(args.signature_size, args.bbit),
+				  MPI_UNSIGNED, MPI_BOR, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, p_bands_matrix, args.n_docs * args.n_bands, MPI_UINT64_T, MPI_BOR, MPI_COMM_WORLD);
+
+	// Compare with the contiguous ranges of the static schedule
+	if (p_doc_times) {
+		if (my_rank == 0) {
+			MPI_Reduce(MPI_IN_PLACE, p_doc_times, args.n_docs, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+			int *p_static_owner = malloc((args.n_docs > 0 ? args.n_docs : 1) * sizeof(int));
+			sched_static_assign(args.n_docs, args.proc.doc_disp, comm_sz, p_static_owner);
+			sched_report(p_doc_times, p_owner, p_static_owner, args.n_docs, comm_sz);
+			free(p_static_owner);
+		} else
+			MPI_Reduce(p_doc_times, NULL, args.n_docs, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 	}
 
-	// Free previous words memory
-	for (int i = 0; i < shingle_size; i++)
-		free(prev_words[i]);
+	for (int k = 0; k < args.io_batch; ++k)
+		free(buffers[k].data);
+	tokens_free(&tokens);
+	shingle_set_free(&dedup);
+	loader_destroy(loader);
+
+	free(p_sizes);
+	free(p_owner);
+	free(p_order);
+	free(p_doc_times);
 
-	// Close file
-	fclose(file);
 }
 
-void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint32_t *p_bands_matrix) {
+uint32_t *mh_pack_signatures(struct Arguments args, uint32_t *p_signature_matrix, int n_docs) {
 
-	// Loop over all documents
-	for (int i = 0; i < args.proc.my_n_docs; ++i) {
+	bbit_pack(p_signature_matrix, n_docs, args.signature_size, args.bbit);
 
-		// Compute the bands of the i-th document
-		for (int j = 0; j < args.n_bands; ++j) {
+	const size_t packed_bytes = (size_t) args.n_docs * bbit_words(args.signature_size, args.bbit) * sizeof(uint32_t);
+	uint32_t *p_packed = realloc(p_signature_matrix, packed_bytes > 0 ? packed_bytes : 1);
 
-			// Compute the hash of the band
-			uint32_t band_hash = 0;
-			for (int k = 0; k < args.n_band_rows; ++k) {
-				band_hash ^= p_signature_matrix[i * args.signature_size + j * args.n_band_rows + k];
-			}
+	if (args.verbose && args.proc.my_rank == 0)
+		printf("Signature matrix packed to %d bits per row: %zu bytes instead of %zu\n", args.bbit, packed_bytes,
+			   (size_t) args.n_docs * args.signature_size * sizeof(uint32_t));
 
-			// Save the band hash in the bands matrix
-			p_bands_matrix[i * args.n_bands + j] = band_hash;
-		}
+	return p_packed ? p_packed : p_signature_matrix;
+}
+
+void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint64_t *p_bands_matrix) {
+
+	// Loop over all documents
+	for (int i = 0; i < args.proc.my_n_docs; ++i) {
 
+		// Compute the bands of the i-th document
+		args.kernels->compute_bands(p_signature_matrix + i * args.signature_size, p_bands_matrix + i * args.n_bands,
+									args.n_band_rows, args.n_bands);
 	}
 
 }
 
-void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix) {
+void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix) {
 
 	const int n_docs = args.n_docs;
-	const int size_sig = args.signature_size;
+	// Words of a (possibly packed) signature
+	const int size_sig = bbit_words(args.signature_size, args.bbit);
 	const int comm_sz = args.proc.comm_sz;
 	const int my_n_docs = args.proc.my_n_docs;
 
@@ -230,12 +567,12 @@ void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t
 
 		if (args.verbose) {
 			printf("[Rank %2d] Sending %d signature uint32_t\n", args.proc.my_rank, my_n_docs * size_sig);
-			printf("[Rank %2d] Sending %d bands uint32_t\n", args.proc.my_rank, my_n_docs * args.n_bands);
+			printf("[Rank %2d] Sending %d bands uint64_t\n", args.proc.my_rank, my_n_docs * args.n_bands);
 		}
 
 		// Send signature and bands matrices
 		MPI_Send((void *) p_signature_matrix, my_n_docs * size_sig, MPI_UNSIGNED, 0, 0, MPI_COMM_WORLD);
-		MPI_Send((void *) p_bands_matrix, my_n_docs * args.n_bands, MPI_UNSIGNED, 0, 0, MPI_COMM_WORLD);
+		MPI_Send((void *) p_bands_matrix, my_n_docs * args.n_bands, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
 
 	} else {
 
@@ -247,61 +584,171 @@ void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t
 
 			if (args.verbose) {
 				printf("[Rank  0] From %2d receiving %d signature uint32_t\n", i, recv_n_docs * size_sig);
-				printf("[Rank  0] From %2d receiving %d bands uint32_t\n", i, recv_n_docs * args.n_bands);
+				printf("[Rank  0] From %2d receiving %d bands uint64_t\n", i, recv_n_docs * args.n_bands);
 			}
 
 			uint32_t *p_recv_signature_matrix = p_signature_matrix + i * args.proc.doc_disp * size_sig;
-			uint32_t *p_recv_bands_matrix = p_bands_matrix + i * args.proc.doc_disp * args.n_bands;
+			uint64_t *p_recv_bands_matrix = p_bands_matrix + i * args.proc.doc_disp * args.n_bands;
 
 			// Receive signature matrix
 			MPI_Recv((void *) p_recv_signature_matrix, recv_n_docs * size_sig,
 					 MPI_UNSIGNED, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 			// Receive bands matrix
 			MPI_Recv((void *) p_recv_bands_matrix, recv_n_docs * args.n_bands,
-					 MPI_UNSIGNED, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+					 MPI_UINT64_T, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 		}
 
 	}
 
 	// Broadcast full signature and bands matrices
 	MPI_Bcast((void *) p_signature_matrix, n_docs * size_sig, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-	MPI_Bcast((void *) p_bands_matrix, n_docs * args.n_bands, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+	MPI_Bcast((void *) p_bands_matrix, n_docs * args.n_bands, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
 	if (args.verbose)
 		printf("[Rank %2d] Memory synchronized.\n", args.proc.my_rank);
 
 }
 
-void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix, FILE *f_csv) {
+void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix, FILE *f_csv,
+				struct CompareStats *p_stats, struct Checkpoint *p_ckpt) {
 
 	const int n_bands = (int) (args.signature_size / args.n_band_rows);
+	const int stride = bbit_words(args.signature_size, args.bbit);
 
 	int i_start, i_end;
 	get_compare_indices_mpi(args, &i_start, &i_end);
 
+	// Skip the rows compared by the resumed run
+	if (p_ckpt && p_ckpt->compare_next > i_start)
+		i_start = p_ckpt->compare_next;
+
+	// Bands of all documents, band-major: a document is checked against a block of them at once
+	uint64_t *p_bands_t = kernels_band_major(p_bands_matrix, args.n_docs, n_bands);
+
+	// Duplicates are compared through their representative: their lanes are never candidates
+	uint32_t *p_dup_lanes = NULL;
+
+	if (args.dups) {
+		p_dup_lanes = calloc(args.n_docs / KERNELS_BLOCK_DOCS + 1, sizeof(uint32_t));
+		for (int j = 0; j < args.n_docs; ++j)
+			p_dup_lanes[j / KERNELS_BLOCK_DOCS] |= (uint32_t) args.dups->p_member[j] << (j % KERNELS_BLOCK_DOCS);
+	}
+
 	// Loop over all document pairs
-	for (int i = i_start; i < i_end; ++i)
-		for (int j = i + 1; j < args.n_docs; ++j) {
+	for (int i = i_start; i < i_end; ++i) {
+
+		if (args.dups && args.dups->p_member[i])
+			continue;
+
+		uint64_t *p_bands1 = p_bands_matrix + i * n_bands;
+
+		for (int block = (i + 1) - (i + 1) % KERNELS_BLOCK_DOCS; block < args.n_docs; block += KERNELS_BLOCK_DOCS) {
+
+			// Candidate pairs of the block (only the documents after i)
+			uint32_t mask = args.kernels->candidate_mask(p_bands1, p_bands_t + (size_t) block * n_bands, n_bands)
+							& kernels_block_lanes(block, i + 1, args.n_docs);
+
+			if (p_dup_lanes)
+				mask &= ~p_dup_lanes[block / KERNELS_BLOCK_DOCS];
+
+			for (; mask; mask &= mask - 1) {
 
-			// Pointers to the bands of the two documents
-			uint32_t *p_bands1 = p_bands_matrix + i * n_bands;
-			uint32_t *p_bands2 = p_bands_matrix + j * n_bands;
+				const int j = block + __builtin_ctz(mask);
 
-			// Skip if not candidate pair
-			if (!is_candidate_pair(p_bands1, p_bands2, n_bands))
-				continue;
+				// Pointers to the signatures of the two documents
+				uint32_t *p_signature1 = p_signature_matrix + i * stride;
+				uint32_t *p_signature2 = p_signature_matrix + j * stride;
 
-			// Pointers to the signatures of the two documents
-			uint32_t *p_signature1 = p_signature_matrix + i * args.signature_size;
-			uint32_t *p_signature2 = p_signature_matrix + j * args.signature_size;
+				p_stats->n_candidates++;
 
-			// Compute MinHash similarity and print if above threshold
-			float similarity = signature_similarity(p_signature1, p_signature2, args.signature_size);
-			if (similarity >= args.threshold)
-				fprintf(f_csv, "%d,%d,%.4f\n", i + args.doc_offset, j + args.doc_offset, similarity);
+				// Check whether the equal band keys come from equal bands (only to report collisions)
+				if (args.verbose && !args.bbit && !has_equal_band(p_signature1, p_signature2, n_bands, args.n_band_rows))
+					p_stats->n_collisions++;
 
+				// Compute MinHash similarity (estimated from the low bits of packed rows) and print if above threshold
+				float similarity = args.bbit
+								   ? bbit_similarity(p_signature1, p_signature2, args.signature_size, args.bbit)
+								   : args.kernels->signature_similarity(p_signature1, p_signature2, args.signature_size);
+				if (similarity >= args.threshold) {
+					p_stats->n_similar++;
+
+					// The pair stands for the pairs of the two groups
+					if (args.dups)
+						p_stats->n_duplicates += dup_groups_write_pairs(args.dups, i, j, similarity, args.doc_offset,
+																		f_csv) - 1;
+					else
+						fprintf(f_csv, "%d,%d,%.4f\n", i + args.doc_offset, j + args.doc_offset, similarity);
+				}
+			}
 		}
 
+		// Save the progress if the checkpoint interval has elapsed
+		if (p_ckpt && i % CHECKPOINT_COMPARE_ROWS == CHECKPOINT_COMPARE_ROWS - 1)
+			ckpt_compare_progress(p_ckpt, i + 1, f_csv, false);
+	}
+
+	free(p_bands_t);
+	free(p_dup_lanes);
+
+}
+
+void mh_compare_tile(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+) {
+
+	const int n_bands = (int) (args.signature_size / args.n_band_rows);
+	const int stride = bbit_words(args.signature_size, args.bbit);
+
+	// On the diagonal, only pairs with j > i are compared
+	const int diagonal = first_doc1 == first_doc2;
+
+	// Bands of the second documents, band-major: a document is checked against a block of them at once
+	uint64_t *p_bands2_t = kernels_band_major(p_bands2, n_docs2, n_bands);
+
+	// Loop over all document pairs of the tile
+	for (int i = 0; i < n_docs1; ++i) {
+
+		const uint64_t *p_band1 = p_bands1 + i * n_bands;
+		const int first_j = diagonal ? i + 1 : 0;
+
+		for (int block = first_j - first_j % KERNELS_BLOCK_DOCS; block < n_docs2; block += KERNELS_BLOCK_DOCS) {
+
+			// Candidate pairs of the block (only the ones to compare)
+			uint32_t mask = args.kernels->candidate_mask(p_band1, p_bands2_t + (size_t) block * n_bands, n_bands)
+							& kernels_block_lanes(block, first_j, n_docs2);
+
+			for (; mask; mask &= mask - 1) {
+
+				const int j = block + __builtin_ctz(mask);
+
+				// Pointers to the signatures of the two documents
+				const uint32_t *p_signature1 = p_signatures1 + i * stride;
+				const uint32_t *p_signature2 = p_signatures2 + j * stride;
+
+				p_stats->n_candidates++;
+
+				// Check whether the equal band keys come from equal bands (only to report collisions)
+				if (args.verbose && !args.bbit && !has_equal_band(p_signature1, p_signature2, n_bands, args.n_band_rows))
+					p_stats->n_collisions++;
+
+				// Compute MinHash similarity (estimated from the low bits of packed rows) and print if above threshold
+				float similarity = args.bbit
+								   ? bbit_similarity(p_signature1, p_signature2, args.signature_size, args.bbit)
+								   : args.kernels->signature_similarity(p_signature1, p_signature2, args.signature_size);
+				if (similarity >= args.threshold) {
+					p_stats->n_similar++;
+					fprintf(f_csv, "%d,%d,%.4f\n", first_doc1 + i + args.doc_offset, first_doc2 + j + args.doc_offset,
+							similarity);
+				}
+			}
+		}
+	}
+
+	free(p_bands2_t);
+
 }
 
 void get_compare_indices_mpi(struct Arguments args, int *p_i_start_inc, int *p_i_end_exc) {
@@ -356,3 +803,81 @@ void get_compare_indices_mpi(struct Arguments args, int *p_i_start_inc, int *p_i
 	*p_i_end_exc = (args.proc.my_rank == comm_sz - 1) ? args.n_docs : indices[args.proc.my_rank + 1];
 
 }
+
+void reduce_compare_stats_mpi(struct Arguments args, struct CompareStats *p_stats) {
+
+	// Counters are contiguous unsigned longs
+	const int n_counters = sizeof(struct CompareStats) / sizeof(unsigned long);
+
+	// Main process sums the counters of all processes
+	if (args.proc.my_rank == 0)
+		MPI_Reduce(MPI_IN_PLACE, p_stats, n_counters, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	else
+		MPI_Reduce(p_stats, NULL, n_counters, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+}
+
+struct DupGroups *mh_group_duplicates(struct Arguments args) {
+
+	const int my_first_doc = args.proc.my_rank * args.proc.doc_disp;
+
+	// Fingerprints of the other processes stay zero: OR-ing the arrays of all processes merges them
+	uint64_t *p_fingerprints = calloc((size_t) args.n_docs * 2 + 1, sizeof(uint64_t));
+
+	struct DocLoader *loader = loader_create(args, args.io_batch);
+	struct DocBuffer buffers[args.io_batch];
+	struct DocBuffer *p_buffers[args.io_batch];
+	int doc_numbers[args.io_batch];
+	struct Tokens tokens = {0};
+
+	memset(buffers, 0, sizeof(buffers));
+	for (int k = 0; k < args.io_batch; ++k)
+		p_buffers[k] = &buffers[k];
+
+	// Documents of the pack are read by all processes together, until the one with the most documents is done
+	struct CollectiveReader *reader = args.collective_io ? collective_open(args) : NULL;
+	const int n_loop_docs = reader ? args.proc.doc_disp : args.proc.my_n_docs;
+
+	// Fingerprint of the normalized text of each document, the one its shingles are made of
+	for (int first_doc = 0; first_doc < n_loop_docs; first_doc += args.io_batch) {
+
+		int count = (args.proc.my_n_docs - first_doc < args.io_batch) ? args.proc.my_n_docs - first_doc
+																	  : args.io_batch;
+		if (count < 0)
+			count = 0;
+
+		for (int k = 0; k < count; ++k)
+			doc_numbers[k] = my_first_doc + first_doc + k + args.doc_offset;
+
+		if (reader)
+			collective_read(reader, doc_numbers, p_buffers, count);
+		else
+			loader_read(loader, args.directory, doc_numbers, p_buffers, count);
+
+		for (int k = 0; k < count; ++k) {
+			tokenize(buffers[k].data, buffers[k].size, &tokens);
+			dup_fingerprint(tokens.text, tokens.text_len,
+							p_fingerprints + 2 * (size_t) (my_first_doc + first_doc + k));
+		}
+	}
+
+	if (reader)
+		collective_close(reader);
+
+	MPI_Allreduce(MPI_IN_PLACE, p_fingerprints, args.n_docs * 2, MPI_UINT64_T, MPI_BOR, MPI_COMM_WORLD);
+
+	// Every process builds the same groups
+	struct DupGroups *groups = dup_groups_build(p_fingerprints, args.n_docs);
+
+	if (args.verbose && args.proc.my_rank == 0)
+		printf("Exact duplicates: %d documents in %d groups, neither hashed nor compared\n", groups->n_members,
+			   groups->n_groups);
+
+	for (int k = 0; k < args.io_batch; ++k)
+		free(buffers[k].data);
+	tokens_free(&tokens);
+	loader_destroy(loader);
+	free(p_fingerprints);
+
+	return groups;
+}
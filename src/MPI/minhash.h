@@ -5,6 +5,9 @@
 #include <stdint.h>
 
 #include "structures.h"
+#include "doc_loader.h"
+#include "signature.h"
+#include "checkpoint.h"
 
 /**
  * Perform the MinHash algorithm on the given arguments.
@@ -15,6 +18,26 @@
  */
 void mh_main(struct Arguments args);
 
+/**
+ * Perform the MinHash algorithm keeping the whole matrices in memory.
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results
+ * @param p_ckpt Checkpoint of the process (NULL if disabled)
+ */
+void mh_main_in_memory(struct Arguments args, FILE *f_csv, struct Checkpoint *p_ckpt);
+
+/**
+ * Perform the MinHash algorithm keeping the matrices on disk, using at most args.memory_limit MB for them. <br>
+ * Signatures and bands are computed one block of documents at a time and spilled to a file,
+ * then the pairs are compared one tile (pair of blocks) at a time.
+ * Every process spills its own documents to a shared file, and compares a share of the tiles.
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results
+ */
+void mh_main_out_of_core(struct Arguments args, FILE *f_csv);
+
 /**
  * Allocate memory for the signature and bands matrices.
  * Memory must be freed by the caller after usage.
@@ -23,34 +46,42 @@ void mh_main(struct Arguments args);
  * @param pp_signature_matrix Address to the signature matrix's pointer
  * @param pp_bands_matrix Address to the bands matrix's pointer
  */
-void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint32_t **pp_bands_matrix);
+void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t **pp_bands_matrix);
 
 /**
- * Compute the signature matrix of all documents.
+ * Compute the signature matrix of the documents assigned to the current process.
+ * With a checkpoint, the rows saved by the resumed run are loaded instead of computed,
+ * and computed rows are saved.
  *
  * @param args Algorithm's arguments
  * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_ckpt Checkpoint of the process (NULL if disabled)
  */
-void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix);
+void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt);
 
 /**
- * Compute the signature of a document. <br>
- * The file is read word by word, and a shingle is built from the last n words read.
- * The shingle is then hashed and stored in the signature array.
+ * Compute the signature and bands matrices of all documents with the lpt schedule: documents are assigned to the
+ * processes largest first (balancing the bytes of every process), each process computes the rows of its documents
+ * in place, and the matrices of all processes are merged (rows of other processes are zero).
+ *
+ * With b-bit signatures, the rows are packed before being merged, and the matrix may be moved.
  *
- * @param filepath Path to the document
- * @param shingle_size Size of a shingle
- * @param signature Array to store the signature
- * @param signature_size Size of the signature array
- * @param seed Seed for the hash function
+ * @param args Algorithm's arguments
+ * @param pp_signature_matrix Address to the signature matrix's pointer (zeroed)
+ * @param p_bands_matrix Pointer to the bands matrix (zeroed)
  */
-void mh_document_signature(
-		const char *filepath,
-		const int shingle_size,
-		uint32_t *signature,
-		const int signature_size,
-		const int seed
-);
+void mh_compute_lpt(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t *p_bands_matrix);
+
+/**
+ * Pack the signatures of the first documents to the low args.bbit bits of each row (see bbit.h),
+ * shrinking the signature matrix to the packed size of all documents.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param n_docs Number of signatures to pack
+ * @return Pointer to the packed signature matrix (rows of bbit_words(args.signature_size, args.bbit) words)
+ */
+uint32_t *mh_pack_signatures(struct Arguments args, uint32_t *p_signature_matrix, int n_docs);
 
 /**
  * Compute the bands matrix from the signature matrix.
@@ -59,7 +90,7 @@ void mh_document_signature(
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
  */
-void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint32_t *p_bands_matrix);
+void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint64_t *p_bands_matrix);
 
 /**
  * Transfer the matrices from the other processes to the main process.
@@ -68,7 +99,7 @@ void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix,
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
  */
-void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix);
+void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix);
 
 /**
  * Compare all document pairs and write candidate pairs to a CSV file.
@@ -79,8 +110,34 @@ void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
  * @param f_csv Open CSV file where to write the results
+ * @param p_stats Counters of the comparison, updated with the compared pairs
+ * @param p_ckpt Checkpoint of the process, where the progress is saved (NULL if disabled)
+ */
+void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix, FILE *f_csv,
+				struct CompareStats *p_stats, struct Checkpoint *p_ckpt);
+
+/**
+ * Compare the document pairs of a tile, made of two blocks of consecutive documents,
+ * and write candidate pairs to a CSV file. If both blocks start at the same document, each pair is compared once.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signatures1 Signature rows of the first block
+ * @param p_bands1 Bands rows of the first block
+ * @param first_doc1 Index of the first document of the first block
+ * @param n_docs1 Number of documents in the first block
+ * @param p_signatures2 Signature rows of the second block
+ * @param p_bands2 Bands rows of the second block
+ * @param first_doc2 Index of the first document of the second block
+ * @param n_docs2 Number of documents in the second block
+ * @param f_csv Open CSV file where to write the results
+ * @param p_stats Counters of the comparison, updated with the compared pairs
  */
-void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix, FILE *f_csv);
+void mh_compare_tile(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+);
 
 /**
  * Computes the range of document indices that the current process must compare as the final step of MinHash.
@@ -97,4 +154,21 @@ void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p
  */
 void get_compare_indices_mpi(struct Arguments args, int *p_i_start_inc, int *p_i_end_exc);
 
+/**
+ * Sum the comparison counters of all processes into the main process.
+ *
+ * @param args Algorithm's arguments
+ * @param p_stats Counters of the current process (on the main process, overwritten with the totals)
+ */
+void reduce_compare_stats_mpi(struct Arguments args, struct CompareStats *p_stats);
+
+/**
+ * Read and normalize the documents of the current process, and group the ones with the same fingerprint
+ * (see duplicates.h). Fingerprints of all processes are merged, so that every process builds the same groups.
+ *
+ * @param args Algorithm's arguments
+ * @return The groups, to be freed with dup_groups_destroy
+ */
+struct DupGroups *mh_group_duplicates(struct Arguments args);
+
 #endif //MULTICOREMINHASH_MINHASH_H
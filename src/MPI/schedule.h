@@ -0,0 +1,117 @@
+#ifndef MULTICOREMINHASH_SCHEDULE_H
+#define MULTICOREMINHASH_SCHEDULE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "structures.h"
+
+/**
+ * Documents of a worker, largest first. <br>
+ * The owner takes documents from the head, thieves from the tail: both ends live in a single atomic word
+ * (head in the low 32 bits, tail in the high 32 bits), so that taking documents is a single compare-and-swap.
+ */
+struct WorkDeque {
+	int *p_docs;
+	_Atomic uint64_t bounds;
+	// Keep the bounds of different workers on different cache lines
+	char padding[64 - sizeof(int *) - sizeof(uint64_t)];
+};
+
+/**
+ * Work-stealing queue of documents, filled longest-processing-time-first: documents are taken by decreasing size
+ * and given to the worker with the least bytes so far. Workers process their own documents largest first,
+ * and steal the smallest documents of the most loaded worker once they run out.
+ */
+struct WorkQueue {
+	struct WorkDeque *p_deques;
+	int n_workers;
+	// Number of steals, for the report
+	atomic_int n_steals;
+};
+
+/**
+ * Returns the size in bytes of each document, read from the manifest if one is given
+ * (documents missing from it are looked up in the index of the pack, or on the file system).
+ * Compressed documents have their compressed size.
+ *
+ * @param args Algorithm's arguments (directory, doc_offset, n_docs, manifest, compression and doc_pack are used)
+ * @return Array of n_docs sizes (0 for missing documents), to be freed
+ */
+long *sched_doc_sizes(struct Arguments args);
+
+/**
+ * Assign documents to workers longest-processing-time-first.
+ *
+ * @param p_sizes Size of each document
+ * @param n_docs Number of documents
+ * @param n_workers Number of workers
+ * @param p_skip Flag of each document telling whether to skip it (NULL to assign all documents)
+ * @param p_owner Where to store the worker of each document (-1 for skipped documents)
+ */
+void sched_lpt_assign(const long *p_sizes, int n_docs, int n_workers, const uint8_t *p_skip, int *p_owner);
+
+/**
+ * Returns the documents sorted by decreasing size (ties by index).
+ *
+ * @param p_sizes Size of each document
+ * @param n_docs Number of documents
+ * @return Array of n_docs document indices, to be freed
+ */
+int *sched_lpt_order(const long *p_sizes, int n_docs);
+
+/**
+ * Assign documents to workers as a static OpenMP schedule does: chunks of consecutive documents,
+ * split into contiguous ranges of the same number of chunks (one more for the first workers).
+ *
+ * @param n_docs Number of documents
+ * @param chunk Number of documents in a chunk
+ * @param n_workers Number of workers
+ * @param p_static_owner Where to store the worker of each document
+ */
+void sched_static_assign(int n_docs, int chunk, int n_workers, int *p_static_owner);
+
+/**
+ * Create a work-stealing queue holding the documents assigned longest-processing-time-first.
+ *
+ * @param p_sizes Size of each document
+ * @param n_docs Number of documents
+ * @param n_workers Number of workers
+ * @param p_skip Flag of each document telling whether to skip it (NULL to process all documents)
+ * @return The queue, to be destroyed with wq_destroy
+ */
+struct WorkQueue *wq_create(const long *p_sizes, int n_docs, int n_workers, const uint8_t *p_skip);
+
+/**
+ * Take up to max_docs documents: the largest ones of the worker, or the smallest ones of the most loaded
+ * worker if it has none left. Can be called by all the workers at once.
+ *
+ * @param queue The queue
+ * @param worker Index of the calling worker
+ * @param p_docs Where to store the taken documents
+ * @param max_docs Maximum number of documents to take
+ * @return Number of taken documents (0 once all documents are taken)
+ */
+int wq_pop(struct WorkQueue *queue, int worker, int *p_docs, int max_docs);
+
+/**
+ * Free the queue memory.
+ *
+ * @param queue The queue
+ */
+void wq_destroy(struct WorkQueue *queue);
+
+/**
+ * Print the time saved by a schedule compared to the static one, from the time each document took:
+ * the makespan of each schedule is the busiest worker's total.
+ *
+ * @param p_doc_times Seconds spent on each document
+ * @param p_owner Worker of each document in the schedule used (-1 for skipped documents)
+ * @param p_static_owner Worker of each document in the static schedule
+ * @param n_docs Number of documents
+ * @param n_workers Number of workers
+ */
+void sched_report(const double *p_doc_times, const int *p_owner, const int *p_static_owner, int n_docs,
+				  int n_workers);
+
+#endif //MULTICOREMINHASH_SCHEDULE_H
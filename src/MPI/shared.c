@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared.h"
+#include "bbit.h"
+
+struct SharedMatrices *shared_allocate(struct Arguments args) {
+
+	struct SharedMatrices *shared = calloc(1, sizeof(struct SharedMatrices));
+
+	// Processes sharing memory, the first of which leads the node
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, args.proc.my_rank, MPI_INFO_NULL, &shared->node_comm);
+	MPI_Comm_rank(shared->node_comm, &shared->node_rank);
+	MPI_Comm_size(shared->node_comm, &shared->node_size);
+	MPI_Comm_split(MPI_COMM_WORLD, shared->node_rank == 0 ? 0 : MPI_UNDEFINED, args.proc.my_rank,
+				   &shared->leader_comm);
+
+	// Every process learns the leader of the node of each process
+	int my_root = 0;
+	if (shared->node_rank == 0)
+		MPI_Comm_rank(shared->leader_comm, &my_root);
+	MPI_Bcast(&my_root, 1, MPI_INT, 0, shared->node_comm);
+
+	shared->p_roots = malloc(args.proc.comm_sz * sizeof(int));
+	MPI_Allgather(&my_root, 1, MPI_INT, shared->p_roots, 1, MPI_INT, MPI_COMM_WORLD);
+
+	// Only the leader allocates the matrices, the others map them
+	const size_t signature_bytes = (size_t) args.n_docs * bbit_words(args.signature_size, args.bbit) * sizeof(uint32_t);
+	const size_t bands_bytes = (size_t) args.n_docs * args.n_bands * sizeof(uint64_t);
+	const int leader = shared->node_rank == 0;
+	void *p_base;
+	MPI_Aint size;
+	int disp_unit;
+
+	MPI_Win_allocate_shared(leader ? (MPI_Aint) signature_bytes : 0, sizeof(uint32_t), MPI_INFO_NULL,
+							shared->node_comm, &p_base, &shared->signature_win);
+	MPI_Win_shared_query(shared->signature_win, 0, &size, &disp_unit, &shared->p_signatures);
+
+	MPI_Win_allocate_shared(leader ? (MPI_Aint) bands_bytes : 0, sizeof(uint64_t), MPI_INFO_NULL, shared->node_comm,
+							&p_base, &shared->bands_win);
+	MPI_Win_shared_query(shared->bands_win, 0, &size, &disp_unit, &shared->p_bands);
+
+	if (args.verbose && leader)
+		printf("[Rank %2d] Node of %d processes: %.1f MB of shared matrices\n", args.proc.my_rank, shared->node_size,
+			   (double) (signature_bytes + bands_bytes) / (1024.0 * 1024.0));
+
+	return shared;
+}
+
+void shared_sync(struct Arguments args, struct SharedMatrices *shared, const uint32_t *p_my_signatures,
+				 const uint64_t *p_my_bands) {
+
+	// Words of a (possibly packed) signature
+	const int size_sig = bbit_words(args.signature_size, args.bbit);
+	const int doc_disp = args.proc.doc_disp;
+	const int my_first_doc = args.proc.my_rank * doc_disp;
+
+	MPI_Win_fence(0, shared->signature_win);
+	MPI_Win_fence(0, shared->bands_win);
+
+	// Rows of the current process, in place in the matrices of its node
+	if (args.proc.my_n_docs > 0) {
+		memcpy(shared->p_signatures + (size_t) my_first_doc * size_sig, p_my_signatures,
+			   (size_t) args.proc.my_n_docs * size_sig * sizeof(uint32_t));
+		memcpy(shared->p_bands + (size_t) my_first_doc * args.n_bands, p_my_bands,
+			   (size_t) args.proc.my_n_docs * args.n_bands * sizeof(uint64_t));
+	}
+
+	// Rows of all the processes of the node are written
+	MPI_Win_fence(0, shared->signature_win);
+	MPI_Win_fence(0, shared->bands_win);
+
+	// Leaders send the rows of their node to the other nodes (consecutive processes of a node at once)
+	if (shared->leader_comm != MPI_COMM_NULL)
+		for (int first = 0, end; first < args.proc.comm_sz; first = end) {
+
+			for (end = first + 1; end < args.proc.comm_sz && shared->p_roots[end] == shared->p_roots[first]; ++end);
+
+			const int first_doc = first * doc_disp;
+			const int n_docs = (end * doc_disp < args.n_docs ? end * doc_disp : args.n_docs) - first_doc;
+
+			if (n_docs <= 0)
+				continue;
+
+			MPI_Bcast(shared->p_signatures + (size_t) first_doc * size_sig, n_docs * size_sig, MPI_UNSIGNED,
+					  shared->p_roots[first], shared->leader_comm);
+			MPI_Bcast(shared->p_bands + (size_t) first_doc * args.n_bands, n_docs * args.n_bands, MPI_UINT64_T,
+					  shared->p_roots[first], shared->leader_comm);
+		}
+
+	// Rows received by the leader are visible to the node
+	MPI_Win_fence(0, shared->signature_win);
+	MPI_Win_fence(0, shared->bands_win);
+
+	if (args.verbose)
+		printf("[Rank %2d] Memory synchronized (shared by %d processes).\n", args.proc.my_rank, shared->node_size);
+
+}
+
+void shared_free(struct SharedMatrices *shared) {
+
+	MPI_Win_free(&shared->signature_win);
+	MPI_Win_free(&shared->bands_win);
+
+	if (shared->leader_comm != MPI_COMM_NULL)
+		MPI_Comm_free(&shared->leader_comm);
+	MPI_Comm_free(&shared->node_comm);
+
+	free(shared->p_roots);
+	free(shared);
+
+}
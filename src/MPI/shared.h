@@ -0,0 +1,60 @@
+#ifndef MULTICOREMINHASH_SHARED_H
+#define MULTICOREMINHASH_SHARED_H
+
+#include <stdint.h>
+#include <mpi/mpi.h>
+
+#include "structures.h"
+
+/**
+ * Signature and bands matrices allocated once per node, in MPI shared-memory windows. <br>
+ * The processes of a node copy their rows into the node's matrices; then only one leader process per node
+ * takes part in the broadcasts between the nodes, and every process compares on the node's copy.
+ */
+struct SharedMatrices {
+	// Processes of the same node, and leaders of all nodes (MPI_COMM_NULL on the other processes)
+	MPI_Comm node_comm;
+	MPI_Comm leader_comm;
+	int node_rank;
+	int node_size;
+	// Windows holding the matrices (on the leader), and their address in the current process
+	MPI_Win signature_win;
+	MPI_Win bands_win;
+	uint32_t *p_signatures;
+	uint64_t *p_bands;
+	// Rank in leader_comm of the leader of the node of each process
+	int *p_roots;
+};
+
+/**
+ * Allocate the matrices of the node of the current process (rows of bbit_words(args.signature_size, args.bbit)
+ * words), and find the leaders of all nodes. <br>
+ * Collective: all processes must call it.
+ *
+ * @param args Algorithm's arguments
+ * @return The matrices, to be freed with shared_free
+ */
+struct SharedMatrices *shared_allocate(struct Arguments args);
+
+/**
+ * Copy the rows of the current process into the matrices of its node, then broadcast the rows of each node
+ * to the leaders of the others. Once done, the matrices of every node hold all the rows. <br>
+ * Collective: all processes must call it.
+ *
+ * @param args Algorithm's arguments
+ * @param shared The matrices
+ * @param p_my_signatures Signatures of the documents of the current process (packed, if args.bbit is set)
+ * @param p_my_bands Bands of the documents of the current process
+ */
+void shared_sync(struct Arguments args, struct SharedMatrices *shared, const uint32_t *p_my_signatures,
+				 const uint64_t *p_my_bands);
+
+/**
+ * Free the matrices and the communicators. <br>
+ * Collective: all processes must call it.
+ *
+ * @param shared The matrices
+ */
+void shared_free(struct SharedMatrices *shared);
+
+#endif //MULTICOREMINHASH_SHARED_H
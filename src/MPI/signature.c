@@ -0,0 +1,106 @@
+#include <stdint.h>
+
+#include "signature.h"
+#include "hash.h"
+#include "utils.h"
+
+void mh_document_signature(
+		const char *data,
+		const size_t size,
+		struct Tokens *tokens,
+		struct ShingleSet *p_dedup,
+		const int shingle_size,
+		const enum ShingleMode shingle_mode,
+		uint32_t *signature,
+		const int signature_size,
+		const int seed,
+		const struct Kernels *kernels
+) {
+
+	// Set all signature values to max
+	for (int i = 0; i < signature_size; i++) {
+		signature[i] = UINT32_MAX;
+	}
+
+	// Split the document into normalized words
+	tokenize(data, size, tokens);
+
+	if (shingle_mode == SHINGLE_CHARS) {
+
+		// No shingle if the text is shorter than a shingle
+		if (tokens->text_len < (size_t) shingle_size)
+			return;
+
+		// Fingerprint of the first window, then slide it one character at a time
+		const uint64_t factor = rolling_hash_factor(shingle_size);
+		const int n_shingles = (int) tokens->text_len - shingle_size + 1;
+		uint64_t fingerprint = rolling_hash(tokens->text, shingle_size);
+
+		if (p_dedup)
+			shingle_set_reset(p_dedup, n_shingles, NULL);
+
+		for (int c = 0; c < n_shingles; ++c) {
+
+			// The fingerprint stands for the shingle (skip it if already seen)
+			if (!p_dedup || shingle_set_insert_fingerprint(p_dedup, fingerprint))
+				kernels->signature_update(signature, signature_size, &fingerprint, sizeof(fingerprint), seed);
+
+			if (c + 1 < n_shingles)
+				fingerprint = rolling_hash_roll(fingerprint, tokens->text[c], tokens->text[c + shingle_size], factor);
+		}
+
+		return;
+	}
+
+	if (p_dedup)
+		shingle_set_reset(p_dedup, tokens->n_words, tokens->text);
+
+	// Loop over all shingles (a shingle is a substring of the normalized text)
+	for (int w = 0; w + shingle_size <= tokens->n_words; ++w) {
+
+		const int shingle_start = tokens->word_starts[w];
+		const int shingle_len = tokens->word_ends[w + shingle_size - 1] - shingle_start;
+
+		// Skip shingle if already seen
+		if (p_dedup && !shingle_set_insert_substring(p_dedup, shingle_start, shingle_len))
+			continue;
+
+		kernels->signature_update(signature, signature_size, tokens->text + shingle_start, shingle_len, seed);
+	}
+
+}
+
+void signature_update(uint32_t *signature, const int signature_size, const void *shingle, const int shingle_len,
+					  const int seed) {
+
+	uint32_t current_hash;
+
+	for (int i = 0; i < signature_size; ++i) {
+
+		// Hash shingle and save if min
+		current_hash = murmur_hash(shingle, shingle_len, seed * i);
+		if (current_hash < signature[i])
+			signature[i] = current_hash;
+	}
+
+}
+
+void signature_update_xxh3(uint32_t *signature, const int signature_size, const void *shingle, const int shingle_len,
+						   const int seed) {
+
+	for (int i = 0; i < signature_size; ++i) {
+		const uint32_t current_hash = hash_xxh3(shingle, shingle_len, seed * i);
+		signature[i] = current_hash < signature[i] ? current_hash : signature[i];
+	}
+
+}
+
+void signature_update_crc32c(uint32_t *signature, const int signature_size, const void *shingle,
+							 const int shingle_len, const int seed) {
+
+	for (int i = 0; i < signature_size; ++i) {
+		const uint32_t current_hash = hash_crc32c(shingle, shingle_len, seed * i);
+		signature[i] = current_hash < signature[i] ? current_hash : signature[i];
+	}
+
+}
@@ -0,0 +1,68 @@
+#ifndef MULTICOREMINHASH_SIGNATURE_H
+#define MULTICOREMINHASH_SIGNATURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernels.h"
+#include "structures.h"
+#include "tokenizer.h"
+#include "shingle_set.h"
+
+/**
+ * Compute the signature of a document already loaded in memory. <br>
+ * The document is split into normalized words, and a shingle is built from every run of n consecutive words
+ * (or, in characters mode, from every run of n consecutive characters of the normalized text).
+ * Each shingle is then hashed and the minimum hashes are stored in the signature array.
+ * If a dedup set is given, repeated shingles are hashed only once (the signature doesn't change).
+ *
+ * @param data Content of the document (not copied)
+ * @param size Number of bytes in data
+ * @param tokens Tokenizer memory, reused across documents
+ * @param p_dedup Set of the document's shingles, reused across documents (NULL to hash every occurrence)
+ * @param shingle_size Size of a shingle
+ * @param shingle_mode Whether shingles are made of words or characters
+ * @param signature Array to store the signature
+ * @param signature_size Size of the signature array
+ * @param seed Seed for the hash function
+ * @param kernels Kernels of the configuration
+ */
+void mh_document_signature(
+		const char *data,
+		const size_t size,
+		struct Tokens *tokens,
+		struct ShingleSet *p_dedup,
+		const int shingle_size,
+		const enum ShingleMode shingle_mode,
+		uint32_t *signature,
+		const int signature_size,
+		const int seed,
+		const struct Kernels *kernels
+);
+
+/**
+ * Update a signature with a shingle: each signature row keeps the minimum between its value
+ * and the hash of the shingle with the row's seed.
+ *
+ * @param signature Signature array
+ * @param signature_size Size of the signature array
+ * @param shingle Shingle bytes
+ * @param shingle_len Number of shingle bytes
+ * @param seed Seed for the hash function
+ */
+void signature_update(uint32_t *signature, const int signature_size, const void *shingle, const int shingle_len,
+					  const int seed);
+
+/**
+ * Same as signature_update, hashing with xxh3 (see hash.h).
+ */
+void signature_update_xxh3(uint32_t *signature, const int signature_size, const void *shingle, const int shingle_len,
+						   const int seed);
+
+/**
+ * Same as signature_update, hashing with crc32c (see hash.h).
+ */
+void signature_update_crc32c(uint32_t *signature, const int signature_size, const void *shingle,
+							 const int shingle_len, const int seed);
+
+#endif //MULTICOREMINHASH_SIGNATURE_H
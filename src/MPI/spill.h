@@ -0,0 +1,143 @@
+#ifndef MULTICOREMINHASH_SPILL_H
+#define MULTICOREMINHASH_SPILL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "structures.h"
+
+/**
+ * Disk file holding the signature and bands rows of all documents, used when the matrices don't fit in memory. <br>
+ * The file contains the whole signature matrix, followed by the whole bands matrix,
+ * so that any block of consecutive documents can be read with two reads.
+ */
+struct SpillFile {
+	int fd;
+	// Number of documents, signature size and number of bands
+	int n_docs;
+	int signature_size;
+	int n_bands;
+	// Path of the file
+	char *path;
+};
+
+/**
+ * Background read of a block of rows from a spill file, used to load the next tile while the current one is compared.
+ */
+struct SpillPrefetch {
+	pthread_t thread;
+	// Whether a read is in progress
+	bool active;
+	// Read request
+	struct SpillFile *spill;
+	int first_doc;
+	int n_docs;
+	uint32_t *p_signatures;
+	uint64_t *p_bands;
+	// Seconds spent waiting for reads that were not done yet
+	double wait_time;
+};
+
+/**
+ * Open (or create) the spill file of the given arguments.
+ * If the file can't be opened, the program exits.
+ *
+ * @param args Algorithm's arguments (spill_path and matrix sizes are used)
+ * @param create Whether to create (and size) the file
+ * @return The opened spill file
+ */
+struct SpillFile *spill_open(struct Arguments args, bool create);
+
+/**
+ * Close the spill file, and optionally delete it.
+ *
+ * @param spill The spill file
+ * @param remove_file Whether to delete the file
+ */
+void spill_close(struct SpillFile *spill, bool remove_file);
+
+/**
+ * Write the rows of consecutive documents.
+ *
+ * @param spill The spill file
+ * @param first_doc Index of the first document
+ * @param n_docs Number of documents
+ * @param p_signatures Signature rows of the documents
+ * @param p_bands Bands rows of the documents
+ */
+void spill_write(struct SpillFile *spill, int first_doc, int n_docs, const uint32_t *p_signatures,
+				 const uint64_t *p_bands);
+
+/**
+ * Read the rows of consecutive documents.
+ *
+ * @param spill The spill file
+ * @param first_doc Index of the first document
+ * @param n_docs Number of documents
+ * @param p_signatures Where to store the signature rows
+ * @param p_bands Where to store the bands rows
+ */
+void spill_read(struct SpillFile *spill, int first_doc, int n_docs, uint32_t *p_signatures, uint64_t *p_bands);
+
+/**
+ * Start reading rows in the background. The buffers must not be used until spill_prefetch_wait returns.
+ *
+ * @param prefetch Prefetch state (wait_time must be initialized)
+ * @param spill The spill file
+ * @param first_doc Index of the first document
+ * @param n_docs Number of documents
+ * @param p_signatures Where to store the signature rows
+ * @param p_bands Where to store the bands rows
+ */
+void spill_prefetch_start(struct SpillPrefetch *prefetch, struct SpillFile *spill, int first_doc, int n_docs,
+						  uint32_t *p_signatures, uint64_t *p_bands);
+
+/**
+ * Wait for the background read to complete (no-op if no read is in progress).
+ *
+ * @param prefetch Prefetch state
+ */
+void spill_prefetch_wait(struct SpillPrefetch *prefetch);
+
+/**
+ * Compares the document pairs of a tile, made of two blocks of consecutive documents.
+ * If both blocks are the same, each pair is compared once.
+ */
+typedef void (*spill_tile_fn)(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+);
+
+/**
+ * Compare the given tiles, loading their blocks from the spill file. <br>
+ * Blocks live in three buffers: two for the current tile, and one where the block needed by the next tile
+ * is read in the background while the current tile is compared.
+ * Tiles should be ordered so that consecutive tiles share a block (e.g. row by row).
+ *
+ * @param args Algorithm's arguments
+ * @param spill The spill file
+ * @param block_docs Number of documents in a block (see spill_block_docs)
+ * @param p_tiles Block indices of each tile (two per tile)
+ * @param n_tiles Number of tiles
+ * @param compare_tile Function comparing a tile
+ * @param f_csv Open CSV file where to write the results
+ * @param p_stats Counters of the comparison, updated by compare_tile
+ * @return Seconds spent waiting for blocks to be read
+ */
+double spill_compare_tiles(struct Arguments args, struct SpillFile *spill, int block_docs, const int *p_tiles,
+						   int n_tiles, spill_tile_fn compare_tile, FILE *f_csv, struct CompareStats *p_stats);
+
+/**
+ * Returns how many documents fit in a block, so that three blocks (two compared and one being prefetched)
+ * stay within the memory limit. If not even one document fits, the program exits.
+ *
+ * @param args Algorithm's arguments
+ * @return Number of documents in a block
+ */
+int spill_block_docs(struct Arguments args);
+
+#endif //MULTICOREMINHASH_SPILL_H
@@ -0,0 +1,325 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZER_X86
+#endif
+
+#include "tokenizer.h"
+
+// Number of bytes classified at once
+#define CHUNK_SIZE 32
+
+/**
+ * Classification of a chunk of CHUNK_SIZE bytes.
+ * Bit j of each mask refers to the j-th byte of the chunk.
+ */
+struct ChunkClass {
+	// Chunk with uppercase letters turned lowercase (plus CHUNK_SIZE bytes of slack)
+	char lowered[2 * CHUNK_SIZE];
+	// Bytes in [a-z0-9] after lowercasing
+	uint32_t alnum;
+	// Whitespace bytes (as in isspace)
+	uint32_t space;
+	// Null bytes (they terminate the word read by fscanf)
+	uint32_t nul;
+};
+
+/**
+ * State of the tokenizer between chunks.
+ */
+struct TokenizerState {
+	struct Tokens *tokens;
+	// Write position in the text
+	size_t out;
+	// Whether the current word has at least one character
+	bool in_word;
+	// Whether the rest of the current whitespace-delimited token must be dropped (after a null byte)
+	bool dead;
+};
+
+/**
+ * Classify a chunk one byte at a time (used when SIMD instructions are not available).
+ */
+static inline __attribute__((always_inline)) void classify_scalar(const char *p_chunk, struct ChunkClass *cls) {
+
+	cls->alnum = cls->space = cls->nul = 0;
+
+	for (int j = 0; j < CHUNK_SIZE; ++j) {
+		const char c = p_chunk[j];
+		const char lc = ('A' <= c && c <= 'Z') ? (char) (c | 0x20) : c;
+
+		cls->lowered[j] = lc;
+		cls->alnum |= (uint32_t) (('a' <= lc && lc <= 'z') || ('0' <= lc && lc <= '9')) << j;
+		cls->space |= (uint32_t) (c == ' ' || ('\t' <= c && c <= '\r')) << j;
+		cls->nul |= (uint32_t) (c == '\0') << j;
+	}
+
+}
+
+#ifdef TOKENIZER_X86
+
+/**
+ * Classify 16 bytes with SSE2 instructions.
+ * Signed comparisons are fine, since bytes above 0x7f are negative and fall outside all the ranges.
+ */
+static inline __attribute__((always_inline)) void classify_16_sse2(
+		const char *p_chunk, char *p_lowered, uint32_t *p_alnum, uint32_t *p_space, uint32_t *p_nul
+) {
+
+	const __m128i c = _mm_loadu_si128((const __m128i *) p_chunk);
+
+	const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+										_mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+	const __m128i lc = _mm_or_si128(c, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+
+	const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+										_mm_cmplt_epi8(lc, _mm_set1_epi8('z' + 1)));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+										_mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+									   _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('\t' - 1)),
+													 _mm_cmplt_epi8(c, _mm_set1_epi8('\r' + 1))));
+
+	_mm_storeu_si128((__m128i *) p_lowered, lc);
+	*p_alnum = (uint32_t) _mm_movemask_epi8(_mm_or_si128(alpha, digit));
+	*p_space = (uint32_t) _mm_movemask_epi8(space);
+	*p_nul = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_setzero_si128()));
+
+}
+
+/**
+ * Classify a chunk as two halves of 16 bytes (SSE2 is always available on x86-64).
+ */
+static inline __attribute__((always_inline)) void classify_sse2(const char *p_chunk, struct ChunkClass *cls) {
+
+	uint32_t alnum_hi, space_hi, nul_hi;
+
+	classify_16_sse2(p_chunk, cls->lowered, &cls->alnum, &cls->space, &cls->nul);
+	classify_16_sse2(p_chunk + 16, cls->lowered + 16, &alnum_hi, &space_hi, &nul_hi);
+
+	cls->alnum |= alnum_hi << 16;
+	cls->space |= space_hi << 16;
+	cls->nul |= nul_hi << 16;
+
+}
+
+/**
+ * Classify a whole chunk with AVX2 instructions.
+ */
+static inline __attribute__((always_inline, target("avx2"))) void classify_avx2(
+		const char *p_chunk, struct ChunkClass *cls
+) {
+
+	const __m256i c = _mm256_loadu_si256((const __m256i *) p_chunk);
+
+	const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)),
+										   _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+	const __m256i lc = _mm256_or_si256(c, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+
+	const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)),
+										   _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lc));
+	const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+										   _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+	const __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+										  _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('\t' - 1)),
+														   _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), c)));
+
+	_mm256_storeu_si256((__m256i *) cls->lowered, lc);
+	cls->alnum = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(alpha, digit));
+	cls->space = (uint32_t) _mm256_movemask_epi8(space);
+	cls->nul = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_setzero_si256()));
+
+}
+
+#endif
+
+/**
+ * Append a character to the current word, starting a new word if needed.
+ */
+static inline void emit_char(struct TokenizerState *state, char c) {
+
+	struct Tokens *tokens = state->tokens;
+
+	if (!state->in_word) {
+		// Separate from previous word
+		if (tokens->n_words > 0)
+			tokens->text[state->out++] = ' ';
+		tokens->word_starts[tokens->n_words] = (int) state->out;
+		state->in_word = true;
+	}
+
+	tokens->text[state->out++] = c;
+
+}
+
+/**
+ * Close the current word (if it has any character).
+ */
+static inline void end_word(struct TokenizerState *state) {
+
+	if (state->in_word) {
+		state->tokens->word_ends[state->tokens->n_words++] = (int) state->out;
+		state->in_word = false;
+	}
+
+}
+
+/**
+ * Emit the words of a classified chunk one byte at a time.
+ * Used for chunks containing null bytes, where fscanf semantics need per-byte state.
+ */
+static void process_chunk_bytes(struct TokenizerState *state, const struct ChunkClass *cls) {
+
+	for (int j = 0; j < CHUNK_SIZE; ++j) {
+
+		const uint32_t bit = 1U << j;
+
+		if (cls->space & bit) {
+			end_word(state);
+			state->dead = false;
+		} else if (cls->nul & bit)
+			state->dead = true;
+		else if (!state->dead && (cls->alnum & bit))
+			emit_char(state, cls->lowered[j]);
+	}
+
+}
+
+/**
+ * Emit the words of a classified chunk, copying whole runs of alphanumeric bytes at once.
+ */
+static inline __attribute__((always_inline)) void process_chunk(
+		struct TokenizerState *state, const struct ChunkClass *cls
+) {
+
+	// Rare case, handled byte by byte
+	if (cls->nul || state->dead) {
+		process_chunk_bytes(state, cls);
+		return;
+	}
+
+	struct Tokens *tokens = state->tokens;
+	uint32_t todo = cls->alnum | cls->space;
+
+	while (todo) {
+
+		const int start = __builtin_ctz(todo);
+
+		if (cls->alnum & (1U << start)) {
+
+			// Length of the run of alphanumeric bytes
+			const uint32_t rest = ~(cls->alnum >> start);
+			const int len = rest ? __builtin_ctz(rest) : CHUNK_SIZE - start;
+
+			emit_char(state, cls->lowered[start]);
+
+			// Fixed-size copy, only len - 1 bytes are kept
+			memcpy(tokens->text + state->out, cls->lowered + start + 1, CHUNK_SIZE);
+			state->out += len - 1;
+
+			todo &= (start + len < CHUNK_SIZE) ? ~0U << (start + len) : 0;
+
+		} else {
+
+			end_word(state);
+
+			// Skip the run of whitespace bytes
+			const uint32_t rest = ~(cls->space >> start);
+			const int len = rest ? __builtin_ctz(rest) : CHUNK_SIZE - start;
+
+			todo &= (start + len < CHUNK_SIZE) ? ~0U << (start + len) : 0;
+		}
+	}
+
+}
+
+/**
+ * Tokenizer main loop, specialized by the compiler for each classification function.
+ */
+static inline __attribute__((always_inline)) void tokenize_loop(
+		const char *data, size_t size, struct Tokens *tokens,
+		void (*classify)(const char *, struct ChunkClass *)
+) {
+
+	struct TokenizerState state = {tokens, 0, false, false};
+	struct ChunkClass cls;
+	size_t pos;
+
+	memset(cls.lowered + CHUNK_SIZE, 0, CHUNK_SIZE);
+
+	for (pos = 0; pos + CHUNK_SIZE <= size; pos += CHUNK_SIZE) {
+		classify(data + pos, &cls);
+		process_chunk(&state, &cls);
+	}
+
+	// Last partial chunk, padded with whitespace
+	if (pos < size) {
+		char tail[CHUNK_SIZE];
+		memset(tail, ' ', CHUNK_SIZE);
+		memcpy(tail, data + pos, size - pos);
+
+		classify(tail, &cls);
+		process_chunk(&state, &cls);
+	}
+
+	end_word(&state);
+	tokens->text_len = state.out;
+
+}
+
+static void tokenize_generic(const char *data, size_t size, struct Tokens *tokens) {
+#ifdef TOKENIZER_X86
+	tokenize_loop(data, size, tokens, classify_sse2);
+#else
+	tokenize_loop(data, size, tokens, classify_scalar);
+#endif
+}
+
+#ifdef TOKENIZER_X86
+__attribute__((target("avx2")))
+static void tokenize_avx2(const char *data, size_t size, struct Tokens *tokens) {
+	tokenize_loop(data, size, tokens, classify_avx2);
+}
+#endif
+
+void tokenize(const char *data, size_t size, struct Tokens *tokens) {
+
+	// Text can't be longer than the document (plus slack for the fixed-size copies)
+	if (tokens->text_capacity < size + 2 * CHUNK_SIZE) {
+		tokens->text_capacity = size + 2 * CHUNK_SIZE;
+		tokens->text = realloc(tokens->text, tokens->text_capacity);
+	}
+
+	// Every word needs at least two bytes (character and separator)
+	const int max_words = (int) (size / 2 + 1);
+	if (tokens->words_capacity < max_words) {
+		tokens->words_capacity = max_words;
+		tokens->word_starts = realloc(tokens->word_starts, max_words * sizeof(int));
+		tokens->word_ends = realloc(tokens->word_ends, max_words * sizeof(int));
+	}
+
+	tokens->n_words = 0;
+
+#ifdef TOKENIZER_X86
+	if (__builtin_cpu_supports("avx2")) {
+		tokenize_avx2(data, size, tokens);
+		return;
+	}
+#endif
+
+	tokenize_generic(data, size, tokens);
+
+}
+
+void tokens_free(struct Tokens *tokens) {
+
+	free(tokens->text);
+	free(tokens->word_starts);
+	free(tokens->word_ends);
+	memset(tokens, 0, sizeof(struct Tokens));
+
+}
@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "bbit.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BBIT_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Lowest bit of each row of a word, for every row width.
+ */
+static const uint32_t row_low_bits[9] = {0, 0xffffffff, 0x55555555, 0, 0x11111111, 0, 0, 0, 0x01010101};
+
+/**
+ * Number of rows that differ between two packed signatures (inlined with a constant row width).
+ */
+__attribute__((always_inline)) static inline int mismatches_body(const uint32_t *p_signature1,
+																 const uint32_t *p_signature2, int n_words,
+																 const int bbit) {
+
+	int n_mismatches = 0;
+
+	for (int w = 0; w < n_words; ++w) {
+
+		// A row differs if any of its bits does: fold them on its lowest bit
+		uint32_t diff = p_signature1[w] ^ p_signature2[w];
+		for (int shift = 1; shift < bbit; shift <<= 1)
+			diff |= diff >> shift;
+
+		n_mismatches += __builtin_popcount(diff & row_low_bits[bbit]);
+	}
+
+	return n_mismatches;
+}
+
+#define BBIT_MISMATCHES_SWITCH                                                                                         \
+	switch (bbit) {                                                                                                    \
+		case 1:                                                                                                        \
+			return mismatches_body(p_signature1, p_signature2, n_words, 1);                                            \
+		case 2:                                                                                                        \
+			return mismatches_body(p_signature1, p_signature2, n_words, 2);                                            \
+		case 4:                                                                                                        \
+			return mismatches_body(p_signature1, p_signature2, n_words, 4);                                            \
+		default:                                                                                                       \
+			return mismatches_body(p_signature1, p_signature2, n_words, 8);                                            \
+	}
+
+static int bbit_mismatches(const uint32_t *p_signature1, const uint32_t *p_signature2, int n_words, int bbit) {
+	BBIT_MISMATCHES_SWITCH
+}
+
+#ifdef BBIT_X86
+/**
+ * Same as mismatches_body, 8 words at a time: the folded bits are counted with the nibble lookup of pshufb.
+ */
+__attribute__((target("avx2"), always_inline)) static inline int mismatches_body_avx2(const uint32_t *p_signature1,
+																					  const uint32_t *p_signature2,
+																					  int n_words, const int bbit) {
+
+	const __m256i low_bits = _mm256_set1_epi32((int) row_low_bits[bbit]);
+	const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+	const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+												   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	__m256i counts = _mm256_setzero_si256();
+	int w = 0;
+
+	for (; w + 8 <= n_words; w += 8) {
+
+		__m256i diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (p_signature1 + w)),
+										_mm256_loadu_si256((const __m256i *) (p_signature2 + w)));
+		for (int shift = 1; shift < bbit; shift <<= 1)
+			diff = _mm256_or_si256(diff, _mm256_srli_epi32(diff, shift));
+		diff = _mm256_and_si256(diff, low_bits);
+
+		// Bits of each byte, summed per 64-bit lane
+		const __m256i bytes = _mm256_add_epi8(
+				_mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(diff, nibble_mask)),
+				_mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(_mm256_srli_epi32(diff, 4), nibble_mask)));
+		counts = _mm256_add_epi64(counts, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+	}
+
+	int n_mismatches = (int) (_mm256_extract_epi64(counts, 0) + _mm256_extract_epi64(counts, 1)
+							  + _mm256_extract_epi64(counts, 2) + _mm256_extract_epi64(counts, 3));
+
+	return n_mismatches + mismatches_body(p_signature1 + w, p_signature2 + w, n_words - w, bbit);
+}
+
+#define BBIT_MISMATCHES_AVX2_SWITCH                                                                                    \
+	switch (bbit) {                                                                                                    \
+		case 1:                                                                                                        \
+			return mismatches_body_avx2(p_signature1, p_signature2, n_words, 1);                                       \
+		case 2:                                                                                                        \
+			return mismatches_body_avx2(p_signature1, p_signature2, n_words, 2);                                       \
+		case 4:                                                                                                        \
+			return mismatches_body_avx2(p_signature1, p_signature2, n_words, 4);                                       \
+		default:                                                                                                       \
+			return mismatches_body_avx2(p_signature1, p_signature2, n_words, 8);                                       \
+	}
+
+__attribute__((target("avx2,popcnt"))) static int bbit_mismatches_avx2(const uint32_t *p_signature1,
+																	   const uint32_t *p_signature2, int n_words,
+																	   int bbit) {
+	BBIT_MISMATCHES_AVX2_SWITCH
+}
+
+__attribute__((target("popcnt"))) static int bbit_mismatches_popcnt(const uint32_t *p_signature1,
+																	 const uint32_t *p_signature2, int n_words,
+																	 int bbit) {
+	BBIT_MISMATCHES_SWITCH
+}
+#endif
+
+void bbit_pack(uint32_t *p_signature_matrix, int n_docs, int signature_size, int bbit) {
+
+	const int n_words = bbit_words(signature_size, bbit);
+	const int rows_per_word = 32 / bbit;
+	const uint32_t row_mask = (1u << bbit) - 1;
+	uint32_t packed[n_words];
+
+	// Packed rows are never longer than full ones: rows are packed in order, each one is read before being overwritten
+	for (int i = 0; i < n_docs; ++i) {
+
+		const uint32_t *p_signature = p_signature_matrix + (size_t) i * signature_size;
+
+		memset(packed, 0, sizeof(packed));
+
+		for (int r = 0; r < signature_size; ++r)
+			packed[r / rows_per_word] |= (p_signature[r] & row_mask) << (r % rows_per_word * bbit);
+
+		memcpy(p_signature_matrix + (size_t) i * n_words, packed, sizeof(packed));
+	}
+
+}
+
+float bbit_similarity(const uint32_t *p_signature1, const uint32_t *p_signature2, int signature_size, int bbit) {
+
+	const int n_words = bbit_words(signature_size, bbit);
+	int n_mismatches;
+
+#ifdef BBIT_X86
+	if (__builtin_cpu_supports("avx2"))
+		n_mismatches = bbit_mismatches_avx2(p_signature1, p_signature2, n_words, bbit);
+	else if (__builtin_cpu_supports("popcnt"))
+		n_mismatches = bbit_mismatches_popcnt(p_signature1, p_signature2, n_words, bbit);
+	else
+#endif
+		n_mismatches = bbit_mismatches(p_signature1, p_signature2, n_words, bbit);
+
+	// Padding rows of the last word are zero in both signatures. With e the equal fraction and c = 2^-b,
+	// (e - c) / (1 - c) is (equal rows * 2^b - rows) / (rows * (2^b - 1)), a single division
+	const int excess = ((signature_size - n_mismatches) << bbit) - signature_size;
+
+	return excess > 0 ? (float) excess / (float) (signature_size * ((1 << bbit) - 1)) : 0;
+}
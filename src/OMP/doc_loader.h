@@ -0,0 +1,136 @@
+#ifndef MULTICOREMINHASH_DOC_LOADER_H
+#define MULTICOREMINHASH_DOC_LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "structures.h"
+
+/**
+ * Growable buffer holding the whole content of a document.
+ * The memory is reused across documents and only grows.
+ */
+struct DocBuffer {
+	// Content of the document (not null-terminated)
+	char *data;
+	// Number of bytes in data
+	size_t size;
+	// Allocated bytes in data
+	size_t capacity;
+};
+
+/**
+ * Corpus packed in a single file, where the documents (compressed or not) follow each other. <br>
+ * The index (<pack>.idx) has a line "<doc_number> <offset> <bytes>" per document, locating it in the pack.
+ * The pack is opened once and read by all the loaders with pread.
+ */
+struct DocPack {
+	// Packed documents
+	int fd;
+	const char *path;
+	// Number of the first indexed document, and number of indexed documents (the ones of the run)
+	int first_doc;
+	int n_docs;
+	// Offset and bytes of each document in the pack (-1 if not in the index)
+	long *p_offsets;
+	long *p_sizes;
+};
+
+/**
+ * Loads batches of documents into memory.
+ * When available, the io_uring backend submits the open/read/close requests of a whole batch at once,
+ * otherwise documents are read one after the other with pread. <br>
+ * Compressed documents are read a chunk at a time and inflated straight into their buffer,
+ * so a loader decompresses in bounded memory without temporary files (io_uring only loads plain files).
+ * A loader must be used by one thread at a time: threads and processes decompress their documents in parallel.
+ */
+struct DocLoader;
+
+/**
+ * Create a document loader, reading the documents as args.io_backend, args.compression and args.doc_pack tell.
+ * If the io_uring backend is requested but not supported by the kernel, pread is used instead.
+ *
+ * @param args Algorithm's arguments
+ * @param batch_size Maximum number of documents in a batch
+ * @return The loader, to be destroyed with loader_destroy
+ */
+struct DocLoader *loader_create(struct Arguments args, int batch_size);
+
+/**
+ * Returns whether the loader is using io_uring.
+ *
+ * @param loader The loader
+ * @return True if io_uring is being used, false if pread is being used
+ */
+bool loader_uses_uring(const struct DocLoader *loader);
+
+/**
+ * Load a batch of numbered documents (directory/number.txt, with the suffix of the compression,
+ * or the indexed documents of the pack) into the given buffers, decompressed.
+ * If a document can't be opened or decompressed, the program exits.
+ *
+ * @param loader The loader
+ * @param directory Directory of the documents
+ * @param doc_numbers Numbers of the documents to load
+ * @param buffers Buffers where to load each document
+ * @param count Number of documents (at most the loader batch size)
+ */
+void loader_read(struct DocLoader *loader, const char *directory, const int *doc_numbers,
+				 struct DocBuffer **buffers, int count);
+
+/**
+ * Decompress a document already in memory, as the loader would have once read (plain documents are copied).
+ * If the document can't be decompressed, the program exits.
+ *
+ * @param loader The loader
+ * @param data Content of the document, as stored
+ * @param size Number of bytes in data
+ * @param name Name of the document, for the errors
+ * @param buffer Buffer where to store the decompressed content
+ */
+void loader_decode(struct DocLoader *loader, const char *data, size_t size, const char *name,
+				   struct DocBuffer *buffer);
+
+/**
+ * Free the loader resources.
+ *
+ * @param loader The loader
+ */
+void loader_destroy(struct DocLoader *loader);
+
+/**
+ * Read the whole content of a file into a buffer, using pread.
+ * If the file can't be opened, the program exits.
+ *
+ * @param filepath Path to the file
+ * @param buffer Buffer where to store the content
+ */
+void read_file_to_buffer(const char *filepath, struct DocBuffer *buffer);
+
+/**
+ * File name suffix of the documents with the given compression.
+ *
+ * @param compression Compression of the documents
+ * @return ".txt", ".txt.gz" or ".txt.zst"
+ */
+const char *loader_suffix(enum Compression compression);
+
+/**
+ * Open a packed corpus and read the entries of its index (<path>.idx) for the documents of a run.
+ * If the pack or its index can't be opened, the program exits.
+ *
+ * @param path Path to the pack
+ * @param first_doc Number of the first document of the run
+ * @param n_docs Number of documents of the run
+ * @return The pack, to be closed with pack_close
+ */
+struct DocPack *pack_open(const char *path, int first_doc, int n_docs);
+
+/**
+ * Close a packed corpus.
+ *
+ * @param pack The pack
+ */
+void pack_close(struct DocPack *pack);
+
+#endif //MULTICOREMINHASH_DOC_LOADER_H
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+
+#include "duplicates.h"
+#include "hash.h"
+
+// Seeds of the two halves of a fingerprint
+#define DUP_SEED_LOW 0x9e3779b97f4a7c15
+#define DUP_SEED_HIGH 0xc2b2ae3d27d4eb4f
+
+/**
+ * Fingerprints used by the comparison function of qsort.
+ */
+static const uint64_t *p_sort_fingerprints;
+
+/**
+ * Order document indices by fingerprint, then by index.
+ */
+static int fingerprint_cmp(const void *p_a, const void *p_b);
+
+/**
+ * Whether two documents have the same fingerprint.
+ */
+static inline int same_fingerprint(const uint64_t *p_fingerprints, int a, int b) {
+	return p_fingerprints[2 * (size_t) a] == p_fingerprints[2 * (size_t) b] &&
+		   p_fingerprints[2 * (size_t) a + 1] == p_fingerprints[2 * (size_t) b + 1];
+}
+
+void dup_fingerprint(const char *text, size_t len, uint64_t *p_fingerprint) {
+
+	p_fingerprint[0] = xxh3_64(text, len, DUP_SEED_LOW);
+	p_fingerprint[1] = xxh3_64(text, len, DUP_SEED_HIGH);
+
+}
+
+struct DupGroups *dup_groups_build(const uint64_t *p_fingerprints, int n_docs) {
+
+	struct DupGroups *groups = malloc(sizeof(struct DupGroups));
+	int *p_order = malloc((n_docs > 0 ? n_docs : 1) * sizeof(int));
+
+	groups->n_docs = n_docs;
+	groups->p_rep = malloc((n_docs > 0 ? n_docs : 1) * sizeof(int));
+	groups->p_next = malloc((n_docs > 0 ? n_docs : 1) * sizeof(int));
+	groups->p_member = calloc(n_docs > 0 ? n_docs : 1, sizeof(uint8_t));
+	groups->n_groups = 0;
+	groups->n_members = 0;
+
+	// Identical fingerprints are next to each other, by increasing document
+	for (int i = 0; i < n_docs; ++i)
+		p_order[i] = i;
+
+	p_sort_fingerprints = p_fingerprints;
+	qsort(p_order, n_docs, sizeof(int), fingerprint_cmp);
+
+	for (int k = 0; k < n_docs; ++k) {
+
+		const int i = p_order[k];
+		groups->p_next[i] = -1;
+
+		const int previous = k > 0 ? p_order[k - 1] : -1;
+
+		if (previous >= 0 && same_fingerprint(p_fingerprints, previous, i)) {
+
+			// Appended to the group of the previous document
+			groups->p_rep[i] = groups->p_rep[previous];
+			groups->p_next[previous] = i;
+			groups->p_member[i] = 1;
+			groups->n_members++;
+
+			if (groups->p_rep[previous] == previous)
+				groups->n_groups++;
+		} else
+			groups->p_rep[i] = i;
+	}
+
+	free(p_order);
+
+	return groups;
+}
+
+unsigned long dup_groups_write_pairs(const struct DupGroups *groups, int rep1, int rep2, float similarity,
+									 int doc_offset, FILE *f_csv) {
+
+	unsigned long n_pairs = 0;
+
+	for (int a = rep1; a >= 0; a = groups->p_next[a])
+		for (int b = rep2; b >= 0; b = groups->p_next[b]) {
+
+			if (f_csv)
+				fprintf(f_csv, "%d,%d,%.4f\n", (a < b ? a : b) + doc_offset, (a < b ? b : a) + doc_offset,
+						similarity);
+			n_pairs++;
+		}
+
+	return n_pairs;
+}
+
+unsigned long dup_groups_write_inner(const struct DupGroups *groups, int first_doc, int end_doc, int doc_offset,
+									 FILE *f_csv) {
+
+	unsigned long n_pairs = 0;
+
+	for (int rep = first_doc; rep < end_doc; ++rep) {
+
+		if (groups->p_member[rep])
+			continue;
+
+		// Documents of a group are linked by increasing index
+		for (int a = rep; a >= 0; a = groups->p_next[a])
+			for (int b = groups->p_next[a]; b >= 0; b = groups->p_next[b]) {
+
+				if (f_csv)
+					fprintf(f_csv, "%d,%d,%.4f\n", a + doc_offset, b + doc_offset, 1.0f);
+				n_pairs++;
+			}
+	}
+
+	return n_pairs;
+}
+
+void dup_groups_destroy(struct DupGroups *groups) {
+
+	free(groups->p_rep);
+	free(groups->p_next);
+	free(groups->p_member);
+	free(groups);
+
+}
+
+static int fingerprint_cmp(const void *p_a, const void *p_b) {
+
+	const int a = *(const int *) p_a;
+	const int b = *(const int *) p_b;
+
+	for (int h = 0; h < 2; ++h)
+		if (p_sort_fingerprints[2 * (size_t) a + h] != p_sort_fingerprints[2 * (size_t) b + h])
+			return p_sort_fingerprints[2 * (size_t) a + h] < p_sort_fingerprints[2 * (size_t) b + h] ? -1 : 1;
+
+	return a - b;
+}
@@ -0,0 +1,80 @@
+#ifndef MULTICOREMINHASH_DUPLICATES_H
+#define MULTICOREMINHASH_DUPLICATES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * Groups of documents whose normalized text is identical (same 128-bit fingerprint). <br>
+ * The first document of a group is its representative: only its signature is computed and compared,
+ * and its pairs stand for the pairs of every member of its group (identical text gives identical signatures).
+ */
+struct DupGroups {
+	int n_docs;
+	// Representative of each document (itself for representatives and documents without duplicates)
+	int *p_rep;
+	// Next document of the group of each document (-1 for the last one), starting from the representative
+	int *p_next;
+	// Whether each document is a duplicate of an earlier one (1) or a representative (0)
+	uint8_t *p_member;
+	// Groups of at least two documents
+	int n_groups;
+	// Documents that are duplicates of an earlier one
+	int n_members;
+};
+
+/**
+ * Compute the 128-bit fingerprint of a normalized text (two XXH3 hashes with different seeds).
+ *
+ * @param text Normalized text
+ * @param len Number of bytes in text
+ * @param p_fingerprint Where to store the two 64-bit halves of the fingerprint
+ */
+void dup_fingerprint(const char *text, size_t len, uint64_t *p_fingerprint);
+
+/**
+ * Group the documents with the same fingerprint, each group led by its first document.
+ *
+ * @param p_fingerprints Two 64-bit halves of the fingerprint of each document
+ * @param n_docs Number of documents
+ * @return The groups, to be freed with dup_groups_destroy
+ */
+struct DupGroups *dup_groups_build(const uint64_t *p_fingerprints, int n_docs);
+
+/**
+ * Write the pairs made of a document of each of two groups, with the similarity of their representatives,
+ * as the comparison would have (lower document first).
+ *
+ * @param groups The groups
+ * @param rep1 Representative of the first group
+ * @param rep2 Representative of the second group
+ * @param similarity Similarity of the representatives
+ * @param doc_offset Offset of the document numbers
+ * @param f_csv Open CSV file where to write the pairs (NULL to only count them)
+ * @return Number of pairs
+ */
+unsigned long dup_groups_write_pairs(const struct DupGroups *groups, int rep1, int rep2, float similarity,
+									 int doc_offset, FILE *f_csv);
+
+/**
+ * Write the pairs of documents of the same group, whose similarity is 1.
+ *
+ * @param groups The groups
+ * @param first_doc First representative whose group is written
+ * @param end_doc Representatives from first_doc up to end_doc (excluded) are written
+ * @param doc_offset Offset of the document numbers
+ * @param f_csv Open CSV file where to write the pairs
+ * @return Number of pairs
+ */
+unsigned long dup_groups_write_inner(const struct DupGroups *groups, int first_doc, int end_doc, int doc_offset,
+									 FILE *f_csv);
+
+/**
+ * Free the groups.
+ *
+ * @param groups The groups
+ */
+void dup_groups_destroy(struct DupGroups *groups);
+
+#endif //MULTICOREMINHASH_DUPLICATES_H
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "forest.h"
+#include "kernels.h"
+
+/**
+ * Rows of a tree compared by the sort of its leaves.
+ */
+struct TreeRows {
+	const uint32_t *p_signatures;
+	int signature_size;
+	int first_row;
+	int depth;
+};
+
+/**
+ * Compare the first rows of a tree of two signatures (negative, zero or positive).
+ */
+static int prefix_cmp(const uint32_t *p_signature1, const uint32_t *p_signature2, int first_row, int depth);
+
+/**
+ * Order the leaves of a tree by their rows, then by document index (qsort_r).
+ */
+static int leaf_cmp(const void *p_a, const void *p_b, void *p_rows);
+
+/**
+ * Order matches by decreasing similarity, then by document index.
+ */
+static int match_cmp(const void *p_a, const void *p_b);
+
+/**
+ * Add the documents sharing the first depth rows of every tree with a signature to the candidates of the query.
+ * Returns the number of candidates.
+ */
+static int forest_gather(const struct LshForest *forest, const uint32_t *p_signature, int depth, int exclude,
+						 struct ForestScratch *scratch, int n_candidates);
+
+/**
+ * Compute the similarity of the candidates, keep the ones above the threshold and sort them.
+ * Returns the number of matches.
+ */
+static int forest_verify(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature,
+						 float threshold, const struct ForestScratch *scratch, int n_candidates,
+						 struct ForestMatch *p_matches);
+
+struct LshForest *forest_build(struct Arguments args, const uint32_t *p_signatures) {
+
+	struct LshForest *forest = malloc(sizeof(struct LshForest));
+
+	forest->n_trees = args.forest_trees;
+	forest->depth = args.signature_size / args.forest_trees;
+	forest->n_docs = args.n_docs;
+	forest->signature_size = args.signature_size;
+	forest->p_signatures = p_signatures;
+	forest->p_leaves = malloc(((size_t) forest->n_trees * forest->n_docs + 1) * sizeof(int));
+
+	if (forest->p_leaves == NULL) {
+		printf("Error allocating the LSH Forest\n");
+		exit(2);
+	}
+
+	// Trees are sorted independently
+	#pragma omp parallel for default(none) shared(forest) schedule(dynamic)
+	for (int t = 0; t < forest->n_trees; ++t) {
+
+		int *p_leaves = forest->p_leaves + (size_t) t * forest->n_docs;
+		struct TreeRows rows = {forest->p_signatures, forest->signature_size, t * forest->depth, forest->depth};
+
+		for (int i = 0; i < forest->n_docs; ++i)
+			p_leaves[i] = i;
+
+		qsort_r(p_leaves, forest->n_docs, sizeof(int), leaf_cmp, &rows);
+	}
+
+	return forest;
+}
+
+int forest_depth(const struct LshForest *forest, float threshold) {
+
+	// Collision probability of a pair of the given similarity, from the longest prefix
+	for (int d = forest->depth; d > 0; --d) {
+
+		double p_prefix = 1, p_none = 1;
+
+		for (int r = 0; r < d; ++r)
+			p_prefix *= threshold;
+
+		for (int t = 0; t < forest->n_trees; ++t)
+			p_none *= 1 - p_prefix;
+
+		if (1 - p_none >= FOREST_RECALL)
+			return d;
+	}
+
+	return 0;
+}
+
+int forest_threshold(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature,
+					 float threshold, int exclude, struct ForestScratch *scratch, struct ForestMatch *p_matches) {
+
+	scratch->query++;
+
+	const int n_candidates = forest_gather(forest, p_signature, forest_depth(forest, threshold), exclude, scratch, 0);
+
+	return forest_verify(forest, args, p_signature, threshold, scratch, n_candidates, p_matches);
+}
+
+int forest_top_k(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature, int k,
+				 int exclude, struct ForestScratch *scratch, struct ForestMatch *p_matches) {
+
+	int n_candidates = 0;
+
+	scratch->query++;
+
+	// Shorter prefixes until there are enough candidates (longer prefixes are included in shorter ones)
+	for (int d = forest->depth; d >= 0 && n_candidates < FOREST_CANDIDATES_PER_RESULT * k; --d)
+		n_candidates = forest_gather(forest, p_signature, d, exclude, scratch, n_candidates);
+
+	const int n_matches = forest_verify(forest, args, p_signature, 0, scratch, n_candidates, p_matches);
+
+	return n_matches < k ? n_matches : k;
+}
+
+void forest_scratch_init(const struct LshForest *forest, struct ForestScratch *scratch) {
+
+	scratch->p_seen = malloc((forest->n_docs + 1) * sizeof(int));
+	scratch->p_candidates = malloc((forest->n_docs + 1) * sizeof(int));
+	scratch->query = 0;
+
+	for (int i = 0; i < forest->n_docs; ++i)
+		scratch->p_seen[i] = 0;
+
+}
+
+void forest_scratch_free(struct ForestScratch *scratch) {
+
+	free(scratch->p_seen);
+	free(scratch->p_candidates);
+
+}
+
+void forest_destroy(struct LshForest *forest) {
+
+	free(forest->p_leaves);
+	free(forest);
+
+}
+
+static int prefix_cmp(const uint32_t *p_signature1, const uint32_t *p_signature2, int first_row, int depth) {
+
+	for (int r = first_row; r < first_row + depth; ++r)
+		if (p_signature1[r] != p_signature2[r])
+			return p_signature1[r] < p_signature2[r] ? -1 : 1;
+
+	return 0;
+}
+
+static int leaf_cmp(const void *p_a, const void *p_b, void *p_rows) {
+
+	const struct TreeRows *rows = (const struct TreeRows *) p_rows;
+	const int a = *(const int *) p_a;
+	const int b = *(const int *) p_b;
+
+	const int cmp = prefix_cmp(rows->p_signatures + (size_t) a * rows->signature_size,
+							   rows->p_signatures + (size_t) b * rows->signature_size, rows->first_row, rows->depth);
+
+	return cmp ? cmp : a - b;
+}
+
+static int match_cmp(const void *p_a, const void *p_b) {
+
+	const struct ForestMatch *a = (const struct ForestMatch *) p_a;
+	const struct ForestMatch *b = (const struct ForestMatch *) p_b;
+
+	if (a->similarity != b->similarity)
+		return a->similarity > b->similarity ? -1 : 1;
+
+	return a->doc - b->doc;
+}
+
+static int forest_gather(const struct LshForest *forest, const uint32_t *p_signature, int depth, int exclude,
+						 struct ForestScratch *scratch, int n_candidates) {
+
+	// Without prefix, every document is a candidate (a single tree is enough)
+	const int n_trees = depth > 0 ? forest->n_trees : 1;
+
+	for (int t = 0; t < n_trees; ++t) {
+
+		const int *p_leaves = forest->p_leaves + (size_t) t * forest->n_docs;
+		const int first_row = t * forest->depth;
+
+		// First leaf whose prefix is not lower than the query's one
+		int low = 0, high = forest->n_docs;
+		while (low < high) {
+			const int mid = low + (high - low) / 2;
+			if (prefix_cmp(forest->p_signatures + (size_t) p_leaves[mid] * forest->signature_size, p_signature,
+						   first_row, depth) < 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		// Leaves of the subtree
+		for (int l = low; l < forest->n_docs; ++l) {
+
+			const int doc = p_leaves[l];
+
+			if (prefix_cmp(forest->p_signatures + (size_t) doc * forest->signature_size, p_signature, first_row,
+						   depth) != 0)
+				break;
+
+			if (doc != exclude && scratch->p_seen[doc] != scratch->query) {
+				scratch->p_seen[doc] = scratch->query;
+				scratch->p_candidates[n_candidates++] = doc;
+			}
+		}
+	}
+
+	return n_candidates;
+}
+
+static int forest_verify(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature,
+						 float threshold, const struct ForestScratch *scratch, int n_candidates,
+						 struct ForestMatch *p_matches) {
+
+	int n_matches = 0;
+
+	for (int c = 0; c < n_candidates; ++c) {
+
+		const int doc = scratch->p_candidates[c];
+		const float similarity = args.kernels->signature_similarity(
+				forest->p_signatures + (size_t) doc * forest->signature_size, p_signature, forest->signature_size);
+
+		if (similarity >= threshold) {
+			p_matches[n_matches].doc = doc;
+			p_matches[n_matches].similarity = similarity;
+			n_matches++;
+		}
+	}
+
+	qsort(p_matches, n_matches, sizeof(struct ForestMatch), match_cmp);
+
+	return n_matches;
+}
@@ -0,0 +1,123 @@
+#ifndef MULTICOREMINHASH_FOREST_H
+#define MULTICOREMINHASH_FOREST_H
+
+#include <stdint.h>
+
+#include "structures.h"
+
+// Probability that a pair at the queried threshold shares a prefix, used to choose the prefix length
+#define FOREST_RECALL 0.95
+
+// Candidates gathered for each result of a top-k query
+#define FOREST_CANDIDATES_PER_RESULT 2
+
+/**
+ * LSH Forest over a signature matrix: each tree uses its own consecutive rows of the signatures,
+ * and documents sharing the first d rows of a tree are in the same subtree at depth d. <br>
+ * A tree is stored as its leaves, the documents sorted by their rows in lexicographic order,
+ * so a subtree is a range of them found by binary search.
+ * Shorter prefixes mean more candidates, so a single index answers queries for any threshold.
+ */
+struct LshForest {
+	int n_trees;
+	// Rows of the signature used by each tree (maximum depth)
+	int depth;
+	int n_docs;
+	int signature_size;
+	// Signature matrix (not copied)
+	const uint32_t *p_signatures;
+	// For each tree, the n_docs documents sorted by the tree's rows
+	int *p_leaves;
+};
+
+/**
+ * Memory of a thread querying a forest.
+ */
+struct ForestScratch {
+	// Last query whose candidates included each document (to gather a document once)
+	int *p_seen;
+	int query;
+	// Candidates of the current query
+	int *p_candidates;
+};
+
+/**
+ * A document answering a query.
+ */
+struct ForestMatch {
+	int doc;
+	float similarity;
+};
+
+/**
+ * Build a forest over a signature matrix, sorting the trees in parallel.
+ *
+ * @param args Algorithm's arguments (number of trees, signature size and number of documents are used)
+ * @param p_signatures Signature matrix, which must outlive the forest
+ * @return The forest
+ */
+struct LshForest *forest_build(struct Arguments args, const uint32_t *p_signatures);
+
+/**
+ * Returns the longest prefix whose documents include the pairs of a given similarity
+ * with probability FOREST_RECALL at least (1 - (1 - s^d)^n_trees for prefixes of d rows).
+ *
+ * @param forest The forest
+ * @param threshold Similarity
+ * @return The prefix length (0 means all documents)
+ */
+int forest_depth(const struct LshForest *forest, float threshold);
+
+/**
+ * Find the documents at least as similar as a threshold to a signature.
+ *
+ * @param forest The forest
+ * @param args Algorithm's arguments (the kernels are used)
+ * @param p_signature Signature of the query
+ * @param threshold Minimum similarity
+ * @param exclude Document not to report (the query itself, -1 if none)
+ * @param scratch Memory of the calling thread
+ * @param p_matches Where to store the matches (up to the number of documents), by decreasing similarity
+ * @return Number of matches
+ */
+int forest_threshold(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature,
+					 float threshold, int exclude, struct ForestScratch *scratch, struct ForestMatch *p_matches);
+
+/**
+ * Find the k documents most similar to a signature, shortening the prefixes until enough candidates are found.
+ *
+ * @param forest The forest
+ * @param args Algorithm's arguments (the kernels are used)
+ * @param p_signature Signature of the query
+ * @param k Number of documents
+ * @param exclude Document not to report (the query itself, -1 if none)
+ * @param scratch Memory of the calling thread
+ * @param p_matches Where to store the matches (up to the number of documents), by decreasing similarity
+ * @return Number of matches (at most k)
+ */
+int forest_top_k(const struct LshForest *forest, struct Arguments args, const uint32_t *p_signature, int k,
+				 int exclude, struct ForestScratch *scratch, struct ForestMatch *p_matches);
+
+/**
+ * Create the memory of a thread querying a forest.
+ *
+ * @param forest The forest
+ * @param scratch The memory to initialize
+ */
+void forest_scratch_init(const struct LshForest *forest, struct ForestScratch *scratch);
+
+/**
+ * Free the memory of a thread querying a forest.
+ *
+ * @param scratch The memory
+ */
+void forest_scratch_free(struct ForestScratch *scratch);
+
+/**
+ * Free the forest (not the signature matrix).
+ *
+ * @param forest The forest
+ */
+void forest_destroy(struct LshForest *forest);
+
+#endif //MULTICOREMINHASH_FOREST_H
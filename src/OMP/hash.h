@@ -0,0 +1,76 @@
+#ifndef MULTICOREMINHASH_HASH_H
+#define MULTICOREMINHASH_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "structures.h"
+
+/**
+ * Seeded 32-bit hash of a shingle: the signature row i of a document keeps the minimum of hash(shingle, seed * i).
+ *
+ * @param key Array containing data to hash
+ * @param len Size of the array
+ * @param seed Initialization seed
+ * @return The hash value
+ */
+typedef uint32_t (*hash_fn)(const void *key, int len, uint32_t seed);
+
+/**
+ * XXH3 (64 bits) with a seed, credit to Yann Collet. <br>
+ * Returns the same values as XXH3_64bits_withSeed of the reference implementation.
+ *
+ * @param key Array containing data to hash
+ * @param len Size of the array
+ * @param seed Initialization seed
+ * @return The hash value
+ */
+uint64_t xxh3_64(const void *key, size_t len, uint64_t seed);
+
+/**
+ * Low 32 bits of xxh3_64.
+ *
+ * @param key Array containing data to hash
+ * @param len Size of the array
+ * @param seed Initialization seed
+ * @return The hash value
+ */
+uint32_t hash_xxh3(const void *key, int len, uint32_t seed);
+
+/**
+ * Updates a CRC32C (Castagnoli) checksum with the SSE4.2 instruction if the CPU has it,
+ * with a lookup table otherwise (both give the same values). <br>
+ * Note: the checksum is not inverted before and after, the caller chooses the initial value.
+ *
+ * @param crc Current checksum (initial value for the first data)
+ * @param data Data to add to the checksum
+ * @param len Size of the data
+ * @return The updated checksum
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/**
+ * Same as crc32c, always with the lookup table (for benchmarks).
+ */
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t len);
+
+/**
+ * CRC32C of the data starting from the seed, mixed with the MurmurHash3 finalizer:
+ * a CRC is linear, so the rows of a signature would be correlated without it.
+ *
+ * @param key Array containing data to hash
+ * @param len Size of the array
+ * @param seed Initialization seed
+ * @return The hash value
+ */
+uint32_t hash_crc32c(const void *key, int len, uint32_t seed);
+
+/**
+ * Returns the hash function of a family.
+ *
+ * @param family Hash family
+ * @return The seeded 32-bit hash function
+ */
+hash_fn hash_select(enum HashFamily family);
+
+#endif //MULTICOREMINHASH_HASH_H
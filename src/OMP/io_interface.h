@@ -1,8 +1,6 @@
 #ifndef MULTICOREMINHASH_IO_INTERFACE_H
 #define MULTICOREMINHASH_IO_INTERFACE_H
 
-#include <stdio.h>
-
 #include "structures.h"
 
 /**
@@ -26,33 +24,28 @@ struct Arguments input_arguments(const int argc, const char *argv[]);
 struct Arguments default_arguments();
 
 /**
- * Print the given arguments.
+ * Parse the configurations of a parameter sweep, a list of <signature>:<bandrows>:<threshold>
+ * separated by commas (band rows must divide the signature size, thresholds are between 0 and 1).
  *
- * @param args The arguments to be printed
+ * @param sweep The list of configurations
+ * @param p_configs Where to store the configurations (NULL to only count them)
+ * @return The number of configurations, 0 if the list is invalid
  */
-void print_arguments(struct Arguments args);
+int parse_sweep(const char *sweep, struct SweepConfig *p_configs);
 
 /**
- * Reads a word from an already opened p_file. <br>
- * Note: the returned string must be freed by the caller.
- * 
- * @param p_file The opened p_file
- * @return The read word, or NULL if no word could be read
+ * Print the given arguments.
+ *
+ * @param args The arguments to be printed
  */
-char *read_word_from_file(FILE *p_file);
-
+void print_arguments(struct Arguments args);
 
 /**
- * Returns a string containing a shingle read from a given file. <br>
- * Note: The returned string's memory must be freed by the caller. <br>
- * Note: Once no more shingles are to be read, the caller must free the memory used by p_words. <br>
- * Note: discarded (oldest) words from p_words are freed by the function.
- * 
- * @param file Open file to read from
- * @param shingle_size Size (in words) of a shingle
- * @param p_words An array of words (strings) previously read, handled by the function
- * @return The shingle read from the file, or NULL if no shingle could be read
+ * Print the counters of the comparison phase, with the share of candidate pairs that didn't need to be verified.
+ *
+ * @param args The arguments
+ * @param stats Counters of the comparison phase
  */
-char *read_shingle_from_file(FILE *file, const unsigned int shingle_size, char **p_words);
+void print_compare_stats(struct Arguments args, struct CompareStats stats);
 
 #endif //MULTICOREMINHASH_IO_INTERFACE_H
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+
+#include "lsh_buckets.h"
+
+/**
+ * Order entries by key, then by document index.
+ */
+static int lsh_entry_cmp(const void *p_a, const void *p_b);
+
+bool lsh_buckets_build(struct LshBuckets *buckets, const uint64_t *p_bands, int n_docs, int n_bands) {
+
+	buckets->n_docs = n_docs;
+	buckets->n_bands = n_bands;
+	buckets->p_entries = malloc((size_t) n_docs * n_bands * sizeof(struct LshEntry) + 1);
+
+	if (buckets->p_entries == NULL)
+		return false;
+
+	for (int j = 0; j < n_bands; ++j) {
+
+		struct LshEntry *p_band = buckets->p_entries + (size_t) j * n_docs;
+
+		for (int i = 0; i < n_docs; ++i) {
+			p_band[i].key = p_bands[(size_t) i * n_bands + j];
+			p_band[i].doc = i;
+		}
+
+		qsort(p_band, n_docs, sizeof(struct LshEntry), lsh_entry_cmp);
+	}
+
+	return true;
+}
+
+const struct LshEntry *lsh_buckets_band(const struct LshBuckets *buckets, int band) {
+	return buckets->p_entries + (size_t) band * buckets->n_docs;
+}
+
+const struct LshEntry *lsh_buckets_find(const struct LshBuckets *buckets, int band, uint64_t key, int *p_count) {
+
+	const struct LshEntry *p_band = lsh_buckets_band(buckets, band);
+
+	// First entry with a key not lower than the searched one
+	int low = 0, high = buckets->n_docs;
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		if (p_band[mid].key < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	int end = low;
+	while (end < buckets->n_docs && p_band[end].key == key)
+		++end;
+
+	*p_count = end - low;
+	return p_band + low;
+}
+
+void lsh_buckets_free(struct LshBuckets *buckets) {
+
+	free(buckets->p_entries);
+	buckets->p_entries = NULL;
+
+}
+
+static int lsh_entry_cmp(const void *p_a, const void *p_b) {
+
+	const struct LshEntry *a = (const struct LshEntry *) p_a;
+	const struct LshEntry *b = (const struct LshEntry *) p_b;
+
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+
+	return a->doc - b->doc;
+}
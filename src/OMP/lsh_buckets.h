@@ -0,0 +1,67 @@
+#ifndef MULTICOREMINHASH_LSH_BUCKETS_H
+#define MULTICOREMINHASH_LSH_BUCKETS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A document in the bucket of a band.
+ */
+struct LshEntry {
+	// Band key (bucket)
+	uint64_t key;
+	// Index of the document
+	int doc;
+};
+
+/**
+ * LSH buckets of all bands: for each band, the documents sorted by band key (then by index),
+ * so that a bucket is a run of entries with the same key. <br>
+ * Sorted arrays are more compact than hash tables and make all the buckets of a band a single scan.
+ */
+struct LshBuckets {
+	int n_docs;
+	int n_bands;
+	// n_bands arrays of n_docs entries each
+	struct LshEntry *p_entries;
+};
+
+/**
+ * Build the buckets from the bands matrix.
+ *
+ * @param buckets Buckets to build
+ * @param p_bands Bands matrix (row i holds the n_bands keys of document i)
+ * @param n_docs Number of documents
+ * @param n_bands Number of bands
+ * @return False if the memory couldn't be allocated
+ */
+bool lsh_buckets_build(struct LshBuckets *buckets, const uint64_t *p_bands, int n_docs, int n_bands);
+
+/**
+ * Returns the entries of a band, sorted by key.
+ *
+ * @param buckets The buckets
+ * @param band Index of the band
+ * @return The n_docs entries of the band
+ */
+const struct LshEntry *lsh_buckets_band(const struct LshBuckets *buckets, int band);
+
+/**
+ * Find the bucket of a key in a band.
+ *
+ * @param buckets The buckets
+ * @param band Index of the band
+ * @param key Band key
+ * @param p_count Where to store the number of documents in the bucket (0 if none)
+ * @return The first entry of the bucket
+ */
+const struct LshEntry *lsh_buckets_find(const struct LshBuckets *buckets, int band, uint64_t key, int *p_count);
+
+/**
+ * Free the buckets memory.
+ *
+ * @param buckets The buckets
+ */
+void lsh_buckets_free(struct LshBuckets *buckets);
+
+#endif //MULTICOREMINHASH_LSH_BUCKETS_H
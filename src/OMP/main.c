@@ -5,6 +5,8 @@
 #include "main.h"
 #include "io_interface.h"
 #include "minhash.h"
+#include "placement.h"
+#include "doc_loader.h"
 
 int main(int argc, char *argv[]) {
 
@@ -29,10 +31,26 @@ int main(int argc, char *argv[]) {
 		return 7;
 	}
 
+	// Pin threads to cores, so that first-touched memory stays local
+	if (args.numa) {
+		placement_pin_threads();
+
+		if (args.verbose)
+			placement_report_threads();
+	}
+
 	#endif
 
+	// Index of the packed corpus, read by all the loaders
+	struct DocPack *pack = NULL;
+	if (args.pack)
+		args.doc_pack = pack = pack_open(args.pack, args.doc_offset, args.n_docs);
+
 	// Start the MinHash algorithm
 	mh_main(args);
 
+	if (pack)
+		pack_close(pack);
+
 	return 0;
 }
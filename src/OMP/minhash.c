@@ -1,9 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <unistd.h>
+
+#ifndef __MP_NONE__
+#include <omp.h>
+#endif
 
 #include "minhash.h"
 #include "io_interface.h"
+#include "prefetch.h"
+#include "placement.h"
+#include "spill.h"
+#include "checkpoint.h"
+#include "schedule.h"
+#include "stream.h"
+#include "lsh_buckets.h"
+#include "forest.h"
+#include "bbit.h"
+#include "plan.h"
+#include "duplicates.h"
 #include "utils.h"
 
 void mh_main(struct Arguments args) {
@@ -11,25 +27,86 @@ void mh_main(struct Arguments args) {
 	// Signature matrix - columns are documents, rows are hashes
 	// Band matrix - columns are documents, rows are bands (hashed)
 	uint32_t *signature_matrix;
-	uint32_t *bands_matrix;
+	uint64_t *bands_matrix;
+
+	// Estimate the run from a sample, without touching its files
+	if (args.plan > 0) {
+		plan_report(args, false);
+		return;
+	}
+
+	// Progress of the run, saved periodically if requested
+	struct Checkpoint *p_ckpt = args.checkpoint_dir ? ckpt_open(args, 0, 1, 0, args.n_docs) : NULL;
+
+	if (args.verbose)
+		printf("Opening report file...\n");
+
+	// Open and write header to CSV file (or keep the results saved by the checkpoint)
+	FILE *csv_file;
+
+	if (p_ckpt && p_ckpt->csv_size > 0)
+		csv_file = ckpt_reopen_csv(p_ckpt, "results.csv");
+	else {
+		csv_file = fopen("results.csv", "w");
+		fprintf(csv_file, "doc1,doc2,similarity\n");
+	}
+
+	// Documents read from a stream, without a fixed range
+	if (args.stream) {
+		mh_main_stream(args, csv_file);
+		fclose(csv_file);
+		return;
+	}
+
+	// Documents of a second corpus, only compared with the first one
+	if (args.join_docs > 0) {
+		mh_main_join(args, csv_file);
+		fclose(csv_file);
+		return;
+	}
+
+	// Queries answered by a forest instead of comparing the bands
+	if (args.forest_trees > 0) {
+		mh_main_forest(args, csv_file);
+		fclose(csv_file);
+		return;
+	}
+
+	// Configurations evaluated on the same signatures
+	if (args.sweep) {
+		mh_main_sweep(args, csv_file);
+		fclose(csv_file);
+		return;
+	}
+
+	// Matrices bigger than the memory limit are kept on disk
+	if (args.memory_limit > 0) {
+		mh_main_out_of_core(args, csv_file);
+		fclose(csv_file);
+		return;
+	}
 
 	if (args.verbose)
 		printf("Allocating memory...\n");
 
 	mh_allocate(args, &signature_matrix, &bands_matrix);
 
-	if (args.verbose)
-		printf("Opening report file...\n");
+	// Documents identical to an earlier one are neither hashed nor compared
+	struct DupGroups *dups = NULL;
+
+	if (args.exact_dups) {
+
+		if (args.verbose)
+			printf("Grouping identical documents...\n");
 
-	// Open and write header to CSV file
-	FILE *csv_file = fopen("results.csv", "w");
-	fprintf(csv_file, "doc1,doc2,similarity\n");
+		args.dups = dups = mh_group_duplicates(args);
+	}
 
 	if (args.verbose)
 		printf("Computing signatures...\n");
 
 	// Compute the signatures of all documents
-	mh_compute_signatures(args, signature_matrix);
+	mh_compute_signatures(args, signature_matrix, p_ckpt);
 
 	if (args.verbose)
 		printf("Computing bands...\n");
@@ -37,167 +114,1112 @@ void mh_main(struct Arguments args) {
 	// Reduce the signatures to bands to faster comparison
 	mh_compute_bands(args, signature_matrix, bands_matrix);
 
+	// Only the low bits of each row are kept for the comparison
+	if (args.bbit)
+		signature_matrix = mh_pack_signatures(args, signature_matrix, args.n_docs);
+
 	if (args.verbose)
 		printf("Comparing documents...\n");
 
 	// Compare all document pairs and write to CSV file
-	mh_compare(args, signature_matrix, bands_matrix, csv_file);
+	struct CompareStats stats = {0};
+	mh_compare(args, signature_matrix, bands_matrix, csv_file, &stats, p_ckpt);
 
-	if (args.verbose)
+	// Pairs of identical documents
+	if (dups)
+		stats.n_duplicates += dup_groups_write_inner(dups, 0, args.n_docs, args.doc_offset, csv_file);
+
+	if (args.verbose) {
+		print_compare_stats(args, stats);
 		printf("Done.\n");
+	}
 
 	// Free memory and close files
-	free(signature_matrix);
-	free(bands_matrix);
+	mh_free(args, signature_matrix, bands_matrix);
 	fclose(csv_file);
 
+	if (dups)
+		dup_groups_destroy(dups);
+
+	// The run is complete, its checkpoint is not needed anymore
+	if (p_ckpt)
+		ckpt_close(p_ckpt, true);
+
+}
+
+void mh_main_out_of_core(struct Arguments args, FILE *f_csv) {
+
+	const int block_docs = spill_block_docs(args);
+	const int n_blocks = (args.n_docs + block_docs - 1) / block_docs;
+
+	if (args.verbose)
+		printf("Out-of-core mode: %d blocks of %d documents, spilled to %s\n", n_blocks, block_docs, args.spill_path);
+
+	struct SpillFile *spill = spill_open(args, true);
+
+	// Rows of the block being computed
+	uint32_t *p_signatures = malloc((size_t) block_docs * args.signature_size * sizeof(uint32_t));
+	uint64_t *p_bands = malloc((size_t) block_docs * args.n_bands * sizeof(uint64_t));
+
+	if (args.verbose)
+		printf("Computing signatures and bands...\n");
+
+	// Compute the rows of each block as if its documents were the whole corpus, then spill them
+	for (int b = 0; b < n_blocks; ++b) {
+
+		struct Arguments block_args = args;
+		block_args.doc_offset = args.doc_offset + b * block_docs;
+		block_args.n_docs = (args.n_docs - b * block_docs < block_docs) ? args.n_docs - b * block_docs : block_docs;
+
+		mh_compute_signatures(block_args, p_signatures, NULL);
+		mh_compute_bands(block_args, p_signatures, p_bands);
+
+		spill_write(spill, b * block_docs, block_args.n_docs, p_signatures, p_bands);
+	}
+
+	free(p_signatures);
+	free(p_bands);
+
+	if (args.verbose)
+		printf("Comparing documents...\n");
+
+	// Tiles of the upper triangle of the pairs matrix, row by row
+	const int n_tiles = n_blocks * (n_blocks + 1) / 2;
+	int *p_tiles = malloc(2 * n_tiles * sizeof(int));
+
+	for (int bi = 0, t = 0; bi < n_blocks; ++bi)
+		for (int bj = bi; bj < n_blocks; ++bj, ++t) {
+			p_tiles[2 * t] = bi;
+			p_tiles[2 * t + 1] = bj;
+		}
+
+	struct CompareStats stats = {0};
+	double wait_time = spill_compare_tiles(args, spill, block_docs, p_tiles, n_tiles, mh_compare_tile, f_csv, &stats);
+
+	if (args.verbose) {
+		printf("Compared %d tiles, %.3f s waiting for the spill file\n", n_tiles, wait_time);
+		print_compare_stats(args, stats);
+		printf("Done.\n");
+	}
+
+	free(p_tiles);
+	spill_close(spill, true);
+
 }
 
-void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint32_t **pp_bands_matrix) {
+void mh_main_stream(struct Arguments args, FILE *f_csv) {
+
+	struct StreamReader *reader = stream_open(args.stream);
+	struct StreamWindow *window = window_create(args);
+	struct StreamLatency *latency = calloc(1, sizeof(struct StreamLatency));
+	int n_threads = 1;
+
+#ifndef __MP_NONE__
+	n_threads = omp_get_max_threads();
+#endif
+
+	// Documents of a batch, with their signatures and bands
+	struct StreamRecord records[args.io_batch];
+	uint32_t *p_signatures = malloc((size_t) args.io_batch * args.signature_size * sizeof(uint32_t));
+	uint64_t *p_bands = malloc((size_t) args.io_batch * args.n_bands * sizeof(uint64_t));
+	long *p_candidates = malloc((size_t) args.window_docs * sizeof(long));
+
+	// Tokenizer and dedup memory of each thread
+	struct Tokens *p_tokens = calloc(n_threads, sizeof(struct Tokens));
+	struct ShingleSet *p_dedups = calloc(n_threads, sizeof(struct ShingleSet));
+
+	memset(records, 0, sizeof(records));
+
+	long n_docs = 0;
+	unsigned long n_matches = 0;
+	double first_arrival = 0;
+
+	if (args.verbose)
+		printf("Reading documents from %s...\n", strcmp(args.stream, "-") == 0 ? "the standard input" : args.stream);
+
+	while (1) {
+
+		// Wait for a document, then take the ones that already arrived
+		int count = 0;
+		while (count < args.io_batch && (count == 0 || stream_ready(reader)) && stream_read(reader, &records[count]))
+			count++;
+
+		if (count == 0)
+			break;
+
+		if (n_docs == 0)
+			first_arrival = records[0].arrival;
+
+		// Signatures and bands of the batch
+		#pragma omp parallel for default(none) shared(args, records, count, p_signatures, p_bands, p_tokens, p_dedups) schedule(dynamic)
+		for (int k = 0; k < count; ++k) {
+
+			int thread = 0;
+
+#ifndef __MP_NONE__
+			thread = omp_get_thread_num();
+#endif
+
+			uint32_t *p_signature = p_signatures + (size_t) k * args.signature_size;
+
+			mh_document_signature(records[k].data, records[k].size, &p_tokens[thread],
+								  args.dedup ? &p_dedups[thread] : NULL, args.shingle_size, args.shingle_mode,
+								  p_signature, args.signature_size, args.seed, args.kernels);
+			args.kernels->compute_bands(p_signature, p_bands + (size_t) k * args.n_bands, args.n_band_rows,
+										args.n_bands);
+		}
+
+		// Match and add the documents in their arrival order
+		for (int k = 0; k < count; ++k) {
+
+			const uint32_t *p_signature = p_signatures + (size_t) k * args.signature_size;
+			const uint64_t *p_doc_bands = p_bands + (size_t) k * args.n_bands;
+			const long seq = window->next;
+
+			if (args.window_seconds > 0)
+				window_evict(window, records[k].arrival - args.window_seconds);
+
+			const int n_candidates = window_candidates(window, p_doc_bands, p_candidates);
+			int n_doc_matches = 0;
+
+			for (int c = 0; c < n_candidates; ++c) {
+
+				const float similarity = args.kernels->signature_similarity(
+						window_signature(window, p_candidates[c]), p_signature, args.signature_size);
+
+				if (similarity >= args.threshold) {
+					fprintf(f_csv, "%ld,%ld,%.4f\n", p_candidates[c] + args.doc_offset, seq + args.doc_offset,
+							similarity);
+					n_doc_matches++;
+				}
+			}
+
+			// Matches are reported as soon as they are found
+			if (n_doc_matches > 0)
+				fflush(f_csv);
+
+			window_insert(window, p_signature, p_doc_bands, records[k].arrival);
+			stream_latency_record(latency, wall_time() - records[k].arrival);
+
+			n_matches += n_doc_matches;
+			n_docs++;
+
+			if (args.verbose && n_docs % args.verbose == 0)
+				stream_report(latency, n_docs, wall_time() - first_arrival, n_matches,
+							  (int) (window->next - window->first));
+		}
+	}
+
+	// Final report, unless the last progress report was on the last document
+	if (!args.verbose || n_docs % args.verbose != 0 || n_docs == 0)
+		stream_report(latency, n_docs, n_docs > 0 ? wall_time() - first_arrival : 0, n_matches,
+					  (int) (window->next - window->first));
+
+	for (int k = 0; k < args.io_batch; ++k)
+		free(records[k].data);
+
+	for (int t = 0; t < n_threads; ++t) {
+		tokens_free(&p_tokens[t]);
+		shingle_set_free(&p_dedups[t]);
+	}
+
+	free(p_tokens);
+	free(p_dedups);
+	free(p_signatures);
+	free(p_bands);
+	free(p_candidates);
+	free(latency);
+	window_destroy(window);
+	stream_close(reader);
+
+}
+
+void mh_main_join(struct Arguments args, FILE *f_csv) {
+
+	// Second corpus: same parameters, other range of documents
+	struct Arguments args_b = args;
+	args_b.directory = args.join_directory;
+	args_b.doc_offset = args.join_offset;
+	args_b.n_docs = args.join_docs;
+	args_b.proc.my_n_docs = args.join_docs;
+
+	// Document sizes of the manifest only apply to the first directory
+	if (strcmp(args_b.directory, args.directory) != 0)
+		args_b.manifest = NULL;
+
+	uint32_t *p_signatures_a, *p_signatures_b;
+	uint64_t *p_bands_a, *p_bands_b;
+
+	if (args.verbose)
+		printf("Allocating memory...\n");
+
+	mh_allocate(args, &p_signatures_a, &p_bands_a);
+	mh_allocate(args_b, &p_signatures_b, &p_bands_b);
+
+	if (args.verbose)
+		printf("Computing signatures...\n");
+
+	mh_compute_signatures(args, p_signatures_a, NULL);
+	mh_compute_signatures(args_b, p_signatures_b, NULL);
+
+	if (args.verbose)
+		printf("Computing bands...\n");
+
+	mh_compute_bands(args, p_signatures_a, p_bands_a);
+	mh_compute_bands(args_b, p_signatures_b, p_bands_b);
+
+	if (args.verbose)
+		printf("Joining documents...\n");
+
+	struct CompareStats stats = {0};
+	mh_join(args, p_signatures_a, p_bands_a, args_b, p_signatures_b, p_bands_b, f_csv, &stats);
+
+	if (args.verbose) {
+		print_compare_stats(args, stats);
+		printf("Done.\n");
+	}
+
+	mh_free(args, p_signatures_a, p_bands_a);
+	mh_free(args_b, p_signatures_b, p_bands_b);
+
+}
+
+void mh_main_forest(struct Arguments args, FILE *f_csv) {
+
+	uint32_t *signature_matrix;
+	uint64_t *bands_matrix;
+
+	if (args.verbose)
+		printf("Allocating memory...\n");
+
+	mh_allocate(args, &signature_matrix, &bands_matrix);
+
+	if (args.verbose)
+		printf("Computing signatures...\n");
+
+	mh_compute_signatures(args, signature_matrix, NULL);
+
+	double start = wall_time();
+	struct LshForest *forest = forest_build(args, signature_matrix);
+
+	printf("Forest of %d trees (%d rows each) built in %.3f s, waiting for queries "
+		   "(top <doc> <k>, near <doc> <threshold>, pairs <threshold>)\n", forest->n_trees, forest->depth,
+		   wall_time() - start);
+
+	struct ForestScratch scratch;
+	struct ForestMatch *p_matches = malloc((args.n_docs + 1) * sizeof(struct ForestMatch));
+	char line[256], command[16];
+	int doc, k;
+	float threshold;
+
+	forest_scratch_init(forest, &scratch);
+
+	while (fgets(line, sizeof(line), stdin)) {
+
+		int n_matches = -1;
+		start = wall_time();
+
+		if (sscanf(line, "%15s", command) != 1)
+			continue;
+
+		if (strcmp(command, "pairs") == 0 && sscanf(line, "%*s %f", &threshold) == 1) {
+
+			unsigned long n_pairs = 0;
+
+			// Results of the previous pairs query are replaced
+			fflush(f_csv);
+			if (ftruncate(fileno(f_csv), 0) != 0) {
+				printf("Error truncating the report file\n");
+				exit(2);
+			}
+			rewind(f_csv);
+			fprintf(f_csv, "doc1,doc2,similarity\n");
+
+			#pragma omp parallel default(none) shared(args, forest, signature_matrix, threshold, f_csv) reduction(+:n_pairs)
+			{
+				struct ForestScratch thread_scratch;
+				struct ForestMatch *p_thread_matches = malloc((args.n_docs + 1) * sizeof(struct ForestMatch));
+
+				forest_scratch_init(forest, &thread_scratch);
+
+				// Each pair is reported by its first document
+				#pragma omp for schedule(dynamic)
+				for (int i = 0; i < args.n_docs; ++i) {
+
+					const int n = forest_threshold(forest, args, signature_matrix + i * args.signature_size,
+												   threshold, i, &thread_scratch, p_thread_matches);
+
+					for (int m = 0; m < n; ++m)
+						if (p_thread_matches[m].doc > i) {
+							++n_pairs;
+							#pragma omp critical
+							fprintf(f_csv, "%d,%d,%.4f\n", i + args.doc_offset,
+									p_thread_matches[m].doc + args.doc_offset, p_thread_matches[m].similarity);
+						}
+				}
+
+				forest_scratch_free(&thread_scratch);
+				free(p_thread_matches);
+			}
+
+			fflush(f_csv);
+			printf("%lu pairs at least %.2f similar (prefixes of %d rows) in %.3f s\n", n_pairs, threshold,
+				   forest_depth(forest, threshold), wall_time() - start);
+			fflush(stdout);
+			continue;
+		}
+
+		if (strcmp(command, "top") == 0 && sscanf(line, "%*s %d %d", &doc, &k) == 2 && k > 0 &&
+			doc >= args.doc_offset && doc - args.doc_offset < args.n_docs) {
+
+			doc -= args.doc_offset;
+			n_matches = forest_top_k(forest, args, signature_matrix + doc * args.signature_size, k, doc, &scratch,
+									 p_matches);
+		}
+
+		else if (strcmp(command, "near") == 0 && sscanf(line, "%*s %d %f", &doc, &threshold) == 2 &&
+				 doc >= args.doc_offset && doc - args.doc_offset < args.n_docs) {
+
+			doc -= args.doc_offset;
+			n_matches = forest_threshold(forest, args, signature_matrix + doc * args.signature_size, threshold, doc,
+										 &scratch, p_matches);
+		}
+
+		if (n_matches < 0) {
+			printf("Unknown query (top <doc> <k>, near <doc> <threshold>, pairs <threshold>)\n");
+			continue;
+		}
+
+		for (int m = 0; m < n_matches; ++m)
+			printf("%d,%.4f\n", p_matches[m].doc + args.doc_offset, p_matches[m].similarity);
+
+		printf("%d documents in %.3f ms\n", n_matches, (wall_time() - start) * 1e3);
+		fflush(stdout);
+	}
+
+	forest_scratch_free(&scratch);
+	free(p_matches);
+	forest_destroy(forest);
+	mh_free(args, signature_matrix, bands_matrix);
+
+}
+
+void mh_main_sweep(struct Arguments args, FILE *f_csv) {
+
+	const int n_configs = parse_sweep(args.sweep, NULL);
+	struct SweepConfig *p_configs = malloc(n_configs * sizeof(struct SweepConfig));
+	parse_sweep(args.sweep, p_configs);
+
+	// The bands matrix holds the bands of any configuration
+	struct Arguments alloc_args = args;
+	for (int c = 0; c < n_configs; ++c)
+		if (p_configs[c].signature_size / p_configs[c].n_band_rows > alloc_args.n_bands)
+			alloc_args.n_bands = p_configs[c].signature_size / p_configs[c].n_band_rows;
+
+	uint32_t *signature_matrix;
+	uint64_t *bands_matrix;
+
+	if (args.verbose)
+		printf("Allocating memory...\n");
+
+	mh_allocate(alloc_args, &signature_matrix, &bands_matrix);
+
+	if (args.verbose)
+		printf("Computing signatures...\n");
+
+	double start = wall_time();
+	mh_compute_signatures(args, signature_matrix, NULL);
+
+	printf("Signatures of %d rows computed in %.3f s, sweeping %d configurations\n", args.signature_size,
+		   wall_time() - start, n_configs);
+	printf("%9s %8s %9s %12s %10s %10s %11s\n", "signature", "bandrows", "threshold", "candidates", "results",
+		   "bands (s)", "compare (s)");
+
+	// The summary replaces the pairs
+	fflush(f_csv);
+	if (ftruncate(fileno(f_csv), 0) != 0) {
+		printf("Error truncating the report file\n");
+		exit(2);
+	}
+	rewind(f_csv);
+	fprintf(f_csv, "signature,bandrows,threshold,candidates,results,bands_time,compare_time\n");
+
+	// Shorter signatures are copied to a matrix of their own size, kept while the size doesn't change
+	uint32_t *p_prefix_matrix = NULL;
+	int prefix_size = 0;
+
+	for (int c = 0; c < n_configs; ++c) {
+
+		struct Arguments config_args = args;
+		config_args.signature_size = p_configs[c].signature_size;
+		config_args.n_band_rows = p_configs[c].n_band_rows;
+		config_args.n_bands = config_args.signature_size / config_args.n_band_rows;
+		config_args.threshold = p_configs[c].threshold;
+		config_args.kernels = kernels_select(config_args.signature_size, config_args.n_band_rows, args.band_key,
+											 args.hash);
+
+		start = wall_time();
+
+		uint32_t *p_signatures = signature_matrix;
+
+		if (config_args.signature_size < args.signature_size) {
+
+			if (!p_prefix_matrix)
+				p_prefix_matrix = malloc((size_t) args.n_docs * args.signature_size * sizeof(uint32_t) + 1);
+
+			if (prefix_size != config_args.signature_size) {
+
+				prefix_size = config_args.signature_size;
+
+				#pragma omp parallel for default(none) shared(args, signature_matrix, p_prefix_matrix, prefix_size) schedule(static)
+				for (int i = 0; i < args.n_docs; ++i)
+					memcpy(p_prefix_matrix + (size_t) i * prefix_size,
+						   signature_matrix + (size_t) i * args.signature_size, prefix_size * sizeof(uint32_t));
+			}
+
+			p_signatures = p_prefix_matrix;
+		}
+
+		mh_compute_bands(config_args, p_signatures, bands_matrix);
+
+		const double bands_time = wall_time() - start;
+		start = wall_time();
+
+		struct CompareStats stats = {0};
+		mh_compare(config_args, p_signatures, bands_matrix, NULL, &stats, NULL);
+
+		const double compare_time = wall_time() - start;
+
+		printf("%9d %8d %9.2f %12lu %10lu %10.3f %11.3f\n", config_args.signature_size, config_args.n_band_rows,
+			   config_args.threshold, stats.n_candidates, stats.n_similar, bands_time, compare_time);
+		fprintf(f_csv, "%d,%d,%.2f,%lu,%lu,%.4f,%.4f\n", config_args.signature_size, config_args.n_band_rows,
+				config_args.threshold, stats.n_candidates, stats.n_similar, bands_time, compare_time);
+	}
+
+	free(p_prefix_matrix);
+	free(p_configs);
+	mh_free(alloc_args, signature_matrix, bands_matrix);
+
+}
+
+void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t **pp_bands_matrix) {
 
 	// Allocate matrices (calloc initializes to 0 all memory)
-	*pp_signature_matrix = calloc(args.n_docs * args.signature_size, sizeof(uint32_t));
-	*pp_bands_matrix = calloc(args.n_docs * args.n_bands, sizeof(uint32_t));
+	if (!args.numa && args.hugepages == HUGEPAGES_NONE) {
+		*pp_signature_matrix = calloc(args.n_docs * args.signature_size, sizeof(uint32_t));
+		*pp_bands_matrix = calloc(args.n_docs * args.n_bands, sizeof(uint64_t));
+		return;
+	}
+
+	const size_t signature_bytes = (size_t) args.n_docs * args.signature_size * sizeof(uint32_t);
+	const size_t bands_bytes = (size_t) args.n_docs * args.n_bands * sizeof(uint64_t);
+
+	uint32_t *p_signature_matrix = placement_alloc(signature_bytes, args.hugepages);
+	uint64_t *p_bands_matrix = placement_alloc(bands_bytes, args.hugepages);
+
+	const int n_batches = (args.n_docs + args.io_batch - 1) / args.io_batch;
+
+	// First touch: each row is zeroed by the thread that will compute it,
+	// using the same schedules as the compute loops, so its pages land on that thread's NUMA node
+	#pragma omp parallel default(none) shared(args, p_signature_matrix, p_bands_matrix, n_batches)
+	{
+		#pragma omp for schedule(static)
+		for (int b = 0; b < n_batches; ++b) {
+			const int first_doc = b * args.io_batch;
+			const int count = (args.n_docs - first_doc < args.io_batch) ? args.n_docs - first_doc : args.io_batch;
+
+			memset(p_signature_matrix + (size_t) first_doc * args.signature_size, 0,
+				   (size_t) count * args.signature_size * sizeof(uint32_t));
+		}
+
+		#pragma omp for schedule(static)
+		for (int i = 0; i < args.n_docs; ++i)
+			memset(p_bands_matrix + (size_t) i * args.n_bands, 0, args.n_bands * sizeof(uint64_t));
+	}
+
+	if (args.verbose) {
+		placement_report_memory("Signature matrix", p_signature_matrix, signature_bytes);
+		placement_report_memory("Bands matrix", p_bands_matrix, bands_bytes);
+	}
+
+	*pp_signature_matrix = p_signature_matrix;
+	*pp_bands_matrix = p_bands_matrix;
+
+}
+
+void mh_free(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix) {
+
+	if (!args.numa && args.hugepages == HUGEPAGES_NONE) {
+		free(p_signature_matrix);
+		free(p_bands_matrix);
+		return;
+	}
+
+	placement_free(p_signature_matrix, (size_t) args.n_docs * args.signature_size * sizeof(uint32_t));
+	placement_free(p_bands_matrix, (size_t) args.n_docs * args.n_bands * sizeof(uint64_t));
 
 }
 
-void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix) {
+uint32_t *mh_pack_signatures(struct Arguments args, uint32_t *p_signature_matrix, int n_docs) {
 
-	size_t filepath_len = strlen(args.directory) + 20UL;
-	char doc_filepath[filepath_len];
+	bbit_pack(p_signature_matrix, n_docs, args.signature_size, args.bbit);
 
-	// Loop over all documents
-	#pragma omp parallel for default(none) shared(args, p_signature_matrix) private(doc_filepath)
-	for (int i = 0; i < args.n_docs; ++i) {
+	// Matrices placed by first touch keep their pages
+	if (args.numa || args.hugepages != HUGEPAGES_NONE)
+		return p_signature_matrix;
+
+	const size_t packed_bytes = (size_t) args.n_docs * bbit_words(args.signature_size, args.bbit) * sizeof(uint32_t);
+	uint32_t *p_packed = realloc(p_signature_matrix, packed_bytes > 0 ? packed_bytes : 1);
+
+	if (args.verbose)
+		printf("Signature matrix packed to %d bits per row: %zu bytes instead of %zu\n", args.bbit, packed_bytes,
+			   (size_t) args.n_docs * args.signature_size * sizeof(uint32_t));
+
+	return p_packed ? p_packed : p_signature_matrix;
+}
+
+struct DupGroups *mh_group_duplicates(struct Arguments args) {
+
+	const int n_batches = (args.n_docs + args.io_batch - 1) / args.io_batch;
+	uint64_t *p_fingerprints = malloc(((size_t) args.n_docs * 2 + 1) * sizeof(uint64_t));
+
+	#pragma omp parallel default(none) shared(args, p_fingerprints, n_batches)
+	{
+		struct DocLoader *loader = loader_create(args, args.io_batch);
+		struct DocBuffer buffers[args.io_batch];
+		struct DocBuffer *p_buffers[args.io_batch];
+		int doc_numbers[args.io_batch];
+		struct Tokens tokens = {0};
+
+		memset(buffers, 0, sizeof(buffers));
+		for (int k = 0; k < args.io_batch; ++k)
+			p_buffers[k] = &buffers[k];
+
+		// Fingerprint of the normalized text of each document, the one its shingles are made of
+		#pragma omp for schedule(static)
+		for (int b = 0; b < n_batches; ++b) {
+
+			const int first_doc = b * args.io_batch;
+			const int count = (args.n_docs - first_doc < args.io_batch) ? args.n_docs - first_doc : args.io_batch;
+
+			for (int k = 0; k < count; ++k)
+				doc_numbers[k] = first_doc + k + args.doc_offset;
+
+			loader_read(loader, args.directory, doc_numbers, p_buffers, count);
+
+			for (int k = 0; k < count; ++k) {
+				tokenize(buffers[k].data, buffers[k].size, &tokens);
+				dup_fingerprint(tokens.text, tokens.text_len, p_fingerprints + 2 * (size_t) (first_doc + k));
+			}
+		}
+
+		for (int k = 0; k < args.io_batch; ++k)
+			free(buffers[k].data);
+		tokens_free(&tokens);
+		loader_destroy(loader);
+	}
+
+	struct DupGroups *groups = dup_groups_build(p_fingerprints, args.n_docs);
+	free(p_fingerprints);
+
+	if (args.verbose)
+		printf("Exact duplicates: %d documents in %d groups, neither hashed nor compared\n", groups->n_members,
+			   groups->n_groups);
+
+	return groups;
+}
+
+void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt) {
+
+	// Start from the rows saved by the resumed run
+	if (p_ckpt)
+		ckpt_load_rows(p_ckpt, p_signature_matrix);
+
+	// Overlap reading and hashing if requested
+	if (args.prefetch_depth > 0)
+		mh_compute_signatures_prefetch(args, p_signature_matrix, p_ckpt);
+	else
+		mh_compute_signatures_batches(args, p_signature_matrix, p_ckpt);
+
+	// Compared rows can only be saved once all rows are
+	if (p_ckpt)
+		ckpt_save(p_ckpt);
+
+}
+
+void mh_compute_signatures_batches(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt) {
+
+	const int n_batches = (args.n_docs + args.io_batch - 1) / args.io_batch;
+
+	// Rows saved by the checkpoint, or duplicates of other documents
+	const uint8_t *p_skip = p_ckpt ? p_ckpt->p_done : args.dups ? args.dups->p_member : NULL;
+
+	// Largest documents first, stolen by the threads running out of work
+	long *p_sizes = args.schedule == SCHEDULE_LPT ? sched_doc_sizes(args) : NULL;
+	struct WorkQueue *queue = NULL;
+
+	// Time and thread of each document, to report the gain of the schedule
+	double *p_doc_times = NULL;
+	int *p_owner = NULL;
+
+	if (p_sizes && args.verbose) {
+		p_doc_times = calloc(args.n_docs, sizeof(double));
+		p_owner = malloc(args.n_docs * sizeof(int));
+		for (int i = 0; i < args.n_docs; ++i)
+			p_owner[i] = -1;
+	}
+
+	// Shingles hashed and skipped by the dedup sets of all threads
+	size_t n_distinct = 0, n_repeated = 0;
+	int n_threads = 1;
+
+	#pragma omp parallel default(none) shared(args, p_signature_matrix, p_ckpt, p_skip, p_sizes, queue, p_doc_times, \
+											  p_owner, n_batches, n_threads, n_distinct, n_repeated)
+	{
+		// Every thread loads its own batches
+		struct DocLoader *loader = loader_create(args, args.io_batch);
+		struct DocBuffer buffers[args.io_batch];
+		int batch_rows[args.io_batch];
+		struct Tokens tokens = {0};
+		struct ShingleSet dedup = {0};
+		int thread = 0;
+
+#ifndef __MP_NONE__
+		thread = omp_get_thread_num();
+#endif
+
+		memset(buffers, 0, sizeof(buffers));
+
+		#pragma omp single nowait
+		if (args.verbose && args.io_backend == IO_URING && !loader_uses_uring(loader))
+			printf("io_uring not available, reading documents with pread\n");
+
+		if (p_sizes) {
+
+			#pragma omp single
+			{
+#ifndef __MP_NONE__
+				n_threads = omp_get_num_threads();
+#endif
+				queue = wq_create(p_sizes, args.n_docs, n_threads, p_skip);
+			}
+
+			// Take batches of documents until all threads ran out of them
+			int count;
+			while ((count = wq_pop(queue, thread, batch_rows, args.io_batch)) > 0) {
+
+				if (p_owner)
+					for (int k = 0; k < count; ++k)
+						p_owner[batch_rows[k]] = thread;
+
+				mh_compute_signatures_rows(args, loader, buffers, batch_rows, count, &tokens, args.dedup ? &dedup : NULL,
+										   p_signature_matrix, p_ckpt, p_doc_times);
+			}
+		}
+
+		else {
+
+			// Loop over all batches of documents
+			#pragma omp for schedule(static)
+			for (int b = 0; b < n_batches; ++b) {
+
+				const int first_doc = b * args.io_batch;
+				const int batch_docs = (args.n_docs - first_doc < args.io_batch) ? args.n_docs - first_doc
+																				 : args.io_batch;
+				int count = 0;
+
+				// Documents of the batch, except the ones saved by the checkpoint
+				for (int k = 0; k < batch_docs; ++k)
+					if (!p_skip || !p_skip[first_doc + k])
+						batch_rows[count++] = first_doc + k;
+
+				mh_compute_signatures_rows(args, loader, buffers, batch_rows, count, &tokens, args.dedup ? &dedup : NULL,
+										   p_signature_matrix, p_ckpt, p_doc_times);
+			}
+		}
+
+		#pragma omp atomic
+		n_distinct += dedup.n_distinct;
+		#pragma omp atomic
+		n_repeated += dedup.n_repeated;
+
+		for (int k = 0; k < args.io_batch; ++k)
+			free(buffers[k].data);
+		tokens_free(&tokens);
+		shingle_set_free(&dedup);
+		loader_destroy(loader);
+	}
+
+	if (args.verbose && args.dedup)
+		printf("Shingle dedup: %zu distinct shingles hashed, %zu repeated shingles skipped\n", n_distinct, n_repeated);
+
+	if (queue) {
+
+		// Compare with the batches the static schedule would have given to each thread
+		if (p_owner) {
+			int *p_static_owner = malloc(args.n_docs * sizeof(int));
+			sched_static_assign(args.n_docs, args.io_batch, n_threads, p_static_owner);
+
+			printf("Work stealing: %d steals among %d threads\n", atomic_load(&queue->n_steals), n_threads);
+			sched_report(p_doc_times, p_owner, p_static_owner, args.n_docs, n_threads);
+
+			free(p_static_owner);
+		}
+
+		wq_destroy(queue);
+	}
+
+	free(p_sizes);
+	free(p_doc_times);
+	free(p_owner);
+
+}
+
+void mh_compute_signatures_rows(struct Arguments args, struct DocLoader *loader, struct DocBuffer *p_buffers,
+								const int *p_rows, int count, struct Tokens *p_tokens, struct ShingleSet *p_dedup,
+								uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt, double *p_doc_times) {
+
+	struct DocBuffer *pp_buffers[args.io_batch];
+	int doc_numbers[args.io_batch];
+
+	for (int k = 0; k < args.io_batch; ++k) {
+		pp_buffers[k] = &p_buffers[k];
+		doc_numbers[k] = k < count ? p_rows[k] + args.doc_offset : -1;
+	}
+
+	loader_read(loader, args.directory, doc_numbers, pp_buffers, count);
+
+	// Compute the signatures of the loaded documents
+	for (int k = 0; k < count; ++k) {
+
+		const int i = p_rows[k];
+		const double start = p_doc_times ? wall_time() : 0;
 
 		if (args.verbose && (i % args.verbose == 0))
 			printf("Computing signature for doc %d\n", i + args.doc_offset);
 
-		// Compute the path of the document file (they are numbered)
-		sprintf(doc_filepath, "%s/%d.txt", args.directory, i + args.doc_offset);
-
 		// Write the signature of the i-th document in the i-th matrix row
 		mh_document_signature(
-				doc_filepath,
-				(int) args.shingle_size,
+				p_buffers[k].data,
+				p_buffers[k].size,
+				p_tokens,
+				p_dedup,
+				args.shingle_size,
+				args.shingle_mode,
 				p_signature_matrix + i * args.signature_size,
-				(int) args.signature_size,
-				args.seed
+				args.signature_size,
+				args.seed,
+				args.kernels
 		);
+
+		if (p_doc_times)
+			p_doc_times[i] = wall_time() - start;
+
+		if (p_ckpt)
+			ckpt_row_computed(p_ckpt, i, p_signature_matrix + i * args.signature_size);
 	}
+
 }
 
-void mh_document_signature(
-		const char *filepath,
-		const int shingle_size,
-		uint32_t *signature,
-		const int signature_size,
-		const int seed
-) {
+void mh_compute_signatures_prefetch(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt) {
 
-	// Open file
-	FILE *file = fopen(filepath, "r");
+	// The queue is already shared by all threads: the lpt schedule only reads the largest documents first
+	long *p_sizes = args.schedule == SCHEDULE_LPT ? sched_doc_sizes(args) : NULL;
+	int *p_order = p_sizes ? sched_lpt_order(p_sizes, args.n_docs) : NULL;
 
-	// Check if file was opened
-	if (file == NULL) {
-		printf("Error opening file %s\n", filepath);
-		exit(2);
-	}
+	// Start the reader threads (documents saved by the checkpoint and duplicates are not read)
+	struct DocQueue *queue = dq_create(args, p_ckpt ? p_ckpt->p_done : args.dups ? args.dups->p_member : NULL,
+									   p_order);
 
-	char *prev_words[shingle_size];
-	char *shingle;
-	uint32_t current_hash;
+	// Shingles hashed and skipped by the dedup sets of all threads
+	size_t n_distinct = 0, n_repeated = 0;
 
-	// Set all signature values to max
-	for (int i = 0; i < signature_size; i++) {
-		signature[i] = UINT32_MAX;
-	}
+	// Each thread consumes documents until the queue is drained
+	#pragma omp parallel default(none) shared(args, p_signature_matrix, p_ckpt, queue, n_distinct, n_repeated)
+	{
+		struct DocSlot *slot;
+		struct Tokens tokens = {0};
+		struct ShingleSet dedup = {0};
+
+		while ((slot = dq_pop(queue))) {
 
-	// Set to null all previous words
-	for (int i = 0; i < shingle_size; i++)
-		prev_words[i] = NULL;
+			const int i = slot->doc_index;
 
-	// Read all shingles from file
-	while ((shingle = read_shingle_from_file(file, shingle_size, prev_words))) {
+			if (args.verbose && (i % args.verbose == 0))
+				printf("Computing signature for doc %d\n", i + args.doc_offset);
 
-		int shingle_len = strlen(shingle);
+			mh_document_signature(
+					slot->buffer.data,
+					slot->buffer.size,
+					&tokens,
+					args.dedup ? &dedup : NULL,
+					args.shingle_size,
+					args.shingle_mode,
+					p_signature_matrix + i * args.signature_size,
+					args.signature_size,
+					args.seed,
+					args.kernels
+			);
 
-		// Compute document signature
-		for (int i = 0; i < signature_size; ++i) {
+			// Give buffer back to the readers
+			dq_release(queue, slot);
 
-			// Hash shingle and save if min
-			current_hash = murmur_hash(shingle, shingle_len, seed * i);
-			if (current_hash < signature[i])
-					#pragma omp critical
-				signature[i] = current_hash;
+			if (p_ckpt)
+				ckpt_row_computed(p_ckpt, i, p_signature_matrix + i * args.signature_size);
 		}
 
-		// Free shingle memory
-		free(shingle);
+		#pragma omp atomic
+		n_distinct += dedup.n_distinct;
+		#pragma omp atomic
+		n_repeated += dedup.n_repeated;
+
+		tokens_free(&tokens);
+		shingle_set_free(&dedup);
 	}
 
-	// Free previous words memory
-	for (int i = 0; i < shingle_size; i++)
-		free(prev_words[i]);
+	dq_destroy(queue);
+	free(p_order);
+	free(p_sizes);
+
+	if (args.verbose && args.dedup)
+		printf("Shingle dedup: %zu distinct shingles hashed, %zu repeated shingles skipped\n", n_distinct, n_repeated);
 
-	// Close file
-	fclose(file);
 }
 
-void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint32_t *p_bands_matrix) {
+void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint64_t *p_bands_matrix) {
 
-	// Loop over all documents
-	#pragma omp parallel for default(none) shared(args, p_signature_matrix, p_bands_matrix)
+	// Loop over all documents (static schedule, as in the first touch of mh_allocate)
+	#pragma omp parallel for default(none) shared(args, p_signature_matrix, p_bands_matrix) schedule(static)
 	for (int i = 0; i < args.n_docs; ++i) {
 
 		// Compute the bands of the i-th document
-		for (int j = 0; j < args.n_bands; ++j) {
+		args.kernels->compute_bands(p_signature_matrix + i * args.signature_size, p_bands_matrix + i * args.n_bands,
+									args.n_band_rows, args.n_bands);
+	}
 
-			// Compute the hash of the band
-			uint32_t band_hash = 0;
-			for (int k = 0; k < args.n_band_rows; ++k) {
-				band_hash ^= p_signature_matrix[i * args.signature_size + j * args.n_band_rows + k];
-			}
+}
 
-			// Save the band hash in the bands matrix
-			#pragma omp critical
-			p_bands_matrix[i * args.n_bands + j] = band_hash;
-		}
+void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix, FILE *f_csv,
+				struct CompareStats *p_stats, struct Checkpoint *p_ckpt) {
+
+	// The whole matrix is a single tile
+	if (!p_ckpt) {
+		mh_compare_tile(args, p_signature_matrix, p_bands_matrix, 0, args.n_docs,
+						p_signature_matrix, p_bands_matrix, 0, args.n_docs, f_csv, p_stats);
+		return;
+	}
+
+	// Words of a (possibly packed) signature
+	const int stride = bbit_words(args.signature_size, args.bbit);
 
+	// Bands of all documents, band-major, shared by all the rows
+	uint64_t *p_bands_t = kernels_band_major(p_bands_matrix, args.n_docs, args.n_bands);
+
+	// With checkpoints, compare a few rows at a time (against all the following ones) and save the progress,
+	// starting after the rows compared by the resumed run
+	for (int i = p_ckpt->compare_next; i < args.n_docs; i += CHECKPOINT_COMPARE_ROWS) {
+
+		const int n_rows = (args.n_docs - i < CHECKPOINT_COMPARE_ROWS) ? args.n_docs - i : CHECKPOINT_COMPARE_ROWS;
+
+		// The following documents start at the block of the first row
+		const int first = i - i % KERNELS_BLOCK_DOCS;
+
+		mh_compare_band_major(args, p_signature_matrix + i * stride, p_bands_matrix + i * args.n_bands, i, n_rows,
+							  p_signature_matrix + first * stride, p_bands_t + (size_t) first * args.n_bands, first,
+							  args.n_docs - first, f_csv, p_stats);
+
+		ckpt_compare_progress(p_ckpt, i + n_rows, f_csv, false);
 	}
 
+	free(p_bands_t);
+
 }
 
-void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix, FILE *f_csv) {
+void mh_join(struct Arguments args_a, const uint32_t *p_signatures_a, const uint64_t *p_bands_a,
+			 struct Arguments args_b, const uint32_t *p_signatures_b, const uint64_t *p_bands_b, FILE *f_csv,
+			 struct CompareStats *p_stats) {
 
-	const int n_bands = (int) (args.signature_size / args.n_band_rows);
+	const struct Arguments args = args_a;
+	const int n_bands = args.n_bands;
+
+	// The larger corpus is indexed, the smaller one probes it
+	const int index_b = args_b.n_docs >= args_a.n_docs;
+	const int n_probe = index_b ? args_a.n_docs : args_b.n_docs;
+	const int n_index = index_b ? args_b.n_docs : args_a.n_docs;
+	const uint64_t *p_probe_bands = index_b ? p_bands_a : p_bands_b;
+
+	struct LshBuckets buckets;
+
+	if (!lsh_buckets_build(&buckets, index_b ? p_bands_b : p_bands_a, n_index, n_bands)) {
+		printf("Error allocating the LSH buckets\n");
+		exit(2);
+	}
 
-	// Loop over all document pairs
-	#pragma omp parallel for default(none) shared(args, p_signature_matrix, p_bands_matrix, f_csv, n_bands) schedule(dynamic)
-	for (int i = 0; i < args.n_docs - 1; ++i) {
-		for (int j = i + 1; j < args.n_docs; ++j) {
+	unsigned long n_candidates = 0, n_collisions = 0, n_similar = 0;
 
-			// Pointers to the bands of the two documents
-			uint32_t *p_bands1 = p_bands_matrix + i * n_bands;
-			uint32_t *p_bands2 = p_bands_matrix + j * n_bands;
+	#pragma omp parallel default(none) shared(args, args_a, args_b, p_signatures_a, p_signatures_b, p_probe_bands, buckets, f_csv, n_bands, index_b, n_probe, n_index) reduction(+:n_candidates, n_collisions, n_similar)
+	{
+		// Last probing document of each indexed one, to compare a pair once even if it shares several bands
+		int *p_seen = malloc((n_index > 0 ? n_index : 1) * sizeof(int));
 
-			// Skip if not candidate pair
-			if (!is_candidate_pair(p_bands1, p_bands2, n_bands))
-				continue;
+		for (int j = 0; j < n_index; ++j)
+			p_seen[j] = -1;
 
-			// Pointers to the signatures of the two documents
-			uint32_t *p_signature1 = p_signature_matrix + i * args.signature_size;
-			uint32_t *p_signature2 = p_signature_matrix + j * args.signature_size;
+		#pragma omp for schedule(dynamic)
+		for (int i = 0; i < n_probe; ++i)
+			for (int band = 0; band < n_bands; ++band) {
 
-			// Compute MinHash similarity and print if above threshold
-			float similarity = signature_similarity(p_signature1, p_signature2, args.signature_size);
+				int count;
+				const struct LshEntry *p_bucket = lsh_buckets_find(&buckets, band, p_probe_bands[i * n_bands + band],
+																   &count);
 
-			if (similarity >= args.threshold) {
-				#pragma omp critical
-				fprintf(f_csv, "%d,%d,%.4f\n", i + args.doc_offset, j + args.doc_offset, similarity);
+				for (int e = 0; e < count; ++e) {
+
+					const int j = p_bucket[e].doc;
+
+					if (p_seen[j] == i)
+						continue;
+
+					p_seen[j] = i;
+
+					// Documents of the pair in each corpus
+					const int doc_a = index_b ? i : j;
+					const int doc_b = index_b ? j : i;
+					const uint32_t *p_signature_a = p_signatures_a + doc_a * args.signature_size;
+					const uint32_t *p_signature_b = p_signatures_b + doc_b * args.signature_size;
+
+					++n_candidates;
+
+					// Check whether the equal band keys come from equal bands (only to report collisions)
+					if (args.verbose && !has_equal_band(p_signature_a, p_signature_b, n_bands, args.n_band_rows))
+						++n_collisions;
+
+					float similarity = args.kernels->signature_similarity(p_signature_a, p_signature_b,
+																		  args.signature_size);
+
+					if (similarity >= args.threshold) {
+						++n_similar;
+						#pragma omp critical
+						fprintf(f_csv, "A:%d,B:%d,%.4f\n", doc_a + args_a.doc_offset, doc_b + args_b.doc_offset,
+								similarity);
+					}
+				}
 			}
 
+		free(p_seen);
+	}
+
+	lsh_buckets_free(&buckets);
+
+	p_stats->n_candidates += n_candidates;
+	p_stats->n_collisions += n_collisions;
+	p_stats->n_similar += n_similar;
+
+}
+
+void mh_compare_tile(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+) {
+
+	// Bands of the second documents, band-major: a document is checked against a block of them at once
+	uint64_t *p_bands2_t = kernels_band_major(p_bands2, n_docs2, args.n_bands);
+
+	mh_compare_band_major(args, p_signatures1, p_bands1, first_doc1, n_docs1,
+						  p_signatures2, p_bands2_t, first_doc2, n_docs2, f_csv, p_stats);
+
+	free(p_bands2_t);
+
+}
+
+void mh_compare_band_major(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2_t, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+) {
+
+	const int n_bands = (int) (args.signature_size / args.n_band_rows);
+	const int stride = bbit_words(args.signature_size, args.bbit);
+
+	unsigned long n_candidates = 0, n_collisions = 0, n_similar = 0, n_duplicates = 0;
+
+	// Duplicates are compared through their representative: their lanes are never candidates
+	uint32_t *p_dup_lanes = NULL;
+
+	if (args.dups) {
+		p_dup_lanes = calloc(n_docs2 / KERNELS_BLOCK_DOCS + 1, sizeof(uint32_t));
+		for (int j = 0; j < n_docs2; ++j)
+			p_dup_lanes[j / KERNELS_BLOCK_DOCS] |= (uint32_t) args.dups->p_member[first_doc2 + j]
+												   << (j % KERNELS_BLOCK_DOCS);
+	}
+
+	// Loop over all document pairs of the tile
+	#pragma omp parallel for default(none) shared(args, p_signatures1, p_bands1, first_doc1, n_docs1, p_signatures2, p_bands2_t, first_doc2, n_docs2, f_csv, n_bands, stride, p_dup_lanes) reduction(+:n_candidates, n_collisions, n_similar, n_duplicates) schedule(dynamic)
+	for (int i = 0; i < n_docs1; ++i) {
+
+		if (args.dups && args.dups->p_member[first_doc1 + i])
+			continue;
+
+		const uint64_t *p_band1 = p_bands1 + i * n_bands;
+
+		// Only the second documents after the first one are compared
+		const int first_j = (first_doc1 + i + 1 > first_doc2) ? first_doc1 + i + 1 - first_doc2 : 0;
+
+		for (int block = first_j - first_j % KERNELS_BLOCK_DOCS; block < n_docs2; block += KERNELS_BLOCK_DOCS) {
+
+			// Candidate pairs of the block (only the ones to compare)
+			uint32_t mask = args.kernels->candidate_mask(p_band1, p_bands2_t + (size_t) block * n_bands, n_bands)
+							& kernels_block_lanes(block, first_j, n_docs2);
+
+			if (p_dup_lanes)
+				mask &= ~p_dup_lanes[block / KERNELS_BLOCK_DOCS];
+
+			for (; mask; mask &= mask - 1) {
+
+				const int j = block + __builtin_ctz(mask);
+
+				// Pointers to the signatures of the two documents
+				const uint32_t *p_signature1 = p_signatures1 + i * stride;
+				const uint32_t *p_signature2 = p_signatures2 + j * stride;
+
+				++n_candidates;
+
+				// Check whether the equal band keys come from equal bands (only to report collisions)
+				if (args.verbose && !args.bbit && !has_equal_band(p_signature1, p_signature2, n_bands, args.n_band_rows))
+					++n_collisions;
+
+				// Compute MinHash similarity (estimated from the low bits of packed rows) and print if above threshold
+				float similarity = args.bbit
+								   ? bbit_similarity(p_signature1, p_signature2, args.signature_size, args.bbit)
+								   : args.kernels->signature_similarity(p_signature1, p_signature2, args.signature_size);
+
+				if (similarity >= args.threshold) {
+
+					++n_similar;
+
+					// The pair stands for the pairs of the two groups
+					if (args.dups) {
+						#pragma omp critical
+						n_duplicates += dup_groups_write_pairs(args.dups, first_doc1 + i, first_doc2 + j, similarity,
+															   args.doc_offset, f_csv) - 1;
+					} else if (f_csv) {
+						#pragma omp critical
+						fprintf(f_csv, "%d,%d,%.4f\n", first_doc1 + i + args.doc_offset, first_doc2 + j + args.doc_offset,
+								similarity);
+					}
+				}
+			}
 		}
 	}
 
+	free(p_dup_lanes);
+
+	p_stats->n_candidates += n_candidates;
+	p_stats->n_collisions += n_collisions;
+	p_stats->n_similar += n_similar;
+	p_stats->n_duplicates += n_duplicates;
+
 }
@@ -2,8 +2,12 @@
 #define MULTICOREMINHASH_MINHASH_H
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "structures.h"
+#include "doc_loader.h"
+#include "signature.h"
+#include "checkpoint.h"
 
 /**
  * Perform the MinHash algorithm on the given arguments.
@@ -14,42 +18,151 @@
  */
 void mh_main(struct Arguments args);
 
+/**
+ * Perform the MinHash algorithm keeping the matrices on disk, using at most args.memory_limit MB for them. <br>
+ * Signatures and bands are computed one block of documents at a time and spilled to a file,
+ * then the pairs are compared one tile (pair of blocks) at a time.
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results
+ */
+void mh_main_out_of_core(struct Arguments args, FILE *f_csv);
+
+/**
+ * Perform the MinHash algorithm on documents read from a stream (args.stream), reporting the matches of each one
+ * as soon as it is hashed. <br>
+ * Each document is compared with the documents of a sliding window (the most recent args.window_docs ones,
+ * arrived at most args.window_seconds ago) found in its LSH buckets, then added to the window.
+ * Documents already arrived are hashed together by the threads, then matched in their arrival order.
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results (flushed after every document)
+ */
+void mh_main_stream(struct Arguments args, FILE *f_csv);
+
+/**
+ * Perform the MinHash algorithm between two corpora: the documents of args (corpus A) are only compared with the
+ * args.join_docs documents of args.join_directory starting from args.join_offset (corpus B). <br>
+ * Results are written with corpus-tagged ids (A:<doc>,B:<doc>,similarity).
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results
+ */
+void mh_main_join(struct Arguments args, FILE *f_csv);
+
+/**
+ * Compute the signature matrix, index it in an LSH Forest of args.forest_trees trees and answer the queries
+ * read from the standard input, one per line:
+ * "top <doc> <k>" (the k documents most similar to doc), "near <doc> <threshold>" (the documents at least
+ * threshold similar to doc) and "pairs <threshold>" (all the pairs at least threshold similar, written to the CSV file
+ * in place of the previous ones). Results of the first two are printed along with the query time.
+ *
+ * @param args Algorithm's arguments
+ * @param f_csv Open CSV file where to write the results of pairs queries
+ */
+void mh_main_forest(struct Arguments args, FILE *f_csv);
+
+/**
+ * Compute the signature matrix once, at the largest signature size of the configurations of args.sweep,
+ * then compute the bands and compare the pairs of each configuration on the prefix of its signature size
+ * (row i of a signature doesn't depend on the signature size). <br>
+ * Pairs are only counted: the CSV file gets a line per configuration, with its candidates, results and the time
+ * of its phases, also printed on stdout.
+ *
+ * @param args Algorithm's arguments (signature size and band rows of the largest configuration)
+ * @param f_csv Open CSV file where to write the summary of each configuration
+ */
+void mh_main_sweep(struct Arguments args, FILE *f_csv);
+
 /**
  * Allocate memory for the signature and bands matrices.
- * Memory must be freed by the caller after usage.
+ * In NUMA-aware mode (or with huge pages), rows are first touched in parallel by the threads that will compute them.
+ * Memory must be freed by the caller with mh_free after usage.
  *
  * @param args Algorithm's arguments
  * @param pp_signature_matrix Address to the signature matrix's pointer
  * @param pp_bands_matrix Address to the bands matrix's pointer
  */
-void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint32_t **pp_bands_matrix);
+void mh_allocate(struct Arguments args, uint32_t **pp_signature_matrix, uint64_t **pp_bands_matrix);
+
+/**
+ * Free the signature and bands matrices allocated by mh_allocate.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_bands_matrix Pointer to the bands matrix
+ */
+void mh_free(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix);
+
+/**
+ * Pack the signatures of the first documents to the low args.bbit bits of each row (see bbit.h),
+ * shrinking the signature matrix to the packed size if it wasn't placed by first touch.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param n_docs Number of signatures to pack
+ * @return Pointer to the packed signature matrix (rows of bbit_words(args.signature_size, args.bbit) words)
+ */
+uint32_t *mh_pack_signatures(struct Arguments args, uint32_t *p_signature_matrix, int n_docs);
+
+/**
+ * Read and normalize all documents, and group the ones with the same fingerprint (see duplicates.h).
+ *
+ * @param args Algorithm's arguments
+ * @return The groups, to be freed with dup_groups_destroy
+ */
+struct DupGroups *mh_group_duplicates(struct Arguments args);
 
 /**
  * Compute the signature matrix of all documents.
+ * With a checkpoint, the rows saved by the resumed run are loaded instead of computed,
+ * and computed rows are saved. Rows of the duplicates in args.dups are not computed.
  *
  * @param args Algorithm's arguments
  * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_ckpt Checkpoint of the run (NULL if disabled)
  */
-void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix);
+void mh_compute_signatures(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt);
 
 /**
- * Compute the signature of a document. <br>
- * The file is read word by word, and a shingle is built from the last n words read.
- * The shingle is then hashed and stored in the signature array.
+ * Compute the signature matrix of all documents, each thread loading and hashing batches of documents:
+ * consecutive batches with the static schedule, or the largest documents first with the lpt schedule
+ * (threads running out of documents steal the smallest ones of the others).
  *
- * @param filepath Path to the document
- * @param shingle_size Size of a shingle
- * @param signature Array to store the signature
- * @param signature_size Size of the signature array
- * @param seed Seed for the hash function
+ * @param args Algorithm's arguments
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_ckpt Checkpoint of the run (NULL if disabled)
  */
-void mh_document_signature(
-		const char *filepath,
-		const int shingle_size,
-		uint32_t *signature,
-		const int signature_size,
-		const int seed
-);
+void mh_compute_signatures_batches(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt);
+
+/**
+ * Load a batch of documents and compute their signatures (called by each thread of mh_compute_signatures_batches).
+ *
+ * @param args Algorithm's arguments
+ * @param loader Loader of the calling thread
+ * @param p_buffers Buffers of the calling thread (one per document of a batch)
+ * @param p_rows Indices of the documents (rows of the signature matrix)
+ * @param count Number of documents (at most an I/O batch)
+ * @param p_tokens Token buffer of the calling thread
+ * @param p_dedup Dedup set of the calling thread (NULL if disabled)
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_ckpt Checkpoint of the run (NULL if disabled)
+ * @param p_doc_times Where to store the seconds spent hashing each document (NULL if not measured)
+ */
+void mh_compute_signatures_rows(struct Arguments args, struct DocLoader *loader, struct DocBuffer *p_buffers,
+								const int *p_rows, int count, struct Tokens *p_tokens, struct ShingleSet *p_dedup,
+								uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt, double *p_doc_times);
+
+/**
+ * Compute the signature matrix of all documents,
+ * overlapping the reading of the documents (done by a pool of reader threads)
+ * with the hashing (done by the OpenMP threads).
+ *
+ * @param args Algorithm's arguments
+ * @param p_signature_matrix Pointer to the signature matrix
+ * @param p_ckpt Checkpoint of the run (NULL if disabled)
+ */
+void mh_compute_signatures_prefetch(struct Arguments args, uint32_t *p_signature_matrix, struct Checkpoint *p_ckpt);
 
 /**
  * Compute the bands matrix from the signature matrix.
@@ -58,7 +171,7 @@ void mh_document_signature(
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
  */
-void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint32_t *p_bands_matrix);
+void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix, uint64_t *p_bands_matrix);
 
 /**
  * Transfer the matrices from the other processes to the main process.
@@ -67,7 +180,7 @@ void mh_compute_bands(struct Arguments args, const uint32_t *p_signature_matrix,
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
  */
-void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix);
+void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix);
 
 /**
  * Compare all document pairs and write candidate pairs to a CSV file.
@@ -77,8 +190,76 @@ void sync_mem_mpi(struct Arguments args, uint32_t *p_signature_matrix, uint32_t
  * @param args Algorithm's arguments
  * @param p_signature_matrix Pointer to the signature matrix
  * @param p_bands_matrix Pointer to the bands matrix
+ * @param f_csv Open CSV file where to write the results (NULL to only count them)
+ * @param p_stats Counters of the comparison, updated with the compared pairs
+ * @param p_ckpt Checkpoint of the run, where the progress is saved (NULL if disabled)
+ */
+void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint64_t *p_bands_matrix, FILE *f_csv,
+				struct CompareStats *p_stats, struct Checkpoint *p_ckpt);
+
+/**
+ * Compare the documents of two corpora and write candidate pairs to a CSV file.
+ * The bands of the larger corpus are sorted into LSH buckets, and each document of the smaller one looks up its
+ * band keys in them, so only pairs made of a document of each corpus and sharing a band are compared.
+ *
+ * @param args_a Arguments of the first corpus
+ * @param p_signatures_a Signature matrix of the first corpus
+ * @param p_bands_a Bands matrix of the first corpus
+ * @param args_b Arguments of the second corpus
+ * @param p_signatures_b Signature matrix of the second corpus
+ * @param p_bands_b Bands matrix of the second corpus
  * @param f_csv Open CSV file where to write the results
+ * @param p_stats Counters of the comparison, updated with the compared pairs
+ */
+void mh_join(struct Arguments args_a, const uint32_t *p_signatures_a, const uint64_t *p_bands_a,
+			 struct Arguments args_b, const uint32_t *p_signatures_b, const uint64_t *p_bands_b, FILE *f_csv,
+			 struct CompareStats *p_stats);
+
+/**
+ * Compare the document pairs of a tile, made of two blocks of consecutive documents,
+ * and write candidate pairs to a CSV file. If both blocks start at the same document, each pair is compared once.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signatures1 Signature rows of the first block
+ * @param p_bands1 Bands rows of the first block
+ * @param first_doc1 Index of the first document of the first block
+ * @param n_docs1 Number of documents in the first block
+ * @param p_signatures2 Signature rows of the second block
+ * @param p_bands2 Bands rows of the second block
+ * @param first_doc2 Index of the first document of the second block
+ * @param n_docs2 Number of documents in the second block
+ * @param f_csv Open CSV file where to write the results (NULL to only count them)
+ * @param p_stats Counters of the comparison, updated with the compared pairs
  */
-void mh_compare(struct Arguments args, uint32_t *p_signature_matrix, uint32_t *p_bands_matrix, FILE *f_csv);
+void mh_compare_tile(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+);
+
+/**
+ * Compare the document pairs of a tile as mh_compare_tile, with the bands of the second block already
+ * band-major (see kernels_band_major), so that the copy can be shared by several tiles.
+ * Only the pairs whose second document comes after the first one are compared.
+ *
+ * @param args Algorithm's arguments
+ * @param p_signatures1 Signature rows of the first block
+ * @param p_bands1 Bands rows of the first block
+ * @param first_doc1 Index of the first document of the first block
+ * @param n_docs1 Number of documents in the first block
+ * @param p_signatures2 Signature rows of the second block
+ * @param p_bands2_t Bands of the second block, band-major (from the start of a block of KERNELS_BLOCK_DOCS)
+ * @param first_doc2 Index of the first document of the second block
+ * @param n_docs2 Number of documents in the second block
+ * @param f_csv Open CSV file where to write the results (NULL to only count them)
+ * @param p_stats Counters of the comparison, updated with the compared pairs
+ */
+void mh_compare_band_major(
+		struct Arguments args,
+		const uint32_t *p_signatures1, const uint64_t *p_bands1, int first_doc1, int n_docs1,
+		const uint32_t *p_signatures2, const uint64_t *p_bands2_t, int first_doc2, int n_docs2,
+		FILE *f_csv, struct CompareStats *p_stats
+);
 
 #endif //MULTICOREMINHASH_MINHASH_H
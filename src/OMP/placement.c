@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef __MP_NONE__
+#include <omp.h>
+#endif
+
+#include "placement.h"
+
+// Size of a (2MB) huge page
+#define HUGE_PAGE_SIZE (2UL * 1024UL * 1024UL)
+
+// Maximum number of NUMA nodes in the report
+#define MAX_NODES 64
+
+/**
+ * Returns the NUMA node of a CPU, read from sysfs.
+ *
+ * @param cpu The CPU
+ * @return The node, or -1 if unknown
+ */
+static int node_of_cpu(int cpu);
+
+/**
+ * Round a size up to a whole number of huge pages.
+ */
+static size_t round_huge(size_t size) {
+	return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+void *placement_alloc(size_t size, enum HugePages hugepages) {
+
+	void *ptr = MAP_FAILED;
+
+	if (size == 0)
+		size = 1;
+
+	// Explicit huge pages come from the preallocated pool (vm.nr_hugepages)
+	if (hugepages == HUGEPAGES_EXPLICIT) {
+		ptr = mmap(NULL, round_huge(size), PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (ptr != MAP_FAILED)
+			return ptr;
+
+		printf("Explicit huge pages not available, using transparent huge pages\n");
+	}
+
+	// Size rounded the same way in all cases, so that placement_free can recompute it
+	ptr = mmap(NULL, round_huge(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		exit(3);
+	}
+
+	if (hugepages != HUGEPAGES_NONE)
+		madvise(ptr, round_huge(size), MADV_HUGEPAGE);
+
+	return ptr;
+}
+
+void placement_free(void *ptr, size_t size) {
+
+	if (size == 0)
+		size = 1;
+
+	munmap(ptr, round_huge(size));
+
+}
+
+void placement_pin_threads() {
+
+#ifndef __MP_NONE__
+
+	// Let the runtime do its own binding
+	if (getenv("OMP_PROC_BIND"))
+		return;
+
+	// CPUs the process is allowed to run on
+	cpu_set_t allowed;
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+
+	int cpus[CPU_SETSIZE];
+	int n_cpus = 0;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		if (CPU_ISSET(cpu, &allowed))
+			cpus[n_cpus++] = cpu;
+
+	// Thread t runs on the t-th allowed CPU
+	#pragma omp parallel default(none) shared(cpus, n_cpus)
+	{
+		cpu_set_t mine;
+		CPU_ZERO(&mine);
+		CPU_SET(cpus[omp_get_thread_num() % n_cpus], &mine);
+
+		sched_setaffinity(0, sizeof(mine), &mine);
+	}
+
+#endif
+
+}
+
+void placement_report_threads() {
+
+	#pragma omp parallel default(none)
+	{
+		int cpu = sched_getcpu();
+		int thread = 0;
+
+#ifndef __MP_NONE__
+		thread = omp_get_thread_num();
+#endif
+
+		#pragma omp critical
+		printf("Thread %3d: CPU %3d, NUMA node %d\n", thread, cpu, node_of_cpu(cpu));
+	}
+
+}
+
+void placement_report_memory(const char *name, const void *ptr, size_t size) {
+
+	const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	const size_t n_pages = (size + page_size - 1) / page_size;
+
+	void **pages = malloc(n_pages * sizeof(void *));
+	int *status = malloc(n_pages * sizeof(int));
+
+	for (size_t i = 0; i < n_pages; ++i)
+		pages[i] = (char *) ptr + i * page_size;
+
+	// Without target nodes, move_pages only reports the node of each page
+	if (syscall(SYS_move_pages, 0, n_pages, pages, NULL, status, 0) != 0) {
+		printf("%s: page placement not available\n", name);
+		free(pages);
+		free(status);
+		return;
+	}
+
+	size_t per_node[MAX_NODES] = {0};
+	size_t not_present = 0;
+
+	for (size_t i = 0; i < n_pages; ++i) {
+		if (status[i] >= 0 && status[i] < MAX_NODES)
+			per_node[status[i]]++;
+		else
+			not_present++;
+	}
+
+	printf("%s: %zu pages", name, n_pages);
+	for (int node = 0; node < MAX_NODES; ++node)
+		if (per_node[node])
+			printf(", node %d: %zu", node, per_node[node]);
+	if (not_present)
+		printf(", not present: %zu", not_present);
+	printf("\n");
+
+	free(pages);
+	free(status);
+
+}
+
+static int node_of_cpu(int cpu) {
+
+	char path[64];
+	sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+
+	DIR *dir = opendir(path);
+	if (!dir)
+		return -1;
+
+	// The CPU directory contains a "node<N>" link
+	int node = -1;
+	struct dirent *entry;
+
+	while ((entry = readdir(dir)))
+		if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1)
+			break;
+
+	closedir(dir);
+
+	return node;
+}
@@ -0,0 +1,49 @@
+#ifndef MULTICOREMINHASH_PLACEMENT_H
+#define MULTICOREMINHASH_PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "structures.h"
+
+/**
+ * Allocate zero-filled memory with mmap, optionally backed by huge pages. <br>
+ * Pages are not touched, so they are placed on the NUMA node of the thread that first writes them.
+ * If explicit huge pages are not available, normal pages are used instead.
+ * Memory must be freed with placement_free.
+ *
+ * @param size Number of bytes
+ * @param hugepages Kind of huge pages to use
+ * @return The allocated memory
+ */
+void *placement_alloc(size_t size, enum HugePages hugepages);
+
+/**
+ * Free memory allocated with placement_alloc.
+ *
+ * @param ptr The memory
+ * @param size Number of bytes (same as passed to placement_alloc)
+ */
+void placement_free(void *ptr, size_t size);
+
+/**
+ * Pin each OpenMP thread to its own CPU, following the order of the CPUs the process can run on. <br>
+ * Nothing is done if OMP_PROC_BIND is set, since the runtime already binds the threads.
+ */
+void placement_pin_threads();
+
+/**
+ * Print the CPU and NUMA node each OpenMP thread runs on.
+ */
+void placement_report_threads();
+
+/**
+ * Print how many pages of a memory region reside on each NUMA node.
+ *
+ * @param name Name of the region
+ * @param ptr Start of the region
+ * @param size Number of bytes
+ */
+void placement_report_memory(const char *name, const void *ptr, size_t size);
+
+#endif //MULTICOREMINHASH_PLACEMENT_H
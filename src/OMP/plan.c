@@ -0,0 +1,236 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plan.h"
+#include "bbit.h"
+#include "doc_loader.h"
+#include "kernels.h"
+#include "schedule.h"
+#include "signature.h"
+#include "utils.h"
+
+// Bytes in a MB, as for the memory limit
+#define PLAN_MB (1024.0 * 1024.0)
+
+/**
+ * Order document indices increasingly (qsort).
+ */
+static int index_cmp(const void *p_a, const void *p_b);
+
+/**
+ * Next value of a SplitMix64 generator.
+ */
+static uint64_t plan_random(uint64_t *p_state);
+
+/**
+ * Print an estimate scaled from the pairs of the sample, with its 95% interval
+ * (the sampled count is Poisson, the interval is scale * (count +- 2 sqrt(count)), or [0, 3 scale] if none).
+ */
+static void print_estimate(const char *name, unsigned long n_sampled, double scale);
+
+void plan_report(struct Arguments args, bool distributed) {
+
+	const int n_sample = args.plan < args.n_docs ? args.plan : args.n_docs;
+	const int n_workers = args.proc.comm_sz;
+	const int n_words = bbit_words(args.signature_size, args.bbit);
+
+	// Sizes of all the documents, for the bytes to hash
+	long *p_sizes = sched_doc_sizes(args);
+	double total_bytes = 0;
+
+	for (int i = 0; i < args.n_docs; ++i)
+		total_bytes += p_sizes[i];
+
+	// Partial Fisher-Yates shuffle of the documents, then sorted to read them in order
+	int *p_sample = malloc((args.n_docs > 0 ? args.n_docs : 1) * sizeof(int));
+	uint64_t state = (uint64_t) args.seed;
+
+	for (int i = 0; i < args.n_docs; ++i)
+		p_sample[i] = i;
+
+	for (int k = 0; k < n_sample; ++k) {
+		const int swap = k + (int) (plan_random(&state) % (uint64_t) (args.n_docs - k));
+		const int tmp = p_sample[k];
+		p_sample[k] = p_sample[swap];
+		p_sample[swap] = tmp;
+	}
+
+	qsort(p_sample, n_sample, sizeof(int), index_cmp);
+
+	uint32_t *p_signatures = malloc(((size_t) n_sample * args.signature_size + 1) * sizeof(uint32_t));
+	uint64_t *p_bands = malloc(((size_t) n_sample * args.n_bands + 1) * sizeof(uint64_t));
+
+	struct DocLoader *loader = loader_create(args, args.io_batch);
+	struct DocBuffer buffers[args.io_batch];
+	struct DocBuffer *p_buffers[args.io_batch];
+	int doc_numbers[args.io_batch];
+	struct Tokens tokens = {0};
+	struct ShingleSet dedup = {0};
+
+	memset(buffers, 0, sizeof(buffers));
+	for (int k = 0; k < args.io_batch; ++k)
+		p_buffers[k] = &buffers[k];
+
+	// Read and hash the sample, one batch at a time
+	double sample_bytes = 0;
+	double start = wall_time();
+
+	for (int first = 0; first < n_sample; first += args.io_batch) {
+
+		const int count = (n_sample - first < args.io_batch) ? n_sample - first : args.io_batch;
+
+		for (int k = 0; k < count; ++k)
+			doc_numbers[k] = p_sample[first + k] + args.doc_offset;
+
+		loader_read(loader, args.directory, doc_numbers, p_buffers, count);
+
+		for (int k = 0; k < count; ++k) {
+
+			// Sizes as on disk (compressed, if they are), as the ones of the corpus
+			sample_bytes += p_sizes[p_sample[first + k]];
+
+			mh_document_signature(
+					buffers[k].data,
+					buffers[k].size,
+					&tokens,
+					args.dedup ? &dedup : NULL,
+					args.shingle_size,
+					args.shingle_mode,
+					p_signatures + (size_t) (first + k) * args.signature_size,
+					args.signature_size,
+					args.seed,
+					args.kernels
+			);
+		}
+	}
+
+	const double signature_time = wall_time() - start;
+
+	start = wall_time();
+	for (int i = 0; i < n_sample; ++i)
+		args.kernels->compute_bands(p_signatures + (size_t) i * args.signature_size, p_bands + (size_t) i * args.n_bands,
+									args.n_band_rows, args.n_bands);
+	const double bands_time = wall_time() - start;
+
+	if (args.bbit)
+		bbit_pack(p_signatures, n_sample, args.signature_size, args.bbit);
+
+	// Compare all the pairs of the sample, as mh_compare_tile does
+	unsigned long n_candidates = 0, n_similar = 0, result_bytes = 0;
+	char line[64];
+
+	start = wall_time();
+	uint64_t *p_bands_t = kernels_band_major(p_bands, n_sample, args.n_bands);
+
+	for (int i = 0; i < n_sample; ++i)
+		for (int block = (i + 1) - (i + 1) % KERNELS_BLOCK_DOCS; block < n_sample; block += KERNELS_BLOCK_DOCS) {
+
+			uint32_t mask = args.kernels->candidate_mask(p_bands + (size_t) i * args.n_bands,
+														 p_bands_t + (size_t) block * args.n_bands, args.n_bands)
+							& kernels_block_lanes(block, i + 1, n_sample);
+
+			for (; mask; mask &= mask - 1) {
+
+				const int j = block + __builtin_ctz(mask);
+				const uint32_t *p_signature1 = p_signatures + (size_t) i * n_words;
+				const uint32_t *p_signature2 = p_signatures + (size_t) j * n_words;
+
+				++n_candidates;
+
+				const float similarity = args.bbit
+										 ? bbit_similarity(p_signature1, p_signature2, args.signature_size, args.bbit)
+										 : args.kernels->signature_similarity(p_signature1, p_signature2,
+																			  args.signature_size);
+
+				if (similarity >= args.threshold) {
+					++n_similar;
+					result_bytes += snprintf(line, sizeof(line), "%d,%d,%.4f\n", p_sample[i] + args.doc_offset,
+											 p_sample[j] + args.doc_offset, similarity);
+				}
+			}
+		}
+
+	free(p_bands_t);
+	const double compare_time = wall_time() - start;
+
+	// Pairs of the corpus for each pair of the sample
+	const double sample_pairs = (double) n_sample * (n_sample - 1) / 2;
+	const double total_pairs = (double) args.n_docs * (args.n_docs - 1) / 2;
+	const double pair_scale = sample_pairs > 0 ? total_pairs / sample_pairs : 0;
+
+	// Lines of the results (the longest ids if the sample has none)
+	const double line_bytes = n_similar ? (double) result_bytes / n_similar
+										: snprintf(line, sizeof(line), "%d,%d,%.4f\n", args.doc_offset + args.n_docs - 1,
+												   args.doc_offset + args.n_docs - 1, 1.0);
+
+	// Matrices of a worker (of every worker sharing them without MPI), with the band-major copy of the comparison
+	const double signature_bytes = (double) args.n_docs * n_words * sizeof(uint32_t);
+	const double bands_bytes = (double) args.n_docs * args.n_bands * sizeof(uint64_t);
+	const double band_major_bytes = (double) ((args.n_docs + KERNELS_BLOCK_DOCS - 1) / KERNELS_BLOCK_DOCS)
+									* KERNELS_BLOCK_DOCS * args.n_bands * sizeof(uint64_t);
+
+	printf("Plan from %d of %d documents (%.2f%%), %d %s:\n", n_sample, args.n_docs,
+		   args.n_docs ? 100.0 * n_sample / args.n_docs : 0.0, n_workers, distributed ? "processes" : "threads");
+	printf("- Documents: %.1f MB (sample: %.2f MB)\n", total_bytes / PLAN_MB, sample_bytes / PLAN_MB);
+	printf("- Signatures: %.2f s (%.1f MB/s per worker)\n",
+		   sample_bytes > 0 ? signature_time * total_bytes / sample_bytes / n_workers : 0.0,
+		   signature_time > 0 ? sample_bytes / PLAN_MB / signature_time : 0.0);
+	printf("- Bands: %.2f s\n", n_sample ? bands_time * args.n_docs / n_sample / n_workers : 0.0);
+	printf("- Comparison: %.2f s for %.0f pairs\n", compare_time * pair_scale / n_workers, total_pairs);
+	print_estimate("Candidate pairs", n_candidates, pair_scale);
+	print_estimate("Results", n_similar, pair_scale);
+	printf("- Output: %.1f MB (%.1f bytes per result)\n", n_similar * pair_scale * line_bytes / PLAN_MB, line_bytes);
+
+	if (args.memory_limit > 0)
+		printf("- Memory: at most %d MB%s, matrices spilled to disk (%.1f MB)\n", args.memory_limit,
+			   distributed ? " per process" : "", (signature_bytes + bands_bytes) / PLAN_MB);
+	else
+		printf("- Memory%s: %.1f MB (signatures %.1f MB, bands %.1f MB, band-major bands %.1f MB)\n",
+			   distributed ? " per process" : "", (signature_bytes + bands_bytes + band_major_bytes) / PLAN_MB,
+			   signature_bytes / PLAN_MB, bands_bytes / PLAN_MB, band_major_bytes / PLAN_MB);
+
+	// Every process receives the rows of the others
+	if (distributed && args.memory_limit == 0)
+		printf("- Transfer: %.1f MB received by each process\n", (signature_bytes + bands_bytes) / PLAN_MB);
+
+	for (int k = 0; k < args.io_batch; ++k)
+		free(buffers[k].data);
+	tokens_free(&tokens);
+	shingle_set_free(&dedup);
+	loader_destroy(loader);
+
+	free(p_sizes);
+	free(p_sample);
+	free(p_signatures);
+	free(p_bands);
+
+}
+
+static int index_cmp(const void *p_a, const void *p_b) {
+	return *(const int *) p_a - *(const int *) p_b;
+}
+
+static uint64_t plan_random(uint64_t *p_state) {
+
+	uint64_t z = (*p_state += 0x9e3779b97f4a7c15);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+static void print_estimate(const char *name, unsigned long n_sampled, double scale) {
+
+	if (n_sampled == 0) {
+		printf("- %s: none in the sample, at most %.0f\n", name, 3 * scale);
+		return;
+	}
+
+	const double spread = 2 * sqrt((double) n_sampled);
+	const double low = n_sampled > spread ? (n_sampled - spread) * scale : 0;
+
+	printf("- %s: %.0f (95%%: %.0f - %.0f, %lu in the sample)\n", name, n_sampled * scale, low,
+		   (n_sampled + spread) * scale, n_sampled);
+}
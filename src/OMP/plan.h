@@ -0,0 +1,20 @@
+#ifndef MULTICOREMINHASH_PLAN_H
+#define MULTICOREMINHASH_PLAN_H
+
+#include <stdbool.h>
+
+#include "structures.h"
+
+/**
+ * Estimate a run without running it: args.plan documents drawn at random (with args.seed) are read and hashed,
+ * and all their pairs are compared, timing each phase on a single worker. <br>
+ * Times are scaled to the whole corpus (signatures by its bytes, bands by its documents, comparison by its pairs)
+ * and divided among args.proc.comm_sz workers; candidate pairs, results and output size are scaled by the pairs,
+ * with a 95% interval from the pairs found in the sample. The memory of the matrices is computed exactly.
+ *
+ * @param args Algorithm's arguments
+ * @param distributed Whether every worker is a process holding its own copy of the matrices (MPI)
+ */
+void plan_report(struct Arguments args, bool distributed);
+
+#endif //MULTICOREMINHASH_PLAN_H
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "prefetch.h"
+#include "utils.h"
+
+/**
+ * Body of a reader thread: load documents into free slots until all documents are read.
+ *
+ * @param p_queue Pointer to the DocQueue
+ * @return NULL
+ */
+static void *dq_reader(void *p_queue);
+
+/**
+ * Move the next document to be read past the documents to skip (the lock must be held).
+ *
+ * @param queue The queue
+ */
+static void dq_skip(struct DocQueue *queue);
+
+/**
+ * Returns the index of the document at a position of the reading order.
+ *
+ * @param queue The queue
+ * @param position Position in the order
+ * @return Index of the document
+ */
+static inline int dq_doc(const struct DocQueue *queue, int position) {
+	return queue->p_order ? queue->p_order[position] : position;
+}
+
+struct DocQueue *dq_create(struct Arguments args, const uint8_t *p_skip, const int *p_order) {
+
+	struct DocQueue *queue = calloc(1, sizeof(struct DocQueue));
+
+	queue->args = args;
+	queue->depth = args.prefetch_depth;
+	queue->n_readers = args.n_readers;
+	queue->active_readers = args.n_readers;
+	queue->p_skip = p_skip;
+	queue->p_order = p_order;
+	dq_skip(queue);
+
+	// Allocate ring (buffers grow on first use)
+	queue->slots = calloc(queue->depth, sizeof(struct DocSlot));
+	queue->ready = calloc(queue->depth, sizeof(int));
+	queue->free = calloc(queue->depth, sizeof(int));
+
+	// All slots start free
+	for (int i = 0; i < queue->depth; ++i)
+		queue->free[queue->free_count++] = i;
+
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+
+	// Start readers
+	queue->readers = calloc(queue->n_readers, sizeof(pthread_t));
+	for (int i = 0; i < queue->n_readers; ++i)
+		pthread_create(&queue->readers[i], NULL, dq_reader, queue);
+
+	return queue;
+}
+
+static void dq_skip(struct DocQueue *queue) {
+
+	if (queue->p_skip == NULL)
+		return;
+
+	while (queue->next_doc < queue->args.n_docs && queue->p_skip[dq_doc(queue, queue->next_doc)])
+		queue->next_doc++;
+
+}
+
+static void *dq_reader(void *p_queue) {
+
+	struct DocQueue *queue = (struct DocQueue *) p_queue;
+	struct Arguments args = queue->args;
+
+	// Slots and documents of the batch being loaded
+	const int batch_size = args.io_batch < queue->depth ? args.io_batch : queue->depth;
+	struct DocLoader *loader = loader_create(args, batch_size);
+	struct DocSlot *batch_slots[batch_size];
+	struct DocBuffer *batch_buffers[batch_size];
+	int batch_numbers[batch_size];
+
+	while (1) {
+
+		pthread_mutex_lock(&queue->lock);
+
+		// Wait for a free slot (unless there is nothing left to read)
+		if (queue->free_count == 0 && queue->next_doc < args.n_docs) {
+			double stall_start = wall_time();
+			while (queue->free_count == 0 && queue->next_doc < args.n_docs)
+				pthread_cond_wait(&queue->not_full, &queue->lock);
+			queue->reader_stall += wall_time() - stall_start;
+		}
+
+		// Stop if all documents have been assigned to a reader
+		if (queue->next_doc >= args.n_docs)
+			break;
+
+		// Take as many slots and documents as possible, up to a batch
+		int count = 0;
+		while (count < batch_size && queue->free_count > 0 && queue->next_doc < args.n_docs) {
+			struct DocSlot *slot = &queue->slots[queue->free[--queue->free_count]];
+			slot->doc_index = dq_doc(queue, queue->next_doc++);
+			dq_skip(queue);
+
+			batch_slots[count] = slot;
+			batch_buffers[count] = &slot->buffer;
+			batch_numbers[count] = slot->doc_index + args.doc_offset;
+			count++;
+		}
+
+		// Wake up readers waiting for a slot, nothing is left for them
+		if (queue->next_doc == args.n_docs)
+			pthread_cond_broadcast(&queue->not_full);
+
+		pthread_mutex_unlock(&queue->lock);
+
+		// Load documents outside the lock
+		loader_read(loader, args.directory, batch_numbers, batch_buffers, count);
+
+		// Publish the loaded slots
+		pthread_mutex_lock(&queue->lock);
+		for (int i = 0; i < count; ++i) {
+			queue->ready[(queue->ready_head + queue->ready_count) % queue->depth] = (int) (batch_slots[i] - queue->slots);
+			queue->ready_count++;
+		}
+		pthread_cond_broadcast(&queue->not_empty);
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+	// Wake up consumers waiting for documents that won't come
+	queue->active_readers--;
+	pthread_cond_broadcast(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+
+	loader_destroy(loader);
+
+	return NULL;
+}
+
+struct DocSlot *dq_pop(struct DocQueue *queue) {
+
+	struct DocSlot *slot = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+
+	// Wait for a loaded document
+	if (queue->ready_count == 0 && queue->active_readers > 0) {
+		double stall_start = wall_time();
+		while (queue->ready_count == 0 && queue->active_readers > 0)
+			pthread_cond_wait(&queue->not_empty, &queue->lock);
+		queue->consumer_stall += wall_time() - stall_start;
+	}
+
+	// Readers are done and queue is drained otherwise
+	if (queue->ready_count > 0) {
+		slot = &queue->slots[queue->ready[queue->ready_head]];
+		queue->ready_head = (queue->ready_head + 1) % queue->depth;
+		queue->ready_count--;
+	}
+
+	pthread_mutex_unlock(&queue->lock);
+
+	return slot;
+}
+
+void dq_release(struct DocQueue *queue, struct DocSlot *slot) {
+
+	pthread_mutex_lock(&queue->lock);
+	queue->free[queue->free_count++] = (int) (slot - queue->slots);
+	pthread_cond_signal(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+
+}
+
+void dq_destroy(struct DocQueue *queue) {
+
+	for (int i = 0; i < queue->n_readers; ++i)
+		pthread_join(queue->readers[i], NULL);
+
+	if (queue->args.verbose)
+		printf("Prefetch queue stalls: hashing %.3fs (waiting for I/O), readers %.3fs (waiting for free slots)\n",
+			   queue->consumer_stall, queue->reader_stall);
+
+	for (int i = 0; i < queue->depth; ++i)
+		free(queue->slots[i].buffer.data);
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->not_empty);
+	pthread_cond_destroy(&queue->not_full);
+
+	free(queue->readers);
+	free(queue->slots);
+	free(queue->ready);
+	free(queue->free);
+	free(queue);
+
+}
@@ -0,0 +1,96 @@
+#ifndef MULTICOREMINHASH_PREFETCH_H
+#define MULTICOREMINHASH_PREFETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "structures.h"
+#include "doc_loader.h"
+
+/**
+ * A buffer of the prefetch ring, holding the whole content of a document.
+ * Buffers are owned by the queue and reused across documents.
+ */
+struct DocSlot {
+	// Index of the document (0-based, without offset)
+	int doc_index;
+	// Content of the document
+	struct DocBuffer buffer;
+};
+
+/**
+ * Bounded producer/consumer queue of documents.
+ * Reader threads load the documents in order into free slots (up to an I/O batch at a time),
+ * while the hashing threads consume the filled slots and give them back once done.
+ */
+struct DocQueue {
+	// Algorithm's arguments
+	struct Arguments args;
+	// Ring of buffers (depth slots)
+	struct DocSlot *slots;
+	int depth;
+	// FIFO of filled slot indices
+	int *ready;
+	int ready_head;
+	int ready_count;
+	// Stack of free slot indices
+	int *free;
+	int free_count;
+	// Documents not to be read (NULL = read all)
+	const uint8_t *p_skip;
+	// Order in which the documents are read (NULL = by index)
+	const int *p_order;
+	// Position in the order of the next document to be read
+	int next_doc;
+	// Reader threads still running
+	int active_readers;
+	pthread_t *readers;
+	int n_readers;
+	// Queue synchronization
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	// Seconds spent by consumers waiting for a document (I/O bound)
+	double consumer_stall;
+	// Seconds spent by readers waiting for a free slot (CPU bound)
+	double reader_stall;
+};
+
+/**
+ * Create the prefetch queue and start its reader threads.
+ * The queue must be destroyed with dq_destroy.
+ *
+ * @param args Algorithm's arguments (prefetch_depth, n_readers and the I/O backend are used)
+ * @param p_skip Flag of each document telling whether to skip it (NULL to read all documents)
+ * @param p_order Order in which to read the documents (NULL to read them by index)
+ * @return The started queue
+ */
+struct DocQueue *dq_create(struct Arguments args, const uint8_t *p_skip, const int *p_order);
+
+/**
+ * Take the next loaded document from the queue, waiting if none is ready. <br>
+ * Note: the slot must be given back with dq_release once the document is processed.
+ *
+ * @param queue The queue
+ * @return The slot holding the document, or NULL if all documents were consumed
+ */
+struct DocSlot *dq_pop(struct DocQueue *queue);
+
+/**
+ * Give a consumed slot back to the readers.
+ *
+ * @param queue The queue
+ * @param slot Slot returned by dq_pop
+ */
+void dq_release(struct DocQueue *queue, struct DocSlot *slot);
+
+/**
+ * Wait for the reader threads and free the queue memory.
+ *
+ * @param queue The queue
+ */
+void dq_destroy(struct DocQueue *queue);
+
+#endif //MULTICOREMINHASH_PREFETCH_H
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "schedule.h"
+#include "doc_loader.h"
+
+// Pack and unpack the bounds of a deque
+#define BOUNDS(head, tail) ((uint64_t) (uint32_t) (head) | (uint64_t) (uint32_t) (tail) << 32)
+#define BOUNDS_HEAD(bounds) ((int) (uint32_t) (bounds))
+#define BOUNDS_TAIL(bounds) ((int) (uint32_t) ((bounds) >> 32))
+
+/**
+ * Sizes used by the comparison function of qsort.
+ */
+static const long *p_sort_sizes;
+
+/**
+ * Order document indices by decreasing size, then by index.
+ */
+static int lpt_cmp(const void *p_a, const void *p_b);
+
+/**
+ * Take up to max_docs documents from the tail of a deque. Returns the number of taken documents.
+ */
+static int wq_steal(struct WorkDeque *deque, int *p_docs, int max_docs);
+
+long *sched_doc_sizes(struct Arguments args) {
+
+	long *p_sizes = malloc((args.n_docs > 0 ? args.n_docs : 1) * sizeof(long));
+
+	for (int i = 0; i < args.n_docs; ++i)
+		p_sizes[i] = -1;
+
+	// Manifest lines: document number and size in bytes
+	if (args.manifest) {
+
+		FILE *f_manifest = fopen(args.manifest, "r");
+
+		if (f_manifest == NULL) {
+			printf("Error opening manifest %s\n", args.manifest);
+			exit(2);
+		}
+
+		int doc_number;
+		long size;
+
+		while (fscanf(f_manifest, "%d %ld", &doc_number, &size) == 2)
+			if (doc_number >= args.doc_offset && doc_number - args.doc_offset < args.n_docs)
+				p_sizes[doc_number - args.doc_offset] = size;
+
+		fclose(f_manifest);
+	}
+
+	// Documents not in the manifest, from the index of the pack (indexed from the first document of the run)
+	if (args.doc_pack) {
+		for (int i = 0; i < args.n_docs; ++i)
+			if (p_sizes[i] < 0)
+				p_sizes[i] = args.doc_pack->p_sizes[i] > 0 ? args.doc_pack->p_sizes[i] : 0;
+
+		return p_sizes;
+	}
+
+	// Documents not in the manifest (compressed sizes, if they are)
+	char filepath[strlen(args.directory) + 32];
+	struct stat info;
+
+	for (int i = 0; i < args.n_docs; ++i)
+		if (p_sizes[i] < 0) {
+			sprintf(filepath, "%s/%d%s", args.directory, i + args.doc_offset, loader_suffix(args.compression));
+			p_sizes[i] = stat(filepath, &info) == 0 ? (long) info.st_size : 0;
+		}
+
+	return p_sizes;
+}
+
+int *sched_lpt_order(const long *p_sizes, int n_docs) {
+
+	int *p_order = malloc((n_docs > 0 ? n_docs : 1) * sizeof(int));
+
+	for (int i = 0; i < n_docs; ++i)
+		p_order[i] = i;
+
+	// Called once per phase, before the workers start
+	p_sort_sizes = p_sizes;
+	qsort(p_order, n_docs, sizeof(int), lpt_cmp);
+
+	return p_order;
+}
+
+void sched_lpt_assign(const long *p_sizes, int n_docs, int n_workers, const uint8_t *p_skip, int *p_owner) {
+
+	int *p_order = sched_lpt_order(p_sizes, n_docs);
+	long loads[n_workers];
+
+	memset(loads, 0, sizeof(loads));
+
+	// Largest document first, to the least loaded worker
+	for (int k = 0; k < n_docs; ++k) {
+
+		const int i = p_order[k];
+
+		if (p_skip && p_skip[i]) {
+			p_owner[i] = -1;
+			continue;
+		}
+
+		int worker = 0;
+		for (int w = 1; w < n_workers; ++w)
+			if (loads[w] < loads[worker])
+				worker = w;
+
+		p_owner[i] = worker;
+		// Empty documents still cost something
+		loads[worker] += p_sizes[i] + 1;
+	}
+
+	free(p_order);
+
+}
+
+void sched_static_assign(int n_docs, int chunk, int n_workers, int *p_static_owner) {
+
+	const int n_chunks = (n_docs + chunk - 1) / chunk;
+	const int per_worker = n_chunks / n_workers;
+	const int n_larger = n_chunks % n_workers;
+
+	for (int i = 0; i < n_docs; ++i) {
+		const int c = i / chunk;
+		p_static_owner[i] = (c < n_larger * (per_worker + 1))
+							? c / (per_worker + 1)
+							: n_larger + (c - n_larger * (per_worker + 1)) / per_worker;
+	}
+
+}
+
+struct WorkQueue *wq_create(const long *p_sizes, int n_docs, int n_workers, const uint8_t *p_skip) {
+
+	struct WorkQueue *queue = calloc(1, sizeof(struct WorkQueue));
+	queue->n_workers = n_workers;
+	queue->p_deques = aligned_alloc(64, n_workers * sizeof(struct WorkDeque));
+	atomic_init(&queue->n_steals, 0);
+
+	int *p_owner = malloc((n_docs > 0 ? n_docs : 1) * sizeof(int));
+	sched_lpt_assign(p_sizes, n_docs, n_workers, p_skip, p_owner);
+
+	// Count the documents of each worker
+	int counts[n_workers];
+	memset(counts, 0, sizeof(counts));
+
+	for (int i = 0; i < n_docs; ++i)
+		if (p_owner[i] >= 0)
+			counts[p_owner[i]]++;
+
+	for (int w = 0; w < n_workers; ++w) {
+		queue->p_deques[w].p_docs = malloc((counts[w] > 0 ? counts[w] : 1) * sizeof(int));
+		atomic_init(&queue->p_deques[w].bounds, BOUNDS(0, 0));
+	}
+
+	// Fill the deques in decreasing size order
+	int *p_order = sched_lpt_order(p_sizes, n_docs);
+
+	for (int k = 0; k < n_docs; ++k) {
+
+		const int i = p_order[k];
+
+		if (p_owner[i] < 0)
+			continue;
+
+		struct WorkDeque *deque = &queue->p_deques[p_owner[i]];
+		const uint64_t bounds = atomic_load(&deque->bounds);
+		deque->p_docs[BOUNDS_TAIL(bounds)] = i;
+		atomic_store(&deque->bounds, BOUNDS(0, BOUNDS_TAIL(bounds) + 1));
+	}
+
+	free(p_order);
+	free(p_owner);
+
+	return queue;
+}
+
+int wq_pop(struct WorkQueue *queue, int worker, int *p_docs, int max_docs) {
+
+	struct WorkDeque *deque = &queue->p_deques[worker];
+	uint64_t bounds = atomic_load(&deque->bounds);
+
+	// Own documents, from the head (the largest)
+	while (BOUNDS_HEAD(bounds) < BOUNDS_TAIL(bounds)) {
+
+		const int head = BOUNDS_HEAD(bounds);
+		const int tail = BOUNDS_TAIL(bounds);
+		const int count = (tail - head < max_docs) ? tail - head : max_docs;
+
+		if (atomic_compare_exchange_weak(&deque->bounds, &bounds, BOUNDS(head + count, tail))) {
+			memcpy(p_docs, deque->p_docs + head, count * sizeof(int));
+			return count;
+		}
+	}
+
+	// Steal from the worker with the most documents left, until no worker has any
+	while (1) {
+
+		int victim = -1, victim_left = 0;
+
+		for (int w = 0; w < queue->n_workers; ++w) {
+			const uint64_t victim_bounds = atomic_load(&queue->p_deques[w].bounds);
+			const int left = BOUNDS_TAIL(victim_bounds) - BOUNDS_HEAD(victim_bounds);
+
+			if (left > victim_left) {
+				victim = w;
+				victim_left = left;
+			}
+		}
+
+		if (victim < 0)
+			return 0;
+
+		const int count = wq_steal(&queue->p_deques[victim], p_docs, max_docs);
+
+		if (count > 0) {
+			atomic_fetch_add(&queue->n_steals, 1);
+			return count;
+		}
+	}
+
+}
+
+void wq_destroy(struct WorkQueue *queue) {
+
+	for (int w = 0; w < queue->n_workers; ++w)
+		free(queue->p_deques[w].p_docs);
+
+	free(queue->p_deques);
+	free(queue);
+
+}
+
+void sched_report(const double *p_doc_times, const int *p_owner, const int *p_static_owner, int n_docs,
+				  int n_workers) {
+
+	double busy[n_workers], static_busy[n_workers];
+
+	memset(busy, 0, sizeof(busy));
+	memset(static_busy, 0, sizeof(static_busy));
+
+	for (int i = 0; i < n_docs; ++i)
+		if (p_owner[i] >= 0) {
+			busy[p_owner[i]] += p_doc_times[i];
+			static_busy[p_static_owner[i]] += p_doc_times[i];
+		}
+
+	double makespan = 0, static_makespan = 0, total = 0;
+
+	for (int w = 0; w < n_workers; ++w) {
+		makespan = busy[w] > makespan ? busy[w] : makespan;
+		static_makespan = static_busy[w] > static_makespan ? static_busy[w] : static_makespan;
+		total += busy[w];
+	}
+
+	const double saved = static_makespan - makespan;
+
+	printf("Schedule: busiest worker %.3f s (%.3f s average), %.3f s with the static schedule: %.3f s saved (%.1f%%)\n",
+		   makespan, total / n_workers, static_makespan, saved, static_makespan > 0 ? 100 * saved / static_makespan : 0);
+
+}
+
+static int lpt_cmp(const void *p_a, const void *p_b) {
+
+	const int a = *(const int *) p_a;
+	const int b = *(const int *) p_b;
+
+	if (p_sort_sizes[a] != p_sort_sizes[b])
+		return p_sort_sizes[a] > p_sort_sizes[b] ? -1 : 1;
+
+	return a - b;
+}
+
+static int wq_steal(struct WorkDeque *deque, int *p_docs, int max_docs) {
+
+	uint64_t bounds = atomic_load(&deque->bounds);
+
+	while (BOUNDS_HEAD(bounds) < BOUNDS_TAIL(bounds)) {
+
+		const int head = BOUNDS_HEAD(bounds);
+		const int tail = BOUNDS_TAIL(bounds);
+
+		// Half of what is left at most, so that the victim keeps working on its own documents
+		int count = (tail - head + 1) / 2;
+		if (count > max_docs)
+			count = max_docs;
+
+		if (atomic_compare_exchange_weak(&deque->bounds, &bounds, BOUNDS(head, tail - count))) {
+			memcpy(p_docs, deque->p_docs + tail - count, count * sizeof(int));
+			return count;
+		}
+	}
+
+	return 0;
+}
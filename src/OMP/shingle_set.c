@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "shingle_set.h"
+#include "utils.h"
+
+// Seed of the substring hash (independent from the signature seeds)
+#define SUBSTRING_SEED 0x9747b28cU
+
+/**
+ * Mix a fingerprint into a well distributed slot index (murmur3 64-bit finalizer).
+ */
+static inline uint64_t mix_fingerprint(uint64_t key) {
+
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+
+	return key;
+}
+
+void shingle_set_reset(struct ShingleSet *set, int max_shingles, const char *text) {
+
+	// Keep load factor at most 1/2
+	size_t capacity = 16;
+	while (capacity < 2UL * (size_t) max_shingles)
+		capacity <<= 1;
+
+	if (capacity > set->capacity) {
+
+		free(set->keys);
+		free(set->starts);
+		free(set->lens);
+		free(set->stamps);
+
+		set->capacity = capacity;
+		set->keys = malloc(capacity * sizeof(uint64_t));
+		set->starts = malloc(capacity * sizeof(int));
+		set->lens = malloc(capacity * sizeof(int));
+		set->stamps = calloc(capacity, sizeof(uint32_t));
+		set->stamp = 0;
+	}
+
+	// New generation, all entries become empty (clear for real on wrap-around)
+	if (++set->stamp == 0) {
+		memset(set->stamps, 0, set->capacity * sizeof(uint32_t));
+		set->stamp = 1;
+	}
+
+	set->text = text;
+
+}
+
+bool shingle_set_insert_substring(struct ShingleSet *set, int start, int len) {
+
+	const uint64_t key = murmur_hash(set->text + start, len, SUBSTRING_SEED);
+	const size_t mask = set->capacity - 1;
+
+	for (size_t slot = mix_fingerprint(key) & mask;; slot = (slot + 1) & mask) {
+
+		// Empty slot, shingle is new
+		if (set->stamps[slot] != set->stamp) {
+			set->stamps[slot] = set->stamp;
+			set->keys[slot] = key;
+			set->starts[slot] = start;
+			set->lens[slot] = len;
+			set->n_distinct++;
+			return true;
+		}
+
+		// Same hash, check the actual bytes
+		if (set->keys[slot] == key && set->lens[slot] == len
+			&& memcmp(set->text + set->starts[slot], set->text + start, len) == 0) {
+			set->n_repeated++;
+			return false;
+		}
+	}
+
+}
+
+bool shingle_set_insert_fingerprint(struct ShingleSet *set, uint64_t fingerprint) {
+
+	const size_t mask = set->capacity - 1;
+
+	for (size_t slot = mix_fingerprint(fingerprint) & mask;; slot = (slot + 1) & mask) {
+
+		// Empty slot, shingle is new
+		if (set->stamps[slot] != set->stamp) {
+			set->stamps[slot] = set->stamp;
+			set->keys[slot] = fingerprint;
+			set->n_distinct++;
+			return true;
+		}
+
+		if (set->keys[slot] == fingerprint) {
+			set->n_repeated++;
+			return false;
+		}
+	}
+
+}
+
+void shingle_set_free(struct ShingleSet *set) {
+
+	free(set->keys);
+	free(set->starts);
+	free(set->lens);
+	free(set->stamps);
+	memset(set, 0, sizeof(struct ShingleSet));
+
+}
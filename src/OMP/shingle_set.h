@@ -0,0 +1,69 @@
+#ifndef MULTICOREMINHASH_SHINGLE_SET_H
+#define MULTICOREMINHASH_SHINGLE_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Open-addressing (linear probing) hash set of the shingles of a document,
+ * used to run each distinct shingle through the signature loop only once. <br>
+ * Shingles are either substrings of a text (compared byte by byte) or 64-bit fingerprints.
+ * The set is emptied in constant time between documents, and its memory is reused.
+ */
+struct ShingleSet {
+	// Hash (substrings) or fingerprint of each entry
+	uint64_t *keys;
+	// Offset and length in text of each entry (substrings only)
+	int *starts;
+	int *lens;
+	// Generation of each entry, entries of older generations are empty
+	uint32_t *stamps;
+	// Number of slots (power of two)
+	size_t capacity;
+	// Current generation
+	uint32_t stamp;
+	// Text the substrings belong to
+	const char *text;
+	// Shingles inserted since the set was created (distinct within their document)
+	size_t n_distinct;
+	// Shingles found already in the set since the set was created
+	size_t n_repeated;
+};
+
+/**
+ * Empty the set, making room for the shingles of a new document.
+ *
+ * @param set The set
+ * @param max_shingles Maximum number of shingles that will be inserted
+ * @param text Text the substring shingles belong to (NULL for fingerprints)
+ */
+void shingle_set_reset(struct ShingleSet *set, int max_shingles, const char *text);
+
+/**
+ * Insert a substring of the set's text.
+ *
+ * @param set The set
+ * @param start Offset of the substring
+ * @param len Length of the substring
+ * @return True if the substring was not in the set yet, false otherwise
+ */
+bool shingle_set_insert_substring(struct ShingleSet *set, int start, int len);
+
+/**
+ * Insert a fingerprint.
+ *
+ * @param set The set
+ * @param fingerprint The fingerprint
+ * @return True if the fingerprint was not in the set yet, false otherwise
+ */
+bool shingle_set_insert_fingerprint(struct ShingleSet *set, uint64_t fingerprint);
+
+/**
+ * Free the memory used by the set.
+ *
+ * @param set The set
+ */
+void shingle_set_free(struct ShingleSet *set);
+
+#endif //MULTICOREMINHASH_SHINGLE_SET_H
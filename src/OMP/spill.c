@@ -0,0 +1,267 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spill.h"
+#include "utils.h"
+
+/**
+ * Write a whole buffer at the given offset.
+ */
+static void pwrite_all(int fd, const void *buf, size_t size, off_t offset);
+
+/**
+ * Read a whole buffer from the given offset.
+ */
+static void pread_all(int fd, void *buf, size_t size, off_t offset);
+
+/**
+ * Body of the prefetch thread.
+ */
+static void *spill_prefetch_run(void *p_prefetch);
+
+/**
+ * Returns the buffer holding a block, reading the block into a buffer other than avoid if needed.
+ */
+static int spill_load_block(struct SpillFile *spill, int block_docs, int block, int avoid, int *held,
+							uint32_t **p_signatures, uint64_t **p_bands);
+
+struct SpillFile *spill_open(struct Arguments args, bool create) {
+
+	struct SpillFile *spill = malloc(sizeof(struct SpillFile));
+
+	spill->n_docs = args.n_docs;
+	spill->signature_size = args.signature_size;
+	spill->n_bands = args.n_bands;
+	spill->path = strdup(args.spill_path);
+	spill->fd = open(spill->path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+
+	if (spill->fd < 0) {
+		printf("Error opening spill file %s\n", spill->path);
+		exit(2);
+	}
+
+	if (create) {
+		off_t size = (off_t) args.n_docs * (args.signature_size * sizeof(uint32_t) + args.n_bands * sizeof(uint64_t));
+		if (ftruncate(spill->fd, size) != 0) {
+			printf("Error sizing spill file %s\n", spill->path);
+			exit(2);
+		}
+	}
+
+	return spill;
+}
+
+void spill_close(struct SpillFile *spill, bool remove_file) {
+
+	close(spill->fd);
+
+	if (remove_file)
+		unlink(spill->path);
+
+	free(spill->path);
+	free(spill);
+
+}
+
+void spill_write(struct SpillFile *spill, int first_doc, int n_docs, const uint32_t *p_signatures,
+				 const uint64_t *p_bands) {
+
+	const off_t bands_start = (off_t) spill->n_docs * spill->signature_size * (off_t) sizeof(uint32_t);
+
+	pwrite_all(spill->fd, p_signatures, (size_t) n_docs * spill->signature_size * sizeof(uint32_t),
+			   (off_t) first_doc * spill->signature_size * (off_t) sizeof(uint32_t));
+	pwrite_all(spill->fd, p_bands, (size_t) n_docs * spill->n_bands * sizeof(uint64_t),
+			   bands_start + (off_t) first_doc * spill->n_bands * (off_t) sizeof(uint64_t));
+
+}
+
+void spill_read(struct SpillFile *spill, int first_doc, int n_docs, uint32_t *p_signatures, uint64_t *p_bands) {
+
+	const off_t bands_start = (off_t) spill->n_docs * spill->signature_size * (off_t) sizeof(uint32_t);
+
+	pread_all(spill->fd, p_signatures, (size_t) n_docs * spill->signature_size * sizeof(uint32_t),
+			  (off_t) first_doc * spill->signature_size * (off_t) sizeof(uint32_t));
+	pread_all(spill->fd, p_bands, (size_t) n_docs * spill->n_bands * sizeof(uint64_t),
+			  bands_start + (off_t) first_doc * spill->n_bands * (off_t) sizeof(uint64_t));
+
+}
+
+void spill_prefetch_start(struct SpillPrefetch *prefetch, struct SpillFile *spill, int first_doc, int n_docs,
+						  uint32_t *p_signatures, uint64_t *p_bands) {
+
+	prefetch->spill = spill;
+	prefetch->first_doc = first_doc;
+	prefetch->n_docs = n_docs;
+	prefetch->p_signatures = p_signatures;
+	prefetch->p_bands = p_bands;
+	prefetch->active = true;
+
+	pthread_create(&prefetch->thread, NULL, spill_prefetch_run, prefetch);
+
+}
+
+void spill_prefetch_wait(struct SpillPrefetch *prefetch) {
+
+	if (!prefetch->active)
+		return;
+
+	double wait_start = wall_time();
+	pthread_join(prefetch->thread, NULL);
+	prefetch->wait_time += wall_time() - wait_start;
+
+	prefetch->active = false;
+
+}
+
+double spill_compare_tiles(struct Arguments args, struct SpillFile *spill, int block_docs, const int *p_tiles,
+						   int n_tiles, spill_tile_fn compare_tile, FILE *f_csv, struct CompareStats *p_stats) {
+
+	// Three buffers of a block each, and the block held by each buffer (-1 if none)
+	uint32_t *p_signatures[3];
+	uint64_t *p_bands[3];
+	int held[3] = {-1, -1, -1};
+	struct SpillPrefetch prefetch = {0};
+
+	for (int k = 0; k < 3; ++k) {
+		p_signatures[k] = malloc((size_t) block_docs * spill->signature_size * sizeof(uint32_t));
+		p_bands[k] = malloc((size_t) block_docs * spill->n_bands * sizeof(uint64_t));
+	}
+
+	for (int t = 0; t < n_tiles; ++t) {
+
+		const int bi = p_tiles[2 * t];
+		const int bj = p_tiles[2 * t + 1];
+
+		// Wait for the block read during the previous tile
+		spill_prefetch_wait(&prefetch);
+
+		// Read the blocks of the tile that are not in memory yet (without evicting each other)
+		double load_start = wall_time();
+		int avoid = -1;
+		for (int k = 0; k < 3; ++k)
+			if (held[k] == bj)
+				avoid = k;
+		const int ci = spill_load_block(spill, block_docs, bi, avoid, held, p_signatures, p_bands);
+		const int cj = spill_load_block(spill, block_docs, bj, ci, held, p_signatures, p_bands);
+		prefetch.wait_time += wall_time() - load_start;
+
+		// Start reading a block of the next tile into the buffer not used by this tile
+		for (int n = 0; t + 1 < n_tiles && n < 2; ++n) {
+
+			const int block = p_tiles[2 * (t + 1) + n];
+
+			if (held[0] == block || held[1] == block || held[2] == block)
+				continue;
+
+			const int c = (ci != 0 && cj != 0) ? 0 : (ci != 1 && cj != 1) ? 1 : 2;
+			const int first_doc = block * block_docs;
+			const int count = (spill->n_docs - first_doc < block_docs) ? spill->n_docs - first_doc : block_docs;
+
+			held[c] = block;
+			spill_prefetch_start(&prefetch, spill, first_doc, count, p_signatures[c], p_bands[c]);
+			break;
+		}
+
+		const int first_i = bi * block_docs;
+		const int first_j = bj * block_docs;
+
+		compare_tile(args,
+					 p_signatures[ci], p_bands[ci], first_i,
+					 (spill->n_docs - first_i < block_docs) ? spill->n_docs - first_i : block_docs,
+					 p_signatures[cj], p_bands[cj], first_j,
+					 (spill->n_docs - first_j < block_docs) ? spill->n_docs - first_j : block_docs,
+					 f_csv, p_stats);
+	}
+
+	spill_prefetch_wait(&prefetch);
+
+	for (int k = 0; k < 3; ++k) {
+		free(p_signatures[k]);
+		free(p_bands[k]);
+	}
+
+	return prefetch.wait_time;
+}
+
+int spill_block_docs(struct Arguments args) {
+
+	const size_t limit = (size_t) args.memory_limit * 1024UL * 1024UL;
+	const size_t doc_bytes = args.signature_size * sizeof(uint32_t) + args.n_bands * sizeof(uint64_t);
+
+	size_t block_docs = limit / (3 * doc_bytes);
+
+	if (block_docs < 1) {
+		printf("The memory limit is too small to hold three documents.\n");
+		exit(1);
+	}
+
+	return block_docs > (size_t) args.n_docs ? args.n_docs : (int) block_docs;
+}
+
+static void *spill_prefetch_run(void *p_prefetch) {
+
+	struct SpillPrefetch *prefetch = (struct SpillPrefetch *) p_prefetch;
+
+	spill_read(prefetch->spill, prefetch->first_doc, prefetch->n_docs, prefetch->p_signatures, prefetch->p_bands);
+
+	return NULL;
+}
+
+static void pwrite_all(int fd, const void *buf, size_t size, off_t offset) {
+
+	while (size > 0) {
+		ssize_t written = pwrite(fd, buf, size, offset);
+
+		if (written <= 0) {
+			perror("Error writing spill file");
+			exit(2);
+		}
+
+		buf = (const char *) buf + written;
+		size -= written;
+		offset += written;
+	}
+
+}
+
+static void pread_all(int fd, void *buf, size_t size, off_t offset) {
+
+	while (size > 0) {
+		ssize_t n_read = pread(fd, buf, size, offset);
+
+		if (n_read <= 0) {
+			perror("Error reading spill file");
+			exit(2);
+		}
+
+		buf = (char *) buf + n_read;
+		size -= n_read;
+		offset += n_read;
+	}
+
+}
+
+static int spill_load_block(struct SpillFile *spill, int block_docs, int block, int avoid, int *held,
+							uint32_t **p_signatures, uint64_t **p_bands) {
+
+	int c;
+
+	// Already in memory
+	for (c = 0; c < 3; ++c)
+		if (held[c] == block)
+			return c;
+
+	// Take the first buffer that can be evicted
+	for (c = 0; c == avoid; ++c);
+
+	const int first_doc = block * block_docs;
+	const int count = (spill->n_docs - first_doc < block_docs) ? spill->n_docs - first_doc : block_docs;
+
+	spill_read(spill, first_doc, count, p_signatures[c], p_bands[c]);
+	held[c] = block;
+
+	return c;
+}
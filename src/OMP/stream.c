@@ -0,0 +1,389 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream.h"
+#include "utils.h"
+
+// Size of the header of a record
+#define RECORD_HEADER 4
+
+// Bytes read from the stream at once (at least)
+#define STREAM_READ_SIZE (1 << 16)
+
+/**
+ * Make at least need bytes available in the reader's buffer, reading from the stream as needed.
+ * Returns false if the stream ends before.
+ */
+static bool stream_fill(struct StreamReader *reader, size_t need);
+
+/**
+ * Length of the next record, if its header is buffered (-1 otherwise).
+ */
+static long stream_next_length(const struct StreamReader *reader);
+
+/**
+ * Slot of a band table holding a key, or the empty slot ending its probe sequence.
+ * The first slot of the sequence whose documents all left the window is stored in p_stale (if any).
+ */
+static size_t band_table_find(const struct BandTable *table, uint64_t key, long first, size_t *p_stale);
+
+/**
+ * Rebuild a band table without the keys whose documents all left the window.
+ */
+static void band_table_compact(struct BandTable *table, long first);
+
+/**
+ * Order latencies increasingly.
+ */
+static int latency_cmp(const void *p_a, const void *p_b);
+
+struct StreamReader *stream_open(const char *path) {
+
+	struct StreamReader *reader = calloc(1, sizeof(struct StreamReader));
+
+	// Opening a FIFO waits for a writer
+	reader->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+
+	if (reader->fd < 0) {
+		printf("Error opening stream %s\n", path);
+		exit(2);
+	}
+
+	reader->capacity = STREAM_READ_SIZE;
+	reader->p_buffer = malloc(reader->capacity);
+
+	return reader;
+}
+
+bool stream_read(struct StreamReader *reader, struct StreamRecord *record) {
+
+	if (!stream_fill(reader, RECORD_HEADER)) {
+		if (reader->end > reader->start)
+			printf("Truncated record at the end of the stream, ignored\n");
+		return false;
+	}
+
+	const size_t size = (size_t) stream_next_length(reader);
+
+	if (!stream_fill(reader, RECORD_HEADER + size)) {
+		printf("Truncated record at the end of the stream, ignored\n");
+		return false;
+	}
+
+	// Keep the document, the reader's buffer is reused by the next records
+	if (record->capacity < size) {
+		record->capacity = size;
+		record->data = realloc(record->data, size);
+	}
+
+	memcpy(record->data, reader->p_buffer + reader->start + RECORD_HEADER, size);
+	record->size = size;
+	record->arrival = wall_time();
+	reader->start += RECORD_HEADER + size;
+
+	return true;
+}
+
+bool stream_ready(struct StreamReader *reader) {
+
+	const long size = stream_next_length(reader);
+
+	if (reader->eof || (size >= 0 && reader->end - reader->start >= RECORD_HEADER + (size_t) size))
+		return true;
+
+	// Data (or the end of the stream) is pending
+	struct pollfd pending = {reader->fd, POLLIN, 0};
+	return poll(&pending, 1, 0) > 0;
+}
+
+void stream_close(struct StreamReader *reader) {
+
+	if (reader->fd != STDIN_FILENO)
+		close(reader->fd);
+
+	free(reader->p_buffer);
+	free(reader);
+
+}
+
+struct StreamWindow *window_create(struct Arguments args) {
+
+	struct StreamWindow *window = calloc(1, sizeof(struct StreamWindow));
+	const size_t capacity = args.window_docs;
+
+	window->capacity = args.window_docs;
+	window->signature_size = args.signature_size;
+	window->n_bands = args.n_bands;
+	window->p_signatures = malloc(capacity * args.signature_size * sizeof(uint32_t));
+	window->p_bands = malloc(capacity * args.n_bands * sizeof(uint64_t));
+	window->p_arrivals = malloc(capacity * sizeof(double));
+	window->p_chains = malloc(capacity * args.n_bands * sizeof(long));
+	window->p_seen = malloc(capacity * sizeof(long));
+	window->p_tables = malloc(args.n_bands * sizeof(struct BandTable));
+
+	for (size_t slot = 0; slot < capacity; ++slot)
+		window->p_seen[slot] = -1;
+
+	// At most half full with the keys of the documents in the window
+	size_t n_slots = 16;
+	while (n_slots < 2 * capacity)
+		n_slots *= 2;
+
+	for (int j = 0; j < args.n_bands; ++j) {
+
+		struct BandTable *table = &window->p_tables[j];
+
+		table->mask = n_slots - 1;
+		table->n_used = 0;
+		table->p_keys = malloc(n_slots * sizeof(uint64_t));
+		table->p_heads = malloc(n_slots * sizeof(long));
+
+		for (size_t i = 0; i < n_slots; ++i)
+			table->p_heads[i] = -1;
+	}
+
+	if (window->p_signatures == NULL || window->p_bands == NULL || window->p_tables[args.n_bands - 1].p_heads == NULL) {
+		printf("Error allocating the stream window\n");
+		exit(2);
+	}
+
+	return window;
+}
+
+int window_evict(struct StreamWindow *window, double oldest) {
+
+	int n_evicted = 0;
+
+	while (window->first < window->next && window->p_arrivals[window->first % window->capacity] < oldest) {
+		window->first++;
+		n_evicted++;
+	}
+
+	return n_evicted;
+}
+
+int window_candidates(struct StreamWindow *window, const uint64_t *p_bands, long *p_candidates) {
+
+	int n_candidates = 0;
+
+	for (int j = 0; j < window->n_bands; ++j) {
+
+		const struct BandTable *table = &window->p_tables[j];
+		const size_t i = band_table_find(table, p_bands[j], window->first, NULL);
+
+		// Documents of the bucket, from the most recent to the first one out of the window
+		for (long seq = table->p_heads[i]; seq >= window->first;) {
+
+			const size_t slot = seq % window->capacity;
+
+			if (window->p_seen[slot] != window->next) {
+				window->p_seen[slot] = window->next;
+				p_candidates[n_candidates++] = seq;
+			}
+
+			seq = window->p_chains[slot * window->n_bands + j];
+		}
+	}
+
+	return n_candidates;
+}
+
+long window_insert(struct StreamWindow *window, const uint32_t *p_signature, const uint64_t *p_bands, double arrival) {
+
+	const long seq = window->next++;
+	const size_t slot = seq % window->capacity;
+
+	// The slot of the oldest document is reused
+	if (seq - window->first >= window->capacity)
+		window->first = seq - window->capacity + 1;
+
+	memcpy(window->p_signatures + slot * window->signature_size, p_signature,
+		   window->signature_size * sizeof(uint32_t));
+	memcpy(window->p_bands + slot * window->n_bands, p_bands, window->n_bands * sizeof(uint64_t));
+	window->p_arrivals[slot] = arrival;
+	window->p_seen[slot] = -1;
+
+	for (int j = 0; j < window->n_bands; ++j) {
+
+		struct BandTable *table = &window->p_tables[j];
+		size_t stale = SIZE_MAX;
+		size_t i = band_table_find(table, p_bands[j], window->first, &stale);
+
+		if (table->p_heads[i] >= 0) {
+			// Prepend the document to the bucket
+			window->p_chains[slot * window->n_bands + j] = table->p_heads[i];
+			table->p_heads[i] = seq;
+			continue;
+		}
+
+		// New bucket, in place of a key that left the window if possible
+		window->p_chains[slot * window->n_bands + j] = -1;
+
+		if (stale != SIZE_MAX)
+			i = stale;
+		else
+			table->n_used++;
+
+		table->p_keys[i] = p_bands[j];
+		table->p_heads[i] = seq;
+
+		if (table->n_used * 4 > (table->mask + 1) * 3)
+			band_table_compact(table, window->first);
+	}
+
+	return seq;
+}
+
+const uint32_t *window_signature(const struct StreamWindow *window, long seq) {
+	return window->p_signatures + (seq % window->capacity) * window->signature_size;
+}
+
+void window_destroy(struct StreamWindow *window) {
+
+	for (int j = 0; j < window->n_bands; ++j) {
+		free(window->p_tables[j].p_keys);
+		free(window->p_tables[j].p_heads);
+	}
+
+	free(window->p_tables);
+	free(window->p_signatures);
+	free(window->p_bands);
+	free(window->p_arrivals);
+	free(window->p_chains);
+	free(window->p_seen);
+	free(window);
+
+}
+
+void stream_latency_record(struct StreamLatency *latency, double seconds) {
+	latency->p_window[latency->n_recorded++ % STREAM_LATENCY_WINDOW] = (float) (seconds * 1e6);
+}
+
+void stream_report(struct StreamLatency *latency, long n_docs, double seconds, unsigned long n_matches,
+				   int window_docs) {
+
+	const size_t n = latency->n_recorded < STREAM_LATENCY_WINDOW ? latency->n_recorded : STREAM_LATENCY_WINDOW;
+	float *p_sorted = malloc((n > 0 ? n : 1) * sizeof(float));
+
+	memcpy(p_sorted, latency->p_window, n * sizeof(float));
+	qsort(p_sorted, n, sizeof(float), latency_cmp);
+
+	printf("Stream: %ld documents in %.2f s (%.1f docs/s), %lu matches, %d documents in the window\n", n_docs, seconds,
+		   seconds > 0 ? n_docs / seconds : 0.0, n_matches, window_docs);
+
+	if (n > 0)
+		printf("- Latency (last %zu documents): p50 %.0f us, p99 %.0f us, max %.0f us\n", n,
+			   p_sorted[(size_t) (0.5 * (n - 1))], p_sorted[(size_t) (0.99 * (n - 1))], p_sorted[n - 1]);
+
+	free(p_sorted);
+
+}
+
+static bool stream_fill(struct StreamReader *reader, size_t need) {
+
+	while (reader->end - reader->start < need) {
+
+		if (reader->eof)
+			return false;
+
+		// Move the pending bytes to the start of the buffer, and make room for the record
+		if (reader->start > 0) {
+			memmove(reader->p_buffer, reader->p_buffer + reader->start, reader->end - reader->start);
+			reader->end -= reader->start;
+			reader->start = 0;
+		}
+
+		if (reader->capacity < need + STREAM_READ_SIZE) {
+			reader->capacity = need + STREAM_READ_SIZE;
+			reader->p_buffer = realloc(reader->p_buffer, reader->capacity);
+		}
+
+		const ssize_t n_read = read(reader->fd, reader->p_buffer + reader->end, reader->capacity - reader->end);
+
+		if (n_read < 0 && errno == EINTR)
+			continue;
+
+		if (n_read < 0) {
+			printf("Error reading the stream\n");
+			exit(2);
+		}
+
+		if (n_read == 0)
+			reader->eof = true;
+
+		reader->end += n_read;
+	}
+
+	return true;
+}
+
+static long stream_next_length(const struct StreamReader *reader) {
+
+	if (reader->end - reader->start < RECORD_HEADER)
+		return -1;
+
+	const uint8_t *p_header = (const uint8_t *) reader->p_buffer + reader->start;
+
+	return (long) ((uint32_t) p_header[0] | (uint32_t) p_header[1] << 8 | (uint32_t) p_header[2] << 16
+				   | (uint32_t) p_header[3] << 24);
+}
+
+static size_t band_table_find(const struct BandTable *table, uint64_t key, long first, size_t *p_stale) {
+
+	// MurmurHash3 finalizer, XOR band keys only use the low 32 bits
+	uint64_t h = key;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	size_t i = h & table->mask;
+
+	while (table->p_heads[i] >= 0 && table->p_keys[i] != key) {
+
+		if (p_stale && *p_stale == SIZE_MAX && table->p_heads[i] < first)
+			*p_stale = i;
+
+		i = (i + 1) & table->mask;
+	}
+
+	return i;
+}
+
+static void band_table_compact(struct BandTable *table, long first) {
+
+	const size_t n_slots = table->mask + 1;
+	uint64_t *p_keys = table->p_keys;
+	long *p_heads = table->p_heads;
+
+	table->p_keys = malloc(n_slots * sizeof(uint64_t));
+	table->p_heads = malloc(n_slots * sizeof(long));
+	table->n_used = 0;
+
+	for (size_t i = 0; i < n_slots; ++i)
+		table->p_heads[i] = -1;
+
+	for (size_t i = 0; i < n_slots; ++i)
+		if (p_heads[i] >= first) {
+			const size_t slot = band_table_find(table, p_keys[i], first, NULL);
+			table->p_keys[slot] = p_keys[i];
+			table->p_heads[slot] = p_heads[i];
+			table->n_used++;
+		}
+
+	free(p_keys);
+	free(p_heads);
+
+}
+
+static int latency_cmp(const void *p_a, const void *p_b) {
+
+	const float a = *(const float *) p_a;
+	const float b = *(const float *) p_b;
+
+	return (a > b) - (a < b);
+}
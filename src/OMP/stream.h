@@ -0,0 +1,198 @@
+#ifndef MULTICOREMINHASH_STREAM_H
+#define MULTICOREMINHASH_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "structures.h"
+
+// Number of most recent documents the latency percentiles are computed on
+#define STREAM_LATENCY_WINDOW 65536
+
+/**
+ * Reader of a stream of documents (standard input, a FIFO or a file). <br>
+ * Each record is the length of the document in bytes (32-bit unsigned, little-endian) followed by its content.
+ */
+struct StreamReader {
+	int fd;
+	// Bytes read from the stream and not consumed yet
+	char *p_buffer;
+	size_t start;
+	size_t end;
+	size_t capacity;
+	// Whether the end of the stream was reached
+	bool eof;
+};
+
+/**
+ * A document read from a stream.
+ */
+struct StreamRecord {
+	// Content of the document (not null-terminated)
+	char *data;
+	size_t size;
+	size_t capacity;
+	// Time at which the record was completely read (see wall_time)
+	double arrival;
+};
+
+/**
+ * Bucket table of a band: open addressing from a band key to the most recent document with that key.
+ */
+struct BandTable {
+	// Number of slots minus one (the number of slots is a power of two)
+	size_t mask;
+	// Slots holding a key (including the ones whose documents all left the window)
+	size_t n_used;
+	uint64_t *p_keys;
+	// Sequence number of the most recent document of each key (-1 = empty slot)
+	long *p_heads;
+};
+
+/**
+ * Sliding window of the most recent documents of a stream, with their LSH buckets. <br>
+ * A document is identified by its sequence number (its position in the stream) and stored in the slot
+ * seq % capacity. The documents of a bucket are chained from the most recent to the oldest,
+ * so evicting the oldest documents only means moving the start of the window:
+ * a chain is cut at the first document that left it.
+ */
+struct StreamWindow {
+	// Maximum number of documents in the window
+	int capacity;
+	int signature_size;
+	int n_bands;
+	// Sequence number of the oldest document in the window, and of the next document
+	long first;
+	long next;
+	// Signature and bands rows of each slot
+	uint32_t *p_signatures;
+	uint64_t *p_bands;
+	// Arrival time of each slot
+	double *p_arrivals;
+	// For each slot and band, sequence number of the previous document with the same key (-1 = none)
+	long *p_chains;
+	// For each slot, last document whose candidates included it (to report each pair once)
+	long *p_seen;
+	// Bucket table of each band
+	struct BandTable *p_tables;
+};
+
+/**
+ * Latencies of the most recent documents, in a ring buffer.
+ */
+struct StreamLatency {
+	// Latencies in microseconds
+	float p_window[STREAM_LATENCY_WINDOW];
+	// Total number of recorded documents
+	uint64_t n_recorded;
+};
+
+/**
+ * Open a stream of documents. If it can't be opened, the program exits.
+ *
+ * @param path Path of the FIFO or file ("-" for the standard input)
+ * @return The stream reader
+ */
+struct StreamReader *stream_open(const char *path);
+
+/**
+ * Read the next record, waiting for it if needed.
+ *
+ * @param reader The stream reader
+ * @param record Where to store the document (its memory is reused across records)
+ * @return False at the end of the stream (or on a truncated record)
+ */
+bool stream_read(struct StreamReader *reader, struct StreamRecord *record);
+
+/**
+ * Whether a record can be read without waiting for the writer (it is buffered or data is pending).
+ *
+ * @param reader The stream reader
+ * @return True if stream_read wouldn't wait for new data
+ */
+bool stream_ready(struct StreamReader *reader);
+
+/**
+ * Close the stream (except the standard input) and free the reader.
+ *
+ * @param reader The stream reader
+ */
+void stream_close(struct StreamReader *reader);
+
+/**
+ * Create an empty window.
+ *
+ * @param args Algorithm's arguments (window size, signature size and number of bands are used)
+ * @return The window
+ */
+struct StreamWindow *window_create(struct Arguments args);
+
+/**
+ * Evict the documents that arrived before a given time.
+ *
+ * @param window The window
+ * @param oldest Arrival time of the oldest document to keep
+ * @return Number of evicted documents
+ */
+int window_evict(struct StreamWindow *window, double oldest);
+
+/**
+ * Find the documents of the window sharing at least one band key with a new document (each one once).
+ *
+ * @param window The window
+ * @param p_bands Band keys of the new document
+ * @param p_candidates Where to store the sequence numbers of the candidates (up to the window capacity)
+ * @return Number of candidates
+ */
+int window_candidates(struct StreamWindow *window, const uint64_t *p_bands, long *p_candidates);
+
+/**
+ * Add a document to the window, evicting the oldest one if the window is full.
+ *
+ * @param window The window
+ * @param p_signature Signature of the document
+ * @param p_bands Band keys of the document
+ * @param arrival Arrival time of the document
+ * @return Sequence number of the document
+ */
+long window_insert(struct StreamWindow *window, const uint32_t *p_signature, const uint64_t *p_bands, double arrival);
+
+/**
+ * Returns the signature of a document in the window.
+ *
+ * @param window The window
+ * @param seq Sequence number of the document
+ * @return The signature
+ */
+const uint32_t *window_signature(const struct StreamWindow *window, long seq);
+
+/**
+ * Free the window memory.
+ *
+ * @param window The window
+ */
+void window_destroy(struct StreamWindow *window);
+
+/**
+ * Record the latency of a document.
+ *
+ * @param latency The recorder
+ * @param seconds Time between the arrival of the document and the report of its matches
+ */
+void stream_latency_record(struct StreamLatency *latency, double seconds);
+
+/**
+ * Print the number of documents, their sustained rate and the latency percentiles (p50, p99 and max)
+ * of the most recent documents.
+ *
+ * @param latency The recorder
+ * @param n_docs Number of processed documents
+ * @param seconds Time since the first document arrived
+ * @param n_matches Number of reported pairs
+ * @param window_docs Number of documents in the window
+ */
+void stream_report(struct StreamLatency *latency, long n_docs, double seconds, unsigned long n_matches,
+				   int window_docs);
+
+#endif //MULTICOREMINHASH_STREAM_H
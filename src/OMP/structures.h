@@ -1,6 +1,76 @@
 #ifndef MULTICOREMINHASH_STRUCTURES_H
 #define MULTICOREMINHASH_STRUCTURES_H
 
+// Backend used to read the documents
+enum IoBackend {
+	// Whole document at once through pread
+	IO_PREAD,
+	// Batches of documents through io_uring (pread if unavailable)
+	IO_URING
+};
+
+// Compression of the documents
+enum Compression {
+	// Plain text (<number>.txt)
+	COMPRESSION_NONE,
+	// Gzip members, inflated with zlib (<number>.txt.gz)
+	COMPRESSION_GZIP,
+	// Zstandard frames, only if compiled with zstd=1 (<number>.txt.zst)
+	COMPRESSION_ZSTD
+};
+
+// Unit a shingle is made of
+enum ShingleMode {
+	// Consecutive normalized words
+	SHINGLE_WORDS,
+	// Consecutive characters of the normalized text
+	SHINGLE_CHARS
+};
+
+// Hash function of the shingles
+enum HashFamily {
+	// MurmurHash2 (32 bits)
+	HASH_MURMUR2,
+	// XXH3 (low 32 bits of the 64-bit hash)
+	HASH_XXH3,
+	// CRC32C (SSE4.2 if available) with a final mix
+	HASH_CRC32C
+};
+
+// How the rows of a band are combined into its key
+enum BandKey {
+	// XOR of the rows, zero-extended to 64 bits (ignores the row order)
+	BANDKEY_XOR,
+	// 64-bit mix of the ordered rows
+	BANDKEY_MIX64
+};
+
+// Pages backing the signature and bands matrices
+enum HugePages {
+	// Normal pages
+	HUGEPAGES_NONE,
+	// Transparent huge pages (madvise)
+	HUGEPAGES_THP,
+	// Huge pages from the preallocated pool (MAP_HUGETLB)
+	HUGEPAGES_EXPLICIT
+};
+
+// Order in which the documents are hashed
+enum Schedule {
+	// Contiguous ranges of documents of the same count for every worker
+	SCHEDULE_STATIC,
+	// Largest documents first, balancing the bytes of every worker
+	SCHEDULE_LPT
+};
+
+// Configuration evaluated by a parameter sweep
+struct SweepConfig {
+	// Rows of the signature prefix
+	int signature_size;
+	int n_band_rows;
+	float threshold;
+};
+
 struct MultiProc {
 	// ID of the current process
 	int my_rank;
@@ -10,27 +80,109 @@ struct MultiProc {
 	int my_n_docs;
 };
 
+// Counters of the comparison phase
+struct CompareStats {
+	// Pairs with at least one equal band key
+	unsigned long n_candidates;
+	// Candidate pairs without any band whose rows are all equal (band key collisions, only counted in verbose mode)
+	unsigned long n_collisions;
+	// Candidate pairs whose similarity is above the threshold
+	unsigned long n_similar;
+	// Results written for the duplicates of compared documents, without comparing them
+	unsigned long n_duplicates;
+};
+
+struct Kernels;
+struct DupGroups;
+struct DocPack;
+
 struct Arguments {
 	// Directory where to pull the documents from
 	char *directory;
 	// Offset of the document index to start from (default starts from 0)
 	int doc_offset;
-	// How many words in a shingle
+	// How many words (or characters) in a shingle
 	int shingle_size;
+	// Whether shingles are made of words or characters
+	enum ShingleMode shingle_mode;
+	// Hash function of the shingles
+	enum HashFamily hash;
 	// Number of hashes to compute for a document
 	int signature_size;
+	// Bits kept of each signature row for the comparison (0 = whole rows, see bbit.h)
+	int bbit;
+	// Whether repeated shingles of a document are hashed only once (0 = disabled)
+	int dedup;
+	// Whether documents with the same normalized text are hashed and compared once (0 = disabled)
+	int exact_dups;
+	// Groups of documents with the same normalized text (set before computing the signatures, see duplicates.h)
+	const struct DupGroups *dups;
 	// Number of documents to process
 	int n_docs;
 	// Number of rows in each band
 	int n_band_rows;
 	// Number of bands
 	int n_bands;
+	// How the rows of a band are combined into its key
+	enum BandKey band_key;
+	// Hot loops selected for the signature size and band rows (set after parsing, see kernels.h)
+	const struct Kernels *kernels;
 	// Hash function seed
 	int seed;
 	// After how many steps to print verbose information (0 = disabled)
 	unsigned int verbose;
 	// Minimum similarity threshold after which to print the score
 	float threshold;
+	// Backend used to read the documents
+	enum IoBackend io_backend;
+	// Number of documents loaded together by the io_uring backend
+	int io_batch;
+	// Compression of the documents, decompressed while they are read
+	enum Compression compression;
+	// File where the documents are packed, indexed by <pack>.idx (NULL = one file per document)
+	char *pack;
+	// Index of the packed corpus (opened after parsing, see doc_loader.h)
+	const struct DocPack *doc_pack;
+	// Memory available for the matrices in MB, above which they are spilled to disk (0 = all in memory)
+	int memory_limit;
+	// File where the matrices are spilled
+	char *spill_path;
+	// Directory where the progress is saved (NULL = checkpointing disabled)
+	char *checkpoint_dir;
+	// Seconds between two checkpoint saves
+	int checkpoint_interval;
+	// Whether to resume from the saved checkpoint (0 = start over)
+	int resume;
+	// Order in which the documents are hashed
+	enum Schedule schedule;
+	// File listing the size of each document (NULL = sizes read from the file system)
+	char *manifest;
+	// Number of documents buffered ahead by the reader threads (0 = prefetching disabled)
+	int prefetch_depth;
+	// Number of reader threads filling the prefetch queue
+	int n_readers;
+	// Whether matrices are first-touched in parallel and threads are pinned (0 = disabled)
+	int numa;
+	// Pages backing the matrices
+	enum HugePages hugepages;
+	// Stream where the documents are read from, as length-prefixed records ("-" = standard input, NULL = directory)
+	char *stream;
+	// Number of most recent documents a streamed document is compared with
+	int window_docs;
+	// Seconds a streamed document is compared with the next ones (0 = no time limit)
+	double window_seconds;
+	// Directory of the second corpus of a join (NULL = same directory as the first one)
+	char *join_directory;
+	// Offset of the first document of the second corpus of a join
+	int join_offset;
+	// Number of documents of the second corpus of a join (0 = join disabled)
+	int join_docs;
+	// Number of trees of the LSH Forest answering queries instead of the bands (0 = disabled)
+	int forest_trees;
+	// Configurations of a parameter sweep, as <signature>:<bandrows>:<threshold> separated by commas (NULL = disabled)
+	char *sweep;
+	// Documents sampled to estimate the run instead of running it (0 = disabled, see plan.h)
+	int plan;
 	// MultiProc information
 	struct MultiProc proc;
 };
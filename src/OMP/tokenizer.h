@@ -0,0 +1,50 @@
+#ifndef MULTICOREMINHASH_TOKENIZER_H
+#define MULTICOREMINHASH_TOKENIZER_H
+
+#include <stddef.h>
+
+/**
+ * Normalized words of a document. <br>
+ * Words are split on whitespace, lowercased and stripped of all non-alphanumeric characters
+ * (empty words are dropped), then stored in text separated by a single space.
+ * This way, a shingle of consecutive words is a substring of text and needs no allocation.
+ * The memory is reused across documents and only grows.
+ */
+struct Tokens {
+	// Normalized words, separated by a single space (not null-terminated)
+	char *text;
+	// Number of bytes in text
+	size_t text_len;
+	// Allocated bytes in text
+	size_t text_capacity;
+	// Offset in text of the first character of each word
+	int *word_starts;
+	// Offset in text after the last character of each word
+	int *word_ends;
+	// Number of words
+	int n_words;
+	// Allocated words
+	int words_capacity;
+};
+
+/**
+ * Split a document into normalized words, in a single pass over the buffer. <br>
+ * Bytes are classified (whitespace / alphanumeric / other) and lowercased 32 at a time with SIMD instructions
+ * when the CPU supports them.
+ * The words are the same produced by reading the document with fscanf("%s")
+ * and normalizing each word with tolower, keeping only [a-z0-9].
+ *
+ * @param data Content of the document
+ * @param size Number of bytes in data
+ * @param tokens Where to store the words (previous content is overwritten)
+ */
+void tokenize(const char *data, size_t size, struct Tokens *tokens);
+
+/**
+ * Free the memory used by the tokens.
+ *
+ * @param tokens The tokens
+ */
+void tokens_free(struct Tokens *tokens);
+
+#endif //MULTICOREMINHASH_TOKENIZER_H
@@ -1,4 +1,5 @@
-#include <ctype.h>
+#include <string.h>
+#include <time.h>
 
 #include "utils.h"
 
@@ -12,7 +13,9 @@ uint32_t murmur_hash(const void* key, int len, uint32_t seed) {
 	const uint32_t* end = data + (len / 4);
 
 	while(data != end) {
-		uint32_t k = *data++;
+		// Read block without alignment requirements (shingles are substrings of the document)
+		uint32_t k;
+		memcpy(&k, data++, sizeof(k));
 		k *= m;
 		k ^= k >> r;
 		k *= m;
@@ -40,26 +43,55 @@ uint32_t murmur_hash(const void* key, int len, uint32_t seed) {
 	return h;
 }
 
-void str_tolower_trim_nonalphanum(char* str) {
-	// Used variables
-	char* write_str = str;
+// Modulus (2^61 - 1) and base of the rolling hash
+#define ROLLING_MOD ((1ULL << 61) - 1)
+#define ROLLING_BASE 0x1f3d5b79a2c4e6fULL
 
-	while(*str) {
-		// Convert character to lowercase
-		const char c = (char) tolower((int) *str);
+/**
+ * Multiplies two values modulo 2^61 - 1.
+ */
+static uint64_t mul_mod61(uint64_t a, uint64_t b) {
 
-		// Include alphanumeric characters only
-		if(('a' <= c && c <= 'z') || ('0' <= c && c <= '9')) {
-			*write_str = c;
-			write_str++;
-		}
+	__uint128_t product = (__uint128_t) a * b;
+	uint64_t res = (uint64_t) (product & ROLLING_MOD) + (uint64_t) (product >> 61);
 
-		// Move to next character
-		str++;
+	return res >= ROLLING_MOD ? res - ROLLING_MOD : res;
+}
+
+uint64_t rolling_hash(const char *str, int len) {
+
+	uint64_t hash = 0;
+
+	for (int i = 0; i < len; i++) {
+		hash = mul_mod61(hash, ROLLING_BASE) + (uint8_t) str[i];
+		if (hash >= ROLLING_MOD)
+			hash -= ROLLING_MOD;
 	}
 
-	// Null-terminate the string
-	*write_str = '\0';
+	return hash;
+}
+
+uint64_t rolling_hash_factor(int len) {
+
+	uint64_t factor = 1;
+
+	// BASE^(len - 1), weight of the oldest character
+	for (int i = 1; i < len; i++)
+		factor = mul_mod61(factor, ROLLING_BASE);
+
+	return factor;
+}
+
+uint64_t rolling_hash_roll(uint64_t hash, char c_out, char c_in, uint64_t factor) {
+
+	// Remove oldest character
+	uint64_t removed = mul_mod61((uint8_t) c_out, factor);
+	hash = hash >= removed ? hash - removed : hash + ROLLING_MOD - removed;
+
+	// Shift and add newest character
+	hash = mul_mod61(hash, ROLLING_BASE) + (uint8_t) c_in;
+
+	return hash >= ROLLING_MOD ? hash - ROLLING_MOD : hash;
 }
 
 float array_similarity(const uint32_t *p_hashes1, const int n_hashes1,
@@ -86,7 +118,7 @@ float signature_similarity(const uint32_t *p_signature1, const uint32_t *p_signa
 	return (float) common / (float) signature_size;
 }
 
-bool is_candidate_pair(const uint32_t *p_bands1, const uint32_t *p_bands2, const int n_bands) {
+bool is_candidate_pair(const uint64_t *p_bands1, const uint64_t *p_bands2, const int n_bands) {
 
 	for (int i = 0; i < n_bands; i++)
 		if (p_bands1[i] == p_bands2[i])
@@ -94,3 +126,22 @@ bool is_candidate_pair(const uint32_t *p_bands1, const uint32_t *p_bands2, const
 
 	return false;
 }
+
+bool has_equal_band(const uint32_t *p_signature1, const uint32_t *p_signature2, const int n_bands,
+					const int n_band_rows) {
+
+	for (int j = 0; j < n_bands; ++j)
+		if (memcmp(p_signature1 + j * n_band_rows, p_signature2 + j * n_band_rows,
+				   n_band_rows * sizeof(uint32_t)) == 0)
+			return true;
+
+	return false;
+}
+
+double wall_time() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
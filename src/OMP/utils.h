@@ -5,7 +5,7 @@
 #include <stdbool.h>
 
 /**
- * MurmurHash3 implementation, credit to Austin Appleby.
+ * MurmurHash2 implementation, credit to Austin Appleby.
  *
  * @param key Array containing data to hash
  * @param len Size of the array
@@ -15,12 +15,102 @@
 uint32_t murmur_hash(const void *key, int len, uint32_t seed);
 
 /**
- * Converts a string to lowercase and removes non-alphanumeric characters.
- * The string is modified directly, without reallocating memory.
- * 
- * @param str String to convert
+ * Computes the Rabin-Karp fingerprint of a string, modulo the Mersenne prime 2^61 - 1.
+ *
+ * @param str String to hash
+ * @param len Length of the string
+ * @return The fingerprint
+ */
+uint64_t rolling_hash(const char *str, int len);
+
+/**
+ * Computes the factor used to remove the oldest character from a window of the given length.
+ *
+ * @param len Length of the window
+ * @return The factor to pass to rolling_hash_roll
  */
-void str_tolower_trim_nonalphanum(char *str);
+uint64_t rolling_hash_factor(int len);
+
+/**
+ * Moves a Rabin-Karp fingerprint window by one character, in constant time.
+ *
+ * @param hash Fingerprint of the current window
+ * @param c_out Oldest character, leaving the window
+ * @param c_in Newest character, entering the window
+ * @param factor Value returned by rolling_hash_factor for the window length
+ * @return The fingerprint of the moved window
+ */
+uint64_t rolling_hash_roll(uint64_t hash, char c_out, char c_in, uint64_t factor);
+
+/**
+ * Computes the key of a band by XOR-ing its rows. <br>
+ * Note: the row order is ignored, and keys only have 32 significant bits. <br>
+ * Defined here so that it can be inlined into the band kernels.
+ *
+ * @param p_rows Rows of the band
+ * @param n_rows Number of rows
+ * @return The band key
+ */
+static inline uint64_t band_key_xor(const uint32_t *p_rows, const int n_rows) {
+
+	uint32_t key = 0;
+
+	for (int k = 0; k < n_rows; ++k)
+		key ^= p_rows[k];
+
+	return key;
+}
+
+/**
+ * Computes the key of a band by mixing its rows, two at a time, into a 64-bit hash
+ * (MurmurHash3 body and finalizer). The key depends on the row order.
+ *
+ * @param p_rows Rows of the band
+ * @param n_rows Number of rows
+ * @return The band key
+ */
+static inline uint64_t band_key_mix64(const uint32_t *p_rows, const int n_rows) {
+
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	int k;
+
+	// Body: two rows (one 64-bit block) at a time
+	for (k = 0; k + 1 < n_rows; k += 2) {
+		uint64_t block = (uint64_t) p_rows[k] | (uint64_t) p_rows[k + 1] << 32;
+
+		block *= c1;
+		block = (block << 31) | (block >> 33);
+		block *= c2;
+
+		h ^= block;
+		h = (h << 27) | (h >> 37);
+		h = h * 5 + 0x52dce729;
+	}
+
+	// Tail: last row, if odd
+	if (k < n_rows) {
+		uint64_t block = p_rows[k];
+
+		block *= c1;
+		block = (block << 31) | (block >> 33);
+		block *= c2;
+
+		h ^= block;
+	}
+
+	// Finalization: mix the number of rows in and avalanche
+	h ^= (uint64_t) n_rows;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
 
 /**
  * Computes the set (Jaccard) similarity of two arrays containing hash values.
@@ -55,6 +145,26 @@ float signature_similarity(const uint32_t *p_signature1, const uint32_t *p_signa
  *
  * @return True if the bands are candidate pairs, false otherwise
  */
-bool is_candidate_pair(const uint32_t *p_bands1, const uint32_t *p_bands2, const int n_bands);
+bool is_candidate_pair(const uint64_t *p_bands1, const uint64_t *p_bands2, const int n_bands);
+
+/**
+ * Checks whether two signatures have at least a band whose rows are all equal
+ * (i.e., whether an equal band key is not a collision).
+ *
+ * @param p_signature1 Address of the first signature array
+ * @param p_signature2 Address of the second signature array
+ * @param n_bands Number of bands
+ * @param n_band_rows Number of rows in each band
+ * @return True if a band is equal, false otherwise
+ */
+bool has_equal_band(const uint32_t *p_signature1, const uint32_t *p_signature2, const int n_bands,
+					const int n_band_rows);
+
+/**
+ * Returns the current time of a monotonic clock, used to measure elapsed time.
+ *
+ * @return The current time in seconds
+ */
+double wall_time();
 
 #endif //MULTICOREMINHASH_UTILS_H
@@ -0,0 +1,126 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bbit.h"
+#include "kernels.h"
+#include "utils.h"
+
+// Signatures compared by the timing (all pairs), and their size
+#define N_DOCS 1000
+#define SIGNATURE_SIZE 300
+
+// Signature pairs of the quality test, for each similarity
+#define QUALITY_PAIRS 2000
+
+/**
+ * Benchmark of the b-bit signatures (see bbit.h). <br>
+ * Timing: all pairs of random signatures are compared with the full rows and with the packed rows of every width,
+ * reporting the bytes of a signature and the time of a comparison. <br>
+ * Quality: signature pairs whose rows are equal with a given probability are packed and compared;
+ * the estimate should stay unbiased, with an RMSE growing as fewer bits are kept.
+ */
+
+static const int widths[] = {0, 8, 4, 2, 1};
+
+/**
+ * Random row, with all 32 bits set at random.
+ */
+static uint32_t random_row(void) {
+	return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+/**
+ * Mean error and RMSE of the estimate for signature pairs whose rows are equal with probability similarity.
+ */
+static void estimate_error(int bbit, double similarity, double *p_bias, double *p_rmse) {
+
+	uint32_t signatures[2 * SIGNATURE_SIZE];
+	double sum = 0, sum_squares = 0;
+
+	for (int p = 0; p < QUALITY_PAIRS; ++p) {
+
+		int n_equal = 0;
+
+		for (int r = 0; r < SIGNATURE_SIZE; ++r) {
+			signatures[r] = random_row();
+			const int equal = rand() < similarity * RAND_MAX;
+			signatures[SIGNATURE_SIZE + r] = equal ? signatures[r] : random_row();
+			n_equal += signatures[SIGNATURE_SIZE + r] == signatures[r];
+		}
+
+		// Error against the similarity of the full rows (the one of the usual comparison)
+		const double exact = (double) n_equal / SIGNATURE_SIZE;
+		bbit_pack(signatures, 2, SIGNATURE_SIZE, bbit);
+
+		const double error = bbit_similarity(signatures, signatures + bbit_words(SIGNATURE_SIZE, bbit),
+											 SIGNATURE_SIZE, bbit) - exact;
+		sum += error;
+		sum_squares += error * error;
+	}
+
+	*p_bias = sum / QUALITY_PAIRS;
+	*p_rmse = sqrt(sum_squares / QUALITY_PAIRS);
+}
+
+int main(int argc, const char *argv[]) {
+
+	// Number of repetitions of each measure
+	const int repeat = argc > 1 ? atoi(argv[1]) : 3;
+
+	const struct Kernels *kernels = kernels_select(SIGNATURE_SIZE, 3, BANDKEY_XOR, HASH_MURMUR2);
+	uint32_t *p_full = malloc((size_t) N_DOCS * SIGNATURE_SIZE * sizeof(uint32_t));
+	uint32_t *p_packed = malloc((size_t) N_DOCS * SIGNATURE_SIZE * sizeof(uint32_t));
+
+	// Half of the rows of each signature come from a small range, so that pairs share some of them
+	srand(13);
+	for (size_t k = 0; k < (size_t) N_DOCS * SIGNATURE_SIZE; ++k)
+		p_full[k] = (k % 2) ? random_row() : (uint32_t) (rand() % 4);
+
+	printf("%-8s %12s %14s\n", "bits", "bytes/sig", "ns/compare");
+
+	double checksum = 0;
+
+	for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+
+		const int bbit = widths[w];
+		const int n_words = bbit_words(SIGNATURE_SIZE, bbit);
+
+		memcpy(p_packed, p_full, (size_t) N_DOCS * SIGNATURE_SIZE * sizeof(uint32_t));
+		if (bbit)
+			bbit_pack(p_packed, N_DOCS, SIGNATURE_SIZE, bbit);
+
+		const double start = wall_time();
+
+		for (int r = 0; r < repeat; ++r)
+			for (int i = 0; i < N_DOCS; ++i)
+				for (int j = i + 1; j < N_DOCS; ++j) {
+					const uint32_t *p_signature1 = p_packed + (size_t) i * n_words;
+					const uint32_t *p_signature2 = p_packed + (size_t) j * n_words;
+					checksum += bbit ? bbit_similarity(p_signature1, p_signature2, SIGNATURE_SIZE, bbit)
+									 : kernels->signature_similarity(p_signature1, p_signature2, SIGNATURE_SIZE);
+				}
+
+		const double ns = (wall_time() - start) * 1e9 / ((double) repeat * N_DOCS * (N_DOCS - 1) / 2);
+
+		printf("%-8d %12zu %14.2f\n", bbit ? bbit : 32, n_words * sizeof(uint32_t), ns);
+	}
+
+	printf("\n%-8s %12s %12s %12s\n", "bits", "similarity", "bias", "rmse");
+
+	for (size_t w = 1; w < sizeof(widths) / sizeof(widths[0]); ++w)
+		for (int s = 1; s <= 9; s += 4) {
+
+			double bias, rmse;
+			estimate_error(widths[w], s / 10.0, &bias, &rmse);
+			printf("%-8d %12.1f %12.4f %12.4f\n", widths[w], s / 10.0, bias, rmse);
+		}
+
+	printf("\nChecksum: %.1f\n", checksum);
+
+	free(p_full);
+	free(p_packed);
+
+	return 0;
+}
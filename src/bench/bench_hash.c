@@ -0,0 +1,170 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "kernels.h"
+#include "utils.h"
+
+// Number of keys hashed for each length, and of shingles in a signature update
+#define N_KEYS 100000
+#define N_SHINGLES 20000
+
+// Signature size and number of set pairs of the quality test, for each Jaccard similarity
+#define QUALITY_SIGNATURE 128
+#define QUALITY_PAIRS 200
+#define QUALITY_UNION 400
+
+/**
+ * Benchmark of the shingle hash families (see hash.h). <br>
+ * Throughput: hashes per second and GB/s for keys of shingle-like lengths, then the time of a signature update
+ * with the kernels of each family. CRC32C is timed both with SSE4.2 and with the lookup table. <br>
+ * Quality: the similarity of signature pairs is compared with the exact Jaccard similarity of synthetic shingle
+ * sets; the RMSE of the estimate should stay close to sqrt(J (1 - J) / k) for k hashes.
+ */
+
+/**
+ * Same as hash_crc32c, with the lookup table.
+ */
+static uint32_t hash_crc32c_software(const void *key, int len, uint32_t seed) {
+
+	uint32_t h = crc32c_software(seed, key, len);
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	return h ^ (h >> 16);
+}
+
+/**
+ * Hash functions timed, in the order of enum HashFamily, then the software CRC32C.
+ */
+static const char *hash_names[] = {"murmur2", "xxh3", "crc32c", "crc32c (table)"};
+static hash_fn hash_fns[4];
+
+static const int key_lens[] = {8, 24, 64};
+
+/**
+ * Writes the shingle of an element: three words, as the default shingles of the documents.
+ */
+static int element_shingle(char *p_shingle, int element) {
+	return sprintf(p_shingle, "word%d word%d word%d", element, element + 1, element + 2);
+}
+
+/**
+ * Root mean square error of the similarity estimate for set pairs of Jaccard similarity overlap / QUALITY_UNION.
+ */
+static double estimate_rmse(const struct Kernels *kernels, int overlap) {
+
+	const int only = (QUALITY_UNION - overlap) / 2;
+	const double jaccard = (double) overlap / (overlap + 2 * only);
+	uint32_t signature1[QUALITY_SIGNATURE], signature2[QUALITY_SIGNATURE];
+	char shingle[64];
+	double sum_squares = 0;
+
+	for (int p = 0; p < QUALITY_PAIRS; ++p) {
+
+		memset(signature1, 0xff, sizeof(signature1));
+		memset(signature2, 0xff, sizeof(signature2));
+
+		// Elements of a pair: shared ones, then the ones of each set (a new range for every pair)
+		const int first = p * QUALITY_UNION * 4;
+
+		for (int e = 0; e < overlap + 2 * only; ++e) {
+
+			const int len = element_shingle(shingle, first + e * 3);
+
+			if (e < overlap + only)
+				kernels->signature_update(signature1, QUALITY_SIGNATURE, shingle, len, 13);
+			if (e < overlap || e >= overlap + only)
+				kernels->signature_update(signature2, QUALITY_SIGNATURE, shingle, len, 13);
+		}
+
+		const double error = kernels->signature_similarity(signature1, signature2, QUALITY_SIGNATURE) - jaccard;
+		sum_squares += error * error;
+	}
+
+	return sqrt(sum_squares / QUALITY_PAIRS);
+}
+
+int main(int argc, const char *argv[]) {
+
+	// Number of repetitions of each measure
+	const int repeat = argc > 1 ? atoi(argv[1]) : 5;
+
+	hash_fns[0] = hash_select(HASH_MURMUR2);
+	hash_fns[1] = hash_select(HASH_XXH3);
+	hash_fns[2] = hash_select(HASH_CRC32C);
+	hash_fns[3] = hash_crc32c_software;
+
+	// Random keys, one every 64 bytes
+	srand(13);
+	char *p_keys = malloc((size_t) N_KEYS * 64);
+
+	for (size_t k = 0; k < (size_t) N_KEYS * 64; ++k)
+		p_keys[k] = (char) ('a' + rand() % 26);
+
+	printf("%-16s %8s %12s %12s %12s\n", "hash", "len", "ns/hash", "Mhash/s", "GB/s");
+
+	uint32_t checksum = 0;
+
+	for (int h = 0; h < 4; ++h)
+		for (size_t l = 0; l < sizeof(key_lens) / sizeof(key_lens[0]); ++l) {
+
+			const int len = key_lens[l];
+			const double start = wall_time();
+
+			for (int r = 0; r < repeat; ++r)
+				for (int k = 0; k < N_KEYS; ++k)
+					checksum ^= hash_fns[h](p_keys + (size_t) k * 64, len, (uint32_t) k);
+
+			const double seconds = wall_time() - start;
+			const double n_hashes = (double) repeat * N_KEYS;
+
+			printf("%-16s %8d %12.2f %12.1f %12.2f\n", hash_names[h], len, seconds * 1e9 / n_hashes,
+				   n_hashes / seconds / 1e6, n_hashes * len / seconds / 1e9);
+		}
+
+	// Signature update of the default configuration, with the kernels selected for each family
+	printf("\n%-24s %16s %16s\n", "kernels", "update (ns)", "ns/hash");
+
+	for (int family = HASH_MURMUR2; family <= HASH_CRC32C; ++family) {
+
+		const struct Kernels *kernels = kernels_select(300, 3, BANDKEY_XOR, family);
+		uint32_t signature[300];
+		const double start = wall_time();
+
+		for (int r = 0; r < repeat; ++r) {
+			memset(signature, 0xff, sizeof(signature));
+			for (int s = 0; s < N_SHINGLES; ++s)
+				kernels->signature_update(signature, 300, p_keys + (size_t) s * 64, 8 + s % 33, 13);
+		}
+
+		const double update_ns = (wall_time() - start) * 1e9 / ((double) repeat * N_SHINGLES);
+		checksum ^= signature[0];
+
+		printf("%-24s %16.1f %16.2f\n", kernels->name, update_ns, update_ns / 300);
+	}
+
+	free(p_keys);
+
+	// Estimate quality, with the generic kernels of each family
+	const int overlaps[] = {40, 200, 360};
+
+	printf("\n%-16s %8s %12s %12s\n", "hash", "jaccard", "RMSE", "expected");
+
+	for (int family = HASH_MURMUR2; family <= HASH_CRC32C; ++family)
+		for (size_t o = 0; o < sizeof(overlaps) / sizeof(overlaps[0]); ++o) {
+
+			const double jaccard = (double) overlaps[o] / QUALITY_UNION;
+
+			printf("%-16s %8.2f %12.4f %12.4f\n", hash_names[family], jaccard,
+				   estimate_rmse(kernels_generic(BANDKEY_XOR, family), overlaps[o]),
+				   sqrt(jaccard * (1 - jaccard) / QUALITY_SIGNATURE));
+		}
+
+	// Keeps the hashes from being optimized out
+	return checksum == 0x5eed ? 2 : 0;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "utils.h"
+
+// Number of random shingles hashed, and of signatures compared
+#define N_SHINGLES 20000
+#define N_SIGNATURES 2000
+
+/**
+ * Benchmark of the specialized kernels against the generic ones, for every specialized configuration. <br>
+ * Each kernel runs on the same random data with both variants, results are checked to be equal,
+ * and the time per call is printed along with the speedup. <br>
+ * Candidate pairs are checked both one pair at a time ("cand.") and one document against blocks of band-major
+ * documents ("block"), both times are per pair.
+ */
+
+/**
+ * Configurations with specialized kernels (see kernels.c).
+ */
+static const int configurations[][2] = {{100, 4}, {100, 5}, {200, 4}, {200, 5}, {300, 3}, {300, 4}, {300, 5}};
+
+/**
+ * Random data shared by the kernels.
+ */
+struct BenchData {
+	// Shingles of 8 to 40 bytes
+	char *p_text;
+	int *p_starts;
+	int *p_lens;
+	// Signatures, with rows often equal to the ones of the previous signature
+	uint32_t *p_signatures;
+	uint64_t *p_bands;
+};
+
+/**
+ * Time per call (ns) of each kernel, and checksum of the results.
+ */
+struct BenchResult {
+	double update_ns;
+	double bands_ns;
+	double candidate_ns;
+	double block_ns;
+	double similarity_ns;
+	uint64_t checksum;
+};
+
+static void bench_data_init(struct BenchData *data, int signature_size, int n_bands) {
+
+	srand(13);
+
+	data->p_text = malloc(N_SHINGLES * 40);
+	data->p_starts = malloc(N_SHINGLES * sizeof(int));
+	data->p_lens = malloc(N_SHINGLES * sizeof(int));
+
+	for (int s = 0; s < N_SHINGLES * 40; ++s)
+		data->p_text[s] = (char) ('a' + rand() % 26);
+
+	for (int s = 0; s < N_SHINGLES; ++s) {
+		data->p_starts[s] = s * 40;
+		data->p_lens[s] = 8 + rand() % 33;
+	}
+
+	data->p_signatures = malloc((size_t) N_SIGNATURES * signature_size * sizeof(uint32_t));
+	data->p_bands = malloc((size_t) N_SIGNATURES * n_bands * sizeof(uint64_t));
+
+	for (int d = 0; d < N_SIGNATURES; ++d)
+		for (int i = 0; i < signature_size; ++i) {
+			uint32_t *p_value = data->p_signatures + (size_t) d * signature_size + i;
+			*p_value = (d > 0 && rand() % 4 == 0) ? p_value[-signature_size] : (uint32_t) rand() % 64;
+		}
+
+}
+
+static void bench_data_free(struct BenchData *data) {
+
+	free(data->p_text);
+	free(data->p_starts);
+	free(data->p_lens);
+	free(data->p_signatures);
+	free(data->p_bands);
+
+}
+
+static struct BenchResult bench_kernels(const struct Kernels *kernels, struct BenchData *data, int signature_size,
+										int n_band_rows, int n_bands, int repeat) {
+
+	struct BenchResult result = {0, 0, 0, 0, 0, 0};
+	uint32_t signature[signature_size];
+	double start;
+
+	// Signature update: hash every shingle into one signature
+	start = wall_time();
+	for (int r = 0; r < repeat; ++r) {
+		memset(signature, 0xff, sizeof(signature));
+		for (int s = 0; s < N_SHINGLES; ++s)
+			kernels->signature_update(signature, signature_size, data->p_text + data->p_starts[s], data->p_lens[s], 13);
+	}
+	result.update_ns = (wall_time() - start) * 1e9 / ((double) repeat * N_SHINGLES);
+
+	for (int i = 0; i < signature_size; ++i)
+		result.checksum = result.checksum * 31 + signature[i];
+
+	// Bands of every signature
+	start = wall_time();
+	for (int r = 0; r < repeat; ++r)
+		for (int d = 0; d < N_SIGNATURES; ++d)
+			kernels->compute_bands(data->p_signatures + (size_t) d * signature_size,
+								   data->p_bands + (size_t) d * n_bands, n_band_rows, n_bands);
+	result.bands_ns = (wall_time() - start) * 1e9 / ((double) repeat * N_SIGNATURES);
+
+	for (size_t k = 0; k < (size_t) N_SIGNATURES * n_bands; ++k)
+		result.checksum = result.checksum * 31 + data->p_bands[k];
+
+	// Candidate pairs and similarities among the first documents
+	const int n_docs = 200;
+	uint64_t n_candidates = 0;
+	double sum_similarity = 0;
+
+	start = wall_time();
+	for (int r = 0; r < repeat; ++r)
+		for (int i = 0; i < n_docs; ++i)
+			for (int j = i + 1; j < n_docs; ++j)
+				n_candidates += kernels->is_candidate_pair(data->p_bands + (size_t) i * n_bands,
+														   data->p_bands + (size_t) j * n_bands, n_bands);
+	result.candidate_ns = (wall_time() - start) * 1e9 / ((double) repeat * n_docs * (n_docs - 1) / 2);
+
+	// Same pairs, checking a document against blocks of band-major documents
+	uint64_t *p_bands_t = kernels_band_major(data->p_bands, n_docs, n_bands);
+	uint64_t n_block_candidates = 0;
+
+	start = wall_time();
+	for (int r = 0; r < repeat; ++r)
+		for (int i = 0; i < n_docs; ++i)
+			for (int block = (i + 1) - (i + 1) % KERNELS_BLOCK_DOCS; block < n_docs; block += KERNELS_BLOCK_DOCS)
+				n_block_candidates += __builtin_popcount(
+						kernels->candidate_mask(data->p_bands + (size_t) i * n_bands, p_bands_t + (size_t) block * n_bands,
+												n_bands)
+						& kernels_block_lanes(block, i + 1, n_docs));
+	result.block_ns = (wall_time() - start) * 1e9 / ((double) repeat * n_docs * (n_docs - 1) / 2);
+
+	free(p_bands_t);
+
+	// Both checks must find the same pairs
+	if (n_block_candidates != n_candidates)
+		result.checksum = 0;
+
+	start = wall_time();
+	for (int r = 0; r < repeat; ++r)
+		for (int i = 0; i < n_docs; ++i)
+			for (int j = i + 1; j < n_docs; ++j)
+				sum_similarity += kernels->signature_similarity(data->p_signatures + (size_t) i * signature_size,
+																data->p_signatures + (size_t) j * signature_size,
+																signature_size);
+	result.similarity_ns = (wall_time() - start) * 1e9 / ((double) repeat * n_docs * (n_docs - 1) / 2);
+
+	result.checksum = result.checksum ? result.checksum * 31 + n_candidates : 0;
+	result.checksum = result.checksum * 31 + (uint64_t) (sum_similarity * 1e4);
+
+	return result;
+}
+
+int main(int argc, const char *argv[]) {
+
+	// Number of repetitions of each measure
+	const int repeat = argc > 1 ? atoi(argv[1]) : 5;
+
+	printf("%-16s %-10s %12s %12s %12s %12s %12s\n", "variant", "", "update (ns)", "bands (ns)", "cand. (ns)",
+		   "block (ns)", "sim. (ns)");
+
+	int status = 0;
+
+	for (size_t c = 0; c < sizeof(configurations) / sizeof(configurations[0]); ++c) {
+
+		const int signature_size = configurations[c][0];
+		const int n_band_rows = configurations[c][1];
+		const int n_bands = signature_size / n_band_rows;
+
+		for (int band_key = BANDKEY_XOR; band_key <= BANDKEY_MIX64; ++band_key) {
+
+			const struct Kernels *generic = kernels_generic(band_key, HASH_MURMUR2);
+			const struct Kernels *specialized = kernels_select(signature_size, n_band_rows, band_key, HASH_MURMUR2);
+
+			struct BenchData data;
+			bench_data_init(&data, signature_size, n_bands);
+
+			struct BenchResult r_generic = bench_kernels(generic, &data, signature_size, n_band_rows, n_bands, repeat);
+			struct BenchResult r_special = bench_kernels(specialized, &data, signature_size, n_band_rows, n_bands,
+														 repeat);
+
+			bench_data_free(&data);
+
+			const char *key_name = band_key == BANDKEY_XOR ? "xor" : "mix64";
+
+			printf("%-16s %-10s %12.1f %12.1f %12.2f %12.2f %12.2f\n", generic->name, key_name, r_generic.update_ns,
+				   r_generic.bands_ns, r_generic.candidate_ns, r_generic.block_ns, r_generic.similarity_ns);
+			printf("%-16s %-10s %12.1f %12.1f %12.2f %12.2f %12.2f\n", specialized->name, key_name, r_special.update_ns,
+				   r_special.bands_ns, r_special.candidate_ns, r_special.block_ns, r_special.similarity_ns);
+			printf("%-16s %-10s %11.2fx %11.2fx %11.2fx %11.2fx %11.2fx%s\n", "speedup", "",
+				   r_generic.update_ns / r_special.update_ns, r_generic.bands_ns / r_special.bands_ns,
+				   r_generic.candidate_ns / r_special.candidate_ns, r_generic.block_ns / r_special.block_ns,
+				   r_generic.similarity_ns / r_special.similarity_ns,
+				   r_generic.checksum == r_special.checksum && r_special.checksum ? "" : "  RESULTS DIFFER");
+
+			if (r_generic.checksum != r_special.checksum || !r_special.checksum)
+				status = 1;
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,88 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+/**
+ * Order latencies increasingly.
+ */
+static int latency_cmp(const void *p_a, const void *p_b);
+
+/**
+ * Returns the given percentile of sorted latencies (nearest rank).
+ */
+static double percentile(const float *p_sorted, int n, double p);
+
+void latency_init(struct LatencyRecorder *recorder) {
+
+	recorder->n_recorded = 0;
+	pthread_mutex_init(&recorder->lock, NULL);
+
+}
+
+void latency_record(struct LatencyRecorder *recorder, double latency) {
+
+	pthread_mutex_lock(&recorder->lock);
+
+	recorder->p_window[recorder->n_recorded % LATENCY_WINDOW] = (float) latency;
+	recorder->n_recorded++;
+
+	pthread_mutex_unlock(&recorder->lock);
+
+}
+
+void latency_summary(struct LatencyRecorder *recorder, struct LatencySummary *summary) {
+
+	memset(summary, 0, sizeof(struct LatencySummary));
+
+	float *p_sorted = malloc(LATENCY_WINDOW * sizeof(float));
+
+	// Sort a copy, so that requests are not blocked meanwhile
+	pthread_mutex_lock(&recorder->lock);
+
+	const uint64_t n_recorded = recorder->n_recorded;
+	const int n = n_recorded < LATENCY_WINDOW ? (int) n_recorded : LATENCY_WINDOW;
+	memcpy(p_sorted, recorder->p_window, n * sizeof(float));
+
+	pthread_mutex_unlock(&recorder->lock);
+
+	summary->n_requests = n_recorded;
+
+	if (n > 0) {
+		qsort(p_sorted, n, sizeof(float), latency_cmp);
+
+		summary->p50 = percentile(p_sorted, n, 50);
+		summary->p90 = percentile(p_sorted, n, 90);
+		summary->p99 = percentile(p_sorted, n, 99);
+		summary->p999 = percentile(p_sorted, n, 99.9);
+		summary->max = p_sorted[n - 1];
+	}
+
+	free(p_sorted);
+
+}
+
+void latency_destroy(struct LatencyRecorder *recorder) {
+	pthread_mutex_destroy(&recorder->lock);
+}
+
+static int latency_cmp(const void *p_a, const void *p_b) {
+
+	const float a = *(const float *) p_a;
+	const float b = *(const float *) p_b;
+
+	return (a > b) - (a < b);
+}
+
+static double percentile(const float *p_sorted, int n, double p) {
+
+	int rank = (int) ceil(p / 100 * n);
+
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+
+	return p_sorted[rank - 1];
+}
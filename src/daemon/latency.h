@@ -0,0 +1,63 @@
+#ifndef MULTICOREMINHASH_LATENCY_H
+#define MULTICOREMINHASH_LATENCY_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Number of most recent requests the percentiles are computed on
+#define LATENCY_WINDOW 65536
+
+/**
+ * Latencies of the most recent requests, in a ring buffer. Thread-safe.
+ */
+struct LatencyRecorder {
+	// Latencies in microseconds
+	float p_window[LATENCY_WINDOW];
+	// Total number of recorded requests
+	uint64_t n_recorded;
+	pthread_mutex_t lock;
+};
+
+/**
+ * Percentiles of the recorded latencies, in microseconds.
+ */
+struct LatencySummary {
+	uint64_t n_requests;
+	double p50;
+	double p90;
+	double p99;
+	double p999;
+	double max;
+};
+
+/**
+ * Initialize an empty recorder.
+ *
+ * @param recorder The recorder
+ */
+void latency_init(struct LatencyRecorder *recorder);
+
+/**
+ * Record the latency of a request.
+ *
+ * @param recorder The recorder
+ * @param latency Latency in microseconds
+ */
+void latency_record(struct LatencyRecorder *recorder, double latency);
+
+/**
+ * Compute the percentiles over the recorded window (all zeros if nothing was recorded).
+ *
+ * @param recorder The recorder
+ * @param summary Where to store the percentiles
+ */
+void latency_summary(struct LatencyRecorder *recorder, struct LatencySummary *summary);
+
+/**
+ * Free the recorder resources.
+ *
+ * @param recorder The recorder
+ */
+void latency_destroy(struct LatencyRecorder *recorder);
+
+#endif //MULTICOREMINHASH_LATENCY_H
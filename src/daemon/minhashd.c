@@ -0,0 +1,624 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "libminhash.h"
+#include "latency.h"
+#include "protocol.h"
+
+/**
+ * Daemon's arguments.
+ */
+struct DaemonArguments {
+	// Documents the index is built from (when there is no index file to load)
+	char *directory;
+	int doc_offset;
+	int n_docs;
+	// Index parameters
+	struct MinHashParams params;
+	// Similarity threshold of requests that don't give one
+	float threshold;
+	// Index file: loaded at start if it exists, otherwise written once built (and at shutdown)
+	char *index_path;
+	// Path of the Unix socket to listen on
+	char *socket_path;
+	// Number of threads building the index
+	int n_threads;
+	// Whether to print progress and stats
+	int verbose;
+};
+
+/**
+ * State shared by the connections.
+ */
+struct Daemon {
+	struct DaemonArguments args;
+	struct MinHashIndex *index;
+	// Queries take it for reading, inserts for writing
+	pthread_rwlock_t index_lock;
+	struct LatencyRecorder latency;
+};
+
+/**
+ * Work of a thread building the index.
+ */
+struct BuildWork {
+	struct Daemon *daemon;
+	int thread;
+	int error;
+};
+
+/**
+ * Matches of a request, filled by the query callback.
+ */
+struct MatchList {
+	struct DaemonMatch *p_matches;
+	uint32_t n_matches;
+	uint32_t capacity;
+};
+
+/**
+ * A client connection.
+ */
+struct Connection {
+	struct Daemon *daemon;
+	int fd;
+};
+
+// Set by SIGINT and SIGTERM
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * Parse the command line arguments.
+ */
+static struct DaemonArguments daemon_arguments(int argc, const char *argv[]);
+
+/**
+ * Load the index file, or build the index from the documents directory.
+ */
+static void daemon_open_index(struct Daemon *daemon);
+
+/**
+ * Thread adding every n_threads-th document of the directory to the index.
+ */
+static void *build_thread(void *p_work);
+
+/**
+ * Thread serving the requests of a connection until the client closes it.
+ */
+static void *connection_thread(void *p_connection);
+
+/**
+ * Serve one request. Returns false if the connection must be closed.
+ */
+static bool serve_request(struct Daemon *daemon, int fd, struct MatchList *matches, char **p_buffer,
+						  size_t *p_buffer_size);
+
+/**
+ * Query callback appending a match to a MatchList.
+ */
+static int collect_match(int64_t doc1, int64_t doc2, float similarity, void *p_matches);
+
+/**
+ * Read or write exactly size bytes. Return false on error or end of file.
+ */
+static bool read_full(int fd, void *p_data, size_t size);
+static bool write_full(int fd, const void *p_data, size_t size);
+
+/**
+ * Read a whole file into a buffer (reallocated if too small). Returns the file size, or -1 on error.
+ */
+static long read_file(const char *path, char **p_buffer, size_t *p_buffer_size);
+
+/**
+ * Returns a monotonic time in microseconds.
+ */
+static double now_us();
+
+static void on_stop_signal(int signal) {
+	(void) signal;
+	stop_requested = 1;
+}
+
+int main(int argc, const char *argv[]) {
+
+	struct Daemon daemon;
+	daemon.args = daemon_arguments(argc, argv);
+	pthread_rwlock_init(&daemon.index_lock, NULL);
+	latency_init(&daemon.latency);
+
+	daemon_open_index(&daemon);
+
+	// Listen on the socket, replacing a stale one
+	int fd_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if (fd_listen < 0 || strlen(daemon.args.socket_path) >= sizeof(address.sun_path)) {
+		printf("Error creating socket %s\n", daemon.args.socket_path);
+		exit(2);
+	}
+
+	strcpy(address.sun_path, daemon.args.socket_path);
+	unlink(daemon.args.socket_path);
+
+	if (bind(fd_listen, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd_listen, 64) != 0) {
+		printf("Error listening on socket %s\n", daemon.args.socket_path);
+		exit(2);
+	}
+
+	// Stop signals interrupt accept (no SA_RESTART), broken connections are handled by write errors
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_stop_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (daemon.args.verbose)
+		printf("Listening on %s with %zu documents\n", daemon.args.socket_path, mh_index_size(daemon.index));
+	fflush(stdout);
+
+	while (!stop_requested) {
+
+		int fd = accept(fd_listen, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno != EINTR)
+				printf("Error accepting connection: %s\n", strerror(errno));
+			continue;
+		}
+
+		// One thread per connection, requests of a connection are served in order
+		struct Connection *connection = malloc(sizeof(struct Connection));
+		connection->daemon = &daemon;
+		connection->fd = fd;
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, connection_thread, connection) != 0) {
+			close(fd);
+			free(connection);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+
+	close(fd_listen);
+	unlink(daemon.args.socket_path);
+
+	// Wait for the running inserts, and keep the inserted documents
+	pthread_rwlock_wrlock(&daemon.index_lock);
+
+	if (daemon.args.index_path) {
+		int error = mh_index_save(daemon.index, daemon.args.index_path);
+		if (error != MH_OK)
+			printf("Error saving index %s: %s\n", daemon.args.index_path, mh_strerror(error));
+	}
+
+	struct LatencySummary summary;
+	latency_summary(&daemon.latency, &summary);
+
+	if (daemon.args.verbose)
+		printf("Served %lu requests, latency (us): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+			   (unsigned long) summary.n_requests, summary.p50, summary.p90, summary.p99, summary.p999, summary.max);
+
+	// Connection threads may still be blocked on their sockets, so the index is not destroyed
+	return 0;
+}
+
+static struct DaemonArguments daemon_arguments(int argc, const char *argv[]) {
+
+	struct DaemonArguments args;
+	args.directory = NULL;
+	args.doc_offset = 0;
+	args.n_docs = 0;
+	mh_params_default(&args.params);
+	args.threshold = .1f;
+	args.index_path = NULL;
+	args.socket_path = "minhashd.sock";
+	args.n_threads = 1;
+	args.verbose = 1;
+
+	const char *help_msg = "Usage: %s "
+						   "[-n <n_threads>] "
+						   "[--offset <doc_offset>] "
+						   "[--docs <n_docs>] "
+						   "[--shingle <shingle_size>] "
+						   "[--shingle-mode words|chars] "
+						   "[--signature <signature_size>] "
+						   "[--dedup <0|1>] "
+						   "[--bandrows <n_band_rows>] "
+						   "[--bandkey xor|mix64] "
+						   "[--seed <seed>] "
+						   "[--threshold <threshold>] "
+						   "[--index <index_file>] "
+						   "[--socket <socket_path>] "
+						   "[--verbose <0|1>] "
+						   "[<docs_directory>]\n";
+
+	int i;
+	for (i = 1; i < argc; i++)
+
+		if (strcmp(argv[i], "-n") == 0)
+			args.n_threads = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--offset") == 0)
+			args.doc_offset = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--docs") == 0)
+			args.n_docs = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--shingle") == 0)
+			args.params.shingle_size = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--shingle-mode") == 0) {
+			i++;
+			if (strcmp(argv[i], "words") == 0)
+				args.params.shingle_chars = 0;
+			else if (strcmp(argv[i], "chars") == 0)
+				args.params.shingle_chars = 1;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--signature") == 0)
+			args.params.signature_size = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--dedup") == 0)
+			args.params.dedup = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--bandrows") == 0)
+			args.params.band_rows = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--bandkey") == 0) {
+			i++;
+			if (strcmp(argv[i], "xor") == 0)
+				args.params.band_mix64 = 0;
+			else if (strcmp(argv[i], "mix64") == 0)
+				args.params.band_mix64 = 1;
+			else {
+				printf(help_msg, argv[0]);
+				exit(1);
+			}
+		}
+
+		else if (strcmp(argv[i], "--seed") == 0)
+			args.params.seed = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--threshold") == 0)
+			args.threshold = (float) atof(argv[++i]);
+
+		else if (strcmp(argv[i], "--index") == 0)
+			args.index_path = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--socket") == 0)
+			args.socket_path = (char *) argv[++i];
+
+		else if (strcmp(argv[i], "--verbose") == 0)
+			args.verbose = atoi(argv[++i]);
+
+		else if (argv[i][0] == '-') {
+			printf(help_msg, argv[0]);
+			exit(1);
+		}
+
+		else
+			args.directory = (char *) argv[i];
+
+	// Without an index file, the index is built from the documents
+	if (args.index_path == NULL && (args.directory == NULL || args.n_docs <= 0)) {
+		printf("Either an index file or a documents directory and a number of documents must be given.\n");
+		exit(1);
+	}
+
+	if (args.n_threads < 1)
+		args.n_threads = 1;
+
+	return args;
+}
+
+static void daemon_open_index(struct Daemon *daemon) {
+
+	const struct DaemonArguments *args = &daemon->args;
+	const double start = now_us();
+
+	// Load the saved index, if any
+	if (args->index_path && access(args->index_path, F_OK) == 0) {
+
+		int error = mh_index_load(args->index_path, &daemon->index);
+
+		if (error != MH_OK) {
+			printf("Error loading index %s: %s\n", args->index_path, mh_strerror(error));
+			exit(2);
+		}
+
+		if (args->verbose)
+			printf("Loaded %zu documents from %s in %.3f s\n", mh_index_size(daemon->index), args->index_path,
+				   (now_us() - start) / 1e6);
+		return;
+	}
+
+	if (args->directory == NULL || args->n_docs <= 0) {
+		printf("Index %s does not exist, and there are no documents to build it from.\n", args->index_path);
+		exit(1);
+	}
+
+	int error = mh_index_create(&args->params, &daemon->index);
+
+	if (error != MH_OK) {
+		printf("Error creating index: %s\n", mh_strerror(error));
+		exit(1);
+	}
+
+	// Threads add documents concurrently
+	pthread_t threads[args->n_threads];
+	struct BuildWork works[args->n_threads];
+
+	for (int t = 0; t < args->n_threads; ++t) {
+		works[t].daemon = daemon;
+		works[t].thread = t;
+		works[t].error = MH_OK;
+		pthread_create(&threads[t], NULL, build_thread, &works[t]);
+	}
+
+	for (int t = 0; t < args->n_threads; ++t) {
+		pthread_join(threads[t], NULL);
+		if (works[t].error != MH_OK)
+			error = works[t].error;
+	}
+
+	if (error == MH_OK)
+		error = mh_index_finalize(daemon->index);
+
+	if (error != MH_OK) {
+		printf("Error building index: %s\n", mh_strerror(error));
+		exit(2);
+	}
+
+	if (args->verbose)
+		printf("Indexed %zu documents in %.3f s\n", mh_index_size(daemon->index), (now_us() - start) / 1e6);
+
+	if (args->index_path) {
+		error = mh_index_save(daemon->index, args->index_path);
+
+		if (error != MH_OK) {
+			printf("Error saving index %s: %s\n", args->index_path, mh_strerror(error));
+			exit(2);
+		}
+	}
+
+}
+
+static void *build_thread(void *p_work) {
+
+	struct BuildWork *work = (struct BuildWork *) p_work;
+	const struct DaemonArguments *args = &work->daemon->args;
+
+	char *buffer = NULL;
+	size_t buffer_size = 0;
+	char path[strlen(args->directory) + 32];
+
+	for (int i = work->thread; i < args->n_docs && work->error == MH_OK; i += args->n_threads) {
+
+		const int doc = i + args->doc_offset;
+		snprintf(path, sizeof(path), "%s/%d.txt", args->directory, doc);
+
+		long size = read_file(path, &buffer, &buffer_size);
+
+		if (size < 0) {
+			printf("Error opening file %s\n", path);
+			exit(2);
+		}
+
+		work->error = mh_index_add(work->daemon->index, doc, buffer, size);
+	}
+
+	free(buffer);
+
+	return NULL;
+}
+
+static void *connection_thread(void *p_connection) {
+
+	struct Connection *connection = (struct Connection *) p_connection;
+
+	struct MatchList matches = {NULL, 0, 0};
+	char *buffer = NULL;
+	size_t buffer_size = 0;
+
+	while (serve_request(connection->daemon, connection->fd, &matches, &buffer, &buffer_size));
+
+	close(connection->fd);
+	free(matches.p_matches);
+	free(buffer);
+	free(connection);
+
+	return NULL;
+}
+
+static bool serve_request(struct Daemon *daemon, int fd, struct MatchList *matches, char **p_buffer,
+						  size_t *p_buffer_size) {
+
+	struct DaemonRequest request;
+
+	if (!read_full(fd, &request, sizeof(request)))
+		return false;
+
+	// Not a client of this protocol, or out of sync
+	if (request.magic != DAEMON_MAGIC || request.size > DAEMON_MAX_DOC_SIZE)
+		return false;
+
+	if (*p_buffer_size < request.size + 1) {
+		*p_buffer_size = request.size + 1;
+		*p_buffer = realloc(*p_buffer, *p_buffer_size);
+	}
+
+	if (!read_full(fd, *p_buffer, request.size))
+		return false;
+
+	// Latency starts once the whole request is received
+	const double start = now_us();
+
+	struct DaemonReply reply = {MH_OK, 0};
+	struct DaemonStats stats;
+	const float threshold = request.threshold < 0 ? daemon->args.threshold : request.threshold;
+
+	matches->n_matches = 0;
+
+	switch (request.op) {
+
+		case DAEMON_OP_QUERY:
+			pthread_rwlock_rdlock(&daemon->index_lock);
+			reply.status = mh_index_query(daemon->index, request.doc_id, *p_buffer, request.size, threshold,
+										  collect_match, matches);
+			pthread_rwlock_unlock(&daemon->index_lock);
+			break;
+
+		case DAEMON_OP_INSERT:
+			// A document inserted by another client can't be missed in between
+			pthread_rwlock_wrlock(&daemon->index_lock);
+			reply.status = mh_index_query(daemon->index, request.doc_id, *p_buffer, request.size, threshold,
+										  collect_match, matches);
+			if (reply.status == MH_OK)
+				reply.status = mh_index_insert(daemon->index, request.doc_id, *p_buffer, request.size);
+			pthread_rwlock_unlock(&daemon->index_lock);
+			break;
+
+		case DAEMON_OP_STATS: {
+			struct LatencySummary summary;
+			latency_summary(&daemon->latency, &summary);
+
+			pthread_rwlock_rdlock(&daemon->index_lock);
+			stats.n_docs = mh_index_size(daemon->index);
+			pthread_rwlock_unlock(&daemon->index_lock);
+
+			stats.n_requests = summary.n_requests;
+			stats.latency_p50 = summary.p50;
+			stats.latency_p90 = summary.p90;
+			stats.latency_p99 = summary.p99;
+			stats.latency_p999 = summary.p999;
+			stats.latency_max = summary.max;
+			break;
+		}
+
+		default:
+			reply.status = MH_ERR_PARAMS;
+	}
+
+	if (reply.status == MH_OK)
+		reply.n_matches = matches->n_matches;
+
+	bool ok = write_full(fd, &reply, sizeof(reply));
+
+	if (ok && reply.status == MH_OK) {
+		if (request.op == DAEMON_OP_STATS)
+			ok = write_full(fd, &stats, sizeof(stats));
+		else
+			ok = write_full(fd, matches->p_matches, reply.n_matches * sizeof(struct DaemonMatch));
+	}
+
+	// Stats requests don't count
+	if (request.op != DAEMON_OP_STATS)
+		latency_record(&daemon->latency, now_us() - start);
+
+	return ok;
+}
+
+static int collect_match(int64_t doc1, int64_t doc2, float similarity, void *p_matches) {
+
+	(void) doc1;
+	struct MatchList *matches = (struct MatchList *) p_matches;
+
+	if (matches->n_matches == matches->capacity) {
+		matches->capacity = matches->capacity ? 2 * matches->capacity : 64;
+		matches->p_matches = realloc(matches->p_matches, matches->capacity * sizeof(struct DaemonMatch));
+	}
+
+	struct DaemonMatch *match = &matches->p_matches[matches->n_matches++];
+	match->doc_id = doc2;
+	match->similarity = similarity;
+	match->reserved = 0;
+
+	return 0;
+}
+
+static bool read_full(int fd, void *p_data, size_t size) {
+
+	char *p_dest = (char *) p_data;
+
+	while (size > 0) {
+		ssize_t n_read = read(fd, p_dest, size);
+
+		if (n_read < 0 && errno == EINTR)
+			continue;
+		if (n_read <= 0)
+			return false;
+
+		p_dest += n_read;
+		size -= n_read;
+	}
+
+	return true;
+}
+
+static bool write_full(int fd, const void *p_data, size_t size) {
+
+	const char *p_src = (const char *) p_data;
+
+	while (size > 0) {
+		ssize_t n_written = write(fd, p_src, size);
+
+		if (n_written < 0 && errno == EINTR)
+			continue;
+		if (n_written <= 0)
+			return false;
+
+		p_src += n_written;
+		size -= n_written;
+	}
+
+	return true;
+}
+
+static long read_file(const char *path, char **p_buffer, size_t *p_buffer_size) {
+
+	FILE *f_doc = fopen(path, "rb");
+
+	if (f_doc == NULL)
+		return -1;
+
+	fseek(f_doc, 0, SEEK_END);
+	long size = ftell(f_doc);
+	rewind(f_doc);
+
+	if (*p_buffer_size < (size_t) size + 1) {
+		*p_buffer_size = size + 1;
+		*p_buffer = realloc(*p_buffer, *p_buffer_size);
+	}
+
+	if (fread(*p_buffer, 1, size, f_doc) != (size_t) size)
+		size = -1;
+
+	fclose(f_doc);
+
+	return size;
+}
+
+static double now_us() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
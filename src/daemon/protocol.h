@@ -0,0 +1,78 @@
+#ifndef MULTICOREMINHASH_PROTOCOL_H
+#define MULTICOREMINHASH_PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * Binary protocol of the query daemon, over a local Unix socket (values in host byte order). <br>
+ * A client sends requests one after the other on the same connection, and gets one reply for each:
+ * - request: a DaemonRequest followed by `size` bytes of document content
+ * - reply: a DaemonReply followed by `n_matches` DaemonMatch (query and insert),
+ *   or by a DaemonStats (stats, if the status is MH_OK)
+ */
+
+// Identifies a request ("MHDQ")
+#define DAEMON_MAGIC 0x4d484451
+
+// Largest document accepted in a request
+#define DAEMON_MAX_DOC_SIZE (64 << 20)
+
+/**
+ * Operations of a request.
+ */
+enum DaemonOp {
+	// Find the indexed documents similar to the document
+	DAEMON_OP_QUERY = 1,
+	// Same as query, then add the document to the index (atomically)
+	DAEMON_OP_INSERT = 2,
+	// Get the index size and the latency percentiles (no document)
+	DAEMON_OP_STATS = 3
+};
+
+/**
+ * Header of a request.
+ */
+struct DaemonRequest {
+	uint32_t magic;
+	uint32_t op;
+	// Identifier of the document (given back as doc_id of the matches when inserted)
+	int64_t doc_id;
+	// Minimum similarity of the matches (negative to use the daemon's threshold)
+	float threshold;
+	// Number of bytes of document content following the header
+	uint32_t size;
+};
+
+/**
+ * Header of a reply.
+ */
+struct DaemonReply {
+	// MH_OK or a negative libminhash error code (MH_ERR_PARAMS for malformed requests)
+	int32_t status;
+	uint32_t n_matches;
+};
+
+/**
+ * An indexed document similar to the requested one.
+ */
+struct DaemonMatch {
+	int64_t doc_id;
+	float similarity;
+	uint32_t reserved;
+};
+
+/**
+ * Reply of a stats request. Latencies are in microseconds, measured from the end of a request's reception
+ * to the end of its reply, over the last requests.
+ */
+struct DaemonStats {
+	uint64_t n_docs;
+	uint64_t n_requests;
+	double latency_p50;
+	double latency_p90;
+	double latency_p99;
+	double latency_p999;
+	double latency_max;
+};
+
+#endif //MULTICOREMINHASH_PROTOCOL_H
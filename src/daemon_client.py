@@ -0,0 +1,104 @@
+import argparse
+import socket
+import struct
+import time
+from typing import List, Tuple
+
+parser = argparse.ArgumentParser(
+	description="Send documents to the MinHash query daemon and print the similar indexed documents."
+)
+
+parser.add_argument(
+	"-s", "--socket",
+	type=str,
+	default="minhashd.sock",
+	help="Path of the daemon's Unix socket",
+)
+parser.add_argument(
+	"-t", "--threshold",
+	type=float,
+	default=-1,
+	help="Minimum similarity of the matches (the daemon's threshold if negative)",
+)
+parser.add_argument(
+	"-i", "--insert",
+	action="store_true",
+	help="Add the documents to the index after querying them",
+)
+parser.add_argument(
+	"--stats",
+	action="store_true",
+	help="Print the index size and the daemon's latency percentiles",
+)
+parser.add_argument(
+	"documents",
+	type=str,
+	nargs="*",
+	help="Paths of the documents (their id is the file name without extension, if numeric)",
+)
+
+# Must match src/daemon/protocol.h
+DAEMON_MAGIC = 0x4d484451
+OP_QUERY, OP_INSERT, OP_STATS = 1, 2, 3
+REQUEST = struct.Struct("=IIqfI")
+REPLY = struct.Struct("=iI")
+MATCH = struct.Struct("=qfI")
+STATS = struct.Struct("=QQddddd")
+
+
+def recv_full(conn: socket.socket, size: int) -> bytes:
+	data = b""
+	while len(data) < size:
+		chunk = conn.recv(size - len(data))
+		if not chunk:
+			raise ConnectionError("Connection closed by the daemon")
+		data += chunk
+	return data
+
+
+def request(conn: socket.socket, op: int, doc_id: int = -1, threshold: float = -1, content: bytes = b"") \
+		-> Tuple[int, bytes]:
+	conn.sendall(REQUEST.pack(DAEMON_MAGIC, op, doc_id, threshold, len(content)) + content)
+	status, n_matches = REPLY.unpack(recv_full(conn, REPLY.size))
+
+	if status != 0:
+		return status, b""
+	if op == OP_STATS:
+		return status, recv_full(conn, STATS.size)
+	return status, recv_full(conn, n_matches * MATCH.size)
+
+
+def query(conn: socket.socket, doc_id: int, content: bytes, threshold: float, insert: bool) \
+		-> List[Tuple[int, float]]:
+	status, data = request(conn, OP_INSERT if insert else OP_QUERY, doc_id, threshold, content)
+	if status != 0:
+		raise RuntimeError(f"Request failed with status {status}")
+	return [MATCH.unpack_from(data, k * MATCH.size)[:2] for k in range(len(data) // MATCH.size)]
+
+
+if __name__ == "__main__":
+	args = parser.parse_args()
+
+	with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as conn:
+		conn.connect(args.socket)
+
+		for k, path in enumerate(args.documents):
+			name = path.rsplit("/", 1)[-1].split(".")[0]
+			doc_id = int(name) if name.isdigit() else -1 - k
+
+			with open(path, "rb") as f:
+				content = f.read()
+
+			start = time.perf_counter()
+			matches = query(conn, doc_id, content, args.threshold, args.insert)
+			elapsed = (time.perf_counter() - start) * 1e6
+
+			print(f"{path}: {len(matches)} matches ({elapsed:.0f} us round trip)")
+			for match_id, similarity in sorted(matches, key=lambda m: -m[1]):
+				print(f"  {match_id},{similarity:.4f}")
+
+		if args.stats:
+			_, data = request(conn, OP_STATS)
+			n_docs, n_requests, p50, p90, p99, p999, p_max = STATS.unpack(data)
+			print(f"Documents: {n_docs}, requests: {n_requests}")
+			print(f"Latency (us): p50 {p50:.1f}, p90 {p90:.1f}, p99 {p99:.1f}, p99.9 {p999:.1f}, max {p_max:.1f}")
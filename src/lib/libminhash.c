@@ -0,0 +1,612 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "libminhash.h"
+#include "lsh_buckets.h"
+#include "signature.h"
+#include "utils.h"
+
+// Identifies an index file ("MHIX" and format version)
+#define INDEX_MAGIC 0x4d484958
+#define INDEX_VERSION 1
+
+// Documents inserted after finalizing are bucketed again once they are more than
+// this many, or more than 1/INDEX_TAIL_FRACTION of the bucketed ones
+#define INDEX_TAIL_MIN 1024
+#define INDEX_TAIL_FRACTION 8
+
+/**
+ * Memory needed to compute a signature, reused across documents.
+ * Each concurrent add or query takes one from the index pool.
+ */
+struct Scratch {
+	struct Tokens tokens;
+	struct ShingleSet dedup;
+	uint32_t *signature;
+	uint64_t *bands;
+	// Next free scratch in the pool
+	struct Scratch *next;
+};
+
+struct MinHashIndex {
+	struct MinHashParams params;
+	int n_bands;
+	// Hot loops selected for the parameters
+	const struct Kernels *kernels;
+	// Signature rows and identifiers of the added documents
+	uint32_t *p_signatures;
+	int64_t *p_ids;
+	int n_docs;
+	int capacity;
+	// Bands matrix and buckets, built when finalizing.
+	// Documents inserted afterwards (from buckets.n_docs on) are scanned until they are bucketed
+	uint64_t *p_bands;
+	struct LshBuckets buckets;
+	bool finalized;
+	// Pool of free scratch memory
+	struct Scratch *free_scratch;
+	// Guards the documents and the pool
+	pthread_mutex_t lock;
+};
+
+/**
+ * Take scratch memory from the pool, allocating it if the pool is empty. Returns NULL if out of memory.
+ */
+static struct Scratch *scratch_take(struct MinHashIndex *index);
+
+/**
+ * Give scratch memory back to the pool.
+ */
+static void scratch_give(struct MinHashIndex *index, struct Scratch *scratch);
+
+/**
+ * Make room for one more document (the lock must be held). Returns MH_OK or MH_ERR_MEMORY.
+ */
+static int grow_rows(struct MinHashIndex *index);
+
+/**
+ * Compute the bands of the documents from first_doc on.
+ */
+static void compute_bands(struct MinHashIndex *index, int first_doc);
+
+/**
+ * Bucket all the documents again, including the inserted ones. Returns false if out of memory.
+ */
+static bool rebucket(struct MinHashIndex *index);
+
+/**
+ * Compute the signature and the band keys of a document into the scratch memory.
+ */
+static void compute_document(const struct MinHashIndex *index, struct Scratch *scratch, const char *data,
+							 size_t size);
+
+/**
+ * Returns the first band where two documents have the same key (n_bands if none).
+ */
+static int first_equal_band(const uint64_t *p_bands1, const uint64_t *p_bands2, int n_bands);
+
+void mh_params_default(struct MinHashParams *params) {
+
+	params->shingle_size = 3;
+	params->shingle_chars = 0;
+	params->signature_size = 100;
+	params->band_rows = 4;
+	params->seed = 13;
+	params->dedup = 0;
+	params->band_mix64 = 0;
+
+}
+
+int mh_index_create(const struct MinHashParams *params, struct MinHashIndex **pp_index) {
+
+	// Check that bands fill the signature
+	if (params->shingle_size < 1 || params->signature_size < 1 || params->band_rows < 1 ||
+		params->signature_size % params->band_rows != 0)
+		return MH_ERR_PARAMS;
+
+	struct MinHashIndex *index = calloc(1, sizeof(struct MinHashIndex));
+
+	if (index == NULL)
+		return MH_ERR_MEMORY;
+
+	index->params = *params;
+	index->n_bands = params->signature_size / params->band_rows;
+	index->kernels = kernels_select(params->signature_size, params->band_rows,
+									params->band_mix64 ? BANDKEY_MIX64 : BANDKEY_XOR, HASH_MURMUR2);
+	pthread_mutex_init(&index->lock, NULL);
+
+	*pp_index = index;
+	return MH_OK;
+}
+
+void mh_index_destroy(struct MinHashIndex *index) {
+
+	if (index == NULL)
+		return;
+
+	while (index->free_scratch) {
+		struct Scratch *scratch = index->free_scratch;
+		index->free_scratch = scratch->next;
+
+		tokens_free(&scratch->tokens);
+		shingle_set_free(&scratch->dedup);
+		free(scratch->signature);
+		free(scratch->bands);
+		free(scratch);
+	}
+
+	lsh_buckets_free(&index->buckets);
+	pthread_mutex_destroy(&index->lock);
+	free(index->p_signatures);
+	free(index->p_ids);
+	free(index->p_bands);
+	free(index);
+
+}
+
+int mh_index_add(struct MinHashIndex *index, int64_t doc_id, const char *data, size_t size) {
+
+	const int signature_size = index->params.signature_size;
+
+	struct Scratch *scratch = scratch_take(index);
+
+	if (scratch == NULL)
+		return MH_ERR_MEMORY;
+
+	// Hash the document outside the lock
+	compute_document(index, scratch, data, size);
+
+	int error = MH_OK;
+
+	pthread_mutex_lock(&index->lock);
+
+	if (index->finalized)
+		error = MH_ERR_STATE;
+
+	if (error == MH_OK)
+		error = grow_rows(index);
+
+	if (error == MH_OK) {
+		memcpy(index->p_signatures + (size_t) index->n_docs * signature_size, scratch->signature,
+			   signature_size * sizeof(uint32_t));
+		index->p_ids[index->n_docs++] = doc_id;
+	}
+
+	pthread_mutex_unlock(&index->lock);
+
+	scratch_give(index, scratch);
+
+	return error;
+}
+
+int mh_index_finalize(struct MinHashIndex *index) {
+
+	pthread_mutex_lock(&index->lock);
+
+	// Later adds are rejected
+	const bool finalized = index->finalized;
+	index->finalized = true;
+
+	pthread_mutex_unlock(&index->lock);
+
+	if (finalized)
+		return MH_ERR_STATE;
+
+	// Bands have the same capacity as the signatures, for later inserts
+	index->p_bands = malloc((size_t) index->capacity * index->n_bands * sizeof(uint64_t) + 1);
+
+	if (index->p_bands == NULL)
+		return MH_ERR_MEMORY;
+
+	compute_bands(index, 0);
+
+	if (!lsh_buckets_build(&index->buckets, index->p_bands, index->n_docs, index->n_bands))
+		return MH_ERR_MEMORY;
+
+	return MH_OK;
+}
+
+int mh_index_insert(struct MinHashIndex *index, int64_t doc_id, const char *data, size_t size) {
+
+	if (!index->finalized || index->buckets.p_entries == NULL)
+		return MH_ERR_STATE;
+
+	const int signature_size = index->params.signature_size;
+
+	struct Scratch *scratch = scratch_take(index);
+
+	if (scratch == NULL)
+		return MH_ERR_MEMORY;
+
+	compute_document(index, scratch, data, size);
+
+	pthread_mutex_lock(&index->lock);
+
+	int error = grow_rows(index);
+
+	if (error == MH_OK) {
+
+		const int i = index->n_docs++;
+
+		memcpy(index->p_signatures + (size_t) i * signature_size, scratch->signature,
+			   signature_size * sizeof(uint32_t));
+		memcpy(index->p_bands + (size_t) i * index->n_bands, scratch->bands, index->n_bands * sizeof(uint64_t));
+		index->p_ids[i] = doc_id;
+
+		// Scanning the unbucketed documents must stay cheap compared to a lookup
+		const int n_tail = index->n_docs - index->buckets.n_docs;
+		if (n_tail > INDEX_TAIL_MIN && n_tail > index->buckets.n_docs / INDEX_TAIL_FRACTION && !rebucket(index))
+			error = MH_ERR_MEMORY;
+	}
+
+	pthread_mutex_unlock(&index->lock);
+
+	scratch_give(index, scratch);
+
+	return error;
+}
+
+int mh_index_save(const struct MinHashIndex *index, const char *path) {
+
+	if (!index->finalized)
+		return MH_ERR_STATE;
+
+	FILE *f_index = fopen(path, "wb");
+
+	if (f_index == NULL)
+		return MH_ERR_IO;
+
+	const uint32_t header[2] = {INDEX_MAGIC, INDEX_VERSION};
+	const int64_t n_docs = index->n_docs;
+	const size_t n_values = (size_t) index->n_docs * index->params.signature_size;
+
+	// Bands and buckets are computed again when loading
+	bool ok = fwrite(header, sizeof(header), 1, f_index) == 1 &&
+			  fwrite(&index->params, sizeof(struct MinHashParams), 1, f_index) == 1 &&
+			  fwrite(&n_docs, sizeof(n_docs), 1, f_index) == 1 &&
+			  fwrite(index->p_ids, sizeof(int64_t), n_docs, f_index) == (size_t) n_docs &&
+			  fwrite(index->p_signatures, sizeof(uint32_t), n_values, f_index) == n_values;
+
+	if (fclose(f_index) != 0)
+		ok = false;
+
+	return ok ? MH_OK : MH_ERR_IO;
+}
+
+int mh_index_load(const char *path, struct MinHashIndex **pp_index) {
+
+	FILE *f_index = fopen(path, "rb");
+
+	if (f_index == NULL)
+		return MH_ERR_IO;
+
+	uint32_t header[2];
+	struct MinHashParams params;
+	int64_t n_docs;
+
+	if (fread(header, sizeof(header), 1, f_index) != 1 || header[0] != INDEX_MAGIC || header[1] != INDEX_VERSION ||
+		fread(&params, sizeof(params), 1, f_index) != 1 ||
+		fread(&n_docs, sizeof(n_docs), 1, f_index) != 1 || n_docs < 0 || n_docs > INT32_MAX) {
+		fclose(f_index);
+		return MH_ERR_IO;
+	}
+
+	struct MinHashIndex *index;
+	int error = mh_index_create(&params, &index);
+
+	if (error != MH_OK) {
+		fclose(f_index);
+		return error;
+	}
+
+	const size_t n_values = (size_t) n_docs * params.signature_size;
+
+	index->capacity = (int) n_docs;
+	index->p_ids = malloc(n_docs * sizeof(int64_t) + 1);
+	index->p_signatures = malloc(n_values * sizeof(uint32_t) + 1);
+
+	if (index->p_ids == NULL || index->p_signatures == NULL)
+		error = MH_ERR_MEMORY;
+	else if (fread(index->p_ids, sizeof(int64_t), n_docs, f_index) != (size_t) n_docs ||
+			 fread(index->p_signatures, sizeof(uint32_t), n_values, f_index) != n_values)
+		error = MH_ERR_IO;
+
+	fclose(f_index);
+
+	if (error == MH_OK) {
+		index->n_docs = (int) n_docs;
+		error = mh_index_finalize(index);
+	}
+
+	if (error != MH_OK) {
+		mh_index_destroy(index);
+		return error;
+	}
+
+	*pp_index = index;
+	return MH_OK;
+}
+
+size_t mh_index_size(const struct MinHashIndex *index) {
+	return index->n_docs;
+}
+
+int mh_index_compare(const struct MinHashIndex *index, float threshold, mh_result_fn callback, void *user_data) {
+
+	if (!index->finalized || index->buckets.p_entries == NULL)
+		return MH_ERR_STATE;
+
+	const int n_bands = index->n_bands;
+	const int signature_size = index->params.signature_size;
+	const struct Kernels *kernels = index->kernels;
+
+	const int n_bucketed = index->buckets.n_docs;
+
+	// Scan the buckets of every band
+	for (int j = 0; j < n_bands; ++j) {
+
+		const struct LshEntry *p_band = lsh_buckets_band(&index->buckets, j);
+
+		for (int start = 0, end; start < n_bucketed; start = end) {
+
+			// Bucket: run of entries with the same key
+			for (end = start + 1; end < n_bucketed && p_band[end].key == p_band[start].key; ++end);
+
+			// Pairs of the bucket (documents are sorted, so x < y)
+			for (int a = start; a < end; ++a)
+				for (int b = a + 1; b < end; ++b) {
+
+					const int x = p_band[a].doc;
+					const int y = p_band[b].doc;
+
+					// Report each pair only in the first band the documents share
+					if (first_equal_band(index->p_bands + (size_t) x * n_bands,
+										 index->p_bands + (size_t) y * n_bands, j) < j)
+						continue;
+
+					float similarity = kernels->signature_similarity(index->p_signatures + (size_t) x * signature_size,
+																		index->p_signatures + (size_t) y * signature_size,
+																		signature_size);
+
+					if (similarity >= threshold && callback(index->p_ids[x], index->p_ids[y], similarity, user_data))
+						return MH_ERR_STOPPED;
+				}
+		}
+	}
+
+	// Pairs with an inserted document that is not bucketed yet
+	for (int y = n_bucketed; y < index->n_docs; ++y)
+		for (int x = 0; x < y; ++x) {
+
+			if (first_equal_band(index->p_bands + (size_t) x * n_bands,
+								 index->p_bands + (size_t) y * n_bands, n_bands) == n_bands)
+				continue;
+
+			float similarity = kernels->signature_similarity(index->p_signatures + (size_t) x * signature_size,
+																index->p_signatures + (size_t) y * signature_size,
+																signature_size);
+
+			if (similarity >= threshold && callback(index->p_ids[x], index->p_ids[y], similarity, user_data))
+				return MH_ERR_STOPPED;
+		}
+
+	return MH_OK;
+}
+
+int mh_index_query(const struct MinHashIndex *index, int64_t query_id, const char *data, size_t size,
+				   float threshold, mh_result_fn callback, void *user_data) {
+
+	if (!index->finalized || index->buckets.p_entries == NULL)
+		return MH_ERR_STATE;
+
+	const int n_bands = index->n_bands;
+	const int signature_size = index->params.signature_size;
+	const struct Kernels *kernels = index->kernels;
+
+	// The pool is the only mutable part of a finalized index
+	struct MinHashIndex *pool = (struct MinHashIndex *) index;
+	struct Scratch *scratch = scratch_take(pool);
+
+	if (scratch == NULL)
+		return MH_ERR_MEMORY;
+
+	compute_document(index, scratch, data, size);
+
+	int error = MH_OK;
+
+	// Documents in the buckets of the query bands
+	for (int j = 0; j < n_bands && error == MH_OK; ++j) {
+
+		int count;
+		const struct LshEntry *p_bucket = lsh_buckets_find(&index->buckets, j, scratch->bands[j], &count);
+
+		for (int k = 0; k < count; ++k) {
+
+			const int d = p_bucket[k].doc;
+
+			// Report each document only in the first band it shares with the query
+			if (first_equal_band(scratch->bands, index->p_bands + (size_t) d * n_bands, j) < j)
+				continue;
+
+			float similarity = kernels->signature_similarity(scratch->signature,
+																index->p_signatures + (size_t) d * signature_size,
+																signature_size);
+
+			if (similarity >= threshold && callback(query_id, index->p_ids[d], similarity, user_data)) {
+				error = MH_ERR_STOPPED;
+				break;
+			}
+		}
+	}
+
+	// Inserted documents that are not bucketed yet
+	for (int d = index->buckets.n_docs; d < index->n_docs && error == MH_OK; ++d) {
+
+		if (first_equal_band(scratch->bands, index->p_bands + (size_t) d * n_bands, n_bands) == n_bands)
+			continue;
+
+		float similarity = kernels->signature_similarity(scratch->signature,
+															index->p_signatures + (size_t) d * signature_size,
+															signature_size);
+
+		if (similarity >= threshold && callback(query_id, index->p_ids[d], similarity, user_data))
+			error = MH_ERR_STOPPED;
+	}
+
+	scratch_give(pool, scratch);
+
+	return error;
+}
+
+const char *mh_strerror(int error) {
+
+	switch (error) {
+		case MH_OK:
+			return "Success";
+		case MH_ERR_PARAMS:
+			return "Invalid parameters";
+		case MH_ERR_STATE:
+			return "Operation not allowed in the current state of the index";
+		case MH_ERR_MEMORY:
+			return "Out of memory";
+		case MH_ERR_STOPPED:
+			return "Stopped by the callback";
+		case MH_ERR_IO:
+			return "Error reading or writing the index file";
+		default:
+			return "Unknown error";
+	}
+
+}
+
+static int grow_rows(struct MinHashIndex *index) {
+
+	if (index->n_docs < index->capacity)
+		return MH_OK;
+
+	// Grow the rows geometrically
+	const int capacity = index->capacity ? 2 * index->capacity : 64;
+
+	uint32_t *p_signatures = realloc(index->p_signatures,
+									 (size_t) capacity * index->params.signature_size * sizeof(uint32_t));
+	if (p_signatures == NULL)
+		return MH_ERR_MEMORY;
+	index->p_signatures = p_signatures;
+
+	int64_t *p_ids = realloc(index->p_ids, capacity * sizeof(int64_t));
+	if (p_ids == NULL)
+		return MH_ERR_MEMORY;
+	index->p_ids = p_ids;
+
+	// Bands exist only once finalized
+	if (index->p_bands) {
+		uint64_t *p_bands = realloc(index->p_bands, (size_t) capacity * index->n_bands * sizeof(uint64_t));
+		if (p_bands == NULL)
+			return MH_ERR_MEMORY;
+		index->p_bands = p_bands;
+	}
+
+	index->capacity = capacity;
+	return MH_OK;
+}
+
+static void compute_bands(struct MinHashIndex *index, int first_doc) {
+
+	const int n_bands = index->n_bands;
+	const int band_rows = index->params.band_rows;
+
+	for (int i = first_doc; i < index->n_docs; ++i)
+		index->kernels->compute_bands(index->p_signatures + (size_t) i * index->params.signature_size,
+									  index->p_bands + (size_t) i * n_bands, band_rows, n_bands);
+
+}
+
+static bool rebucket(struct MinHashIndex *index) {
+
+	struct LshBuckets buckets;
+
+	// The old buckets stay valid if memory runs out
+	if (!lsh_buckets_build(&buckets, index->p_bands, index->n_docs, index->n_bands))
+		return false;
+
+	lsh_buckets_free(&index->buckets);
+	index->buckets = buckets;
+
+	return true;
+}
+
+static struct Scratch *scratch_take(struct MinHashIndex *index) {
+
+	pthread_mutex_lock(&index->lock);
+
+	struct Scratch *scratch = index->free_scratch;
+	if (scratch)
+		index->free_scratch = scratch->next;
+
+	pthread_mutex_unlock(&index->lock);
+
+	if (scratch)
+		return scratch;
+
+	// Pool is empty, one more thread is adding or querying
+	scratch = calloc(1, sizeof(struct Scratch));
+	if (scratch == NULL)
+		return NULL;
+
+	scratch->signature = malloc(index->params.signature_size * sizeof(uint32_t));
+	scratch->bands = malloc(index->n_bands * sizeof(uint64_t));
+
+	if (scratch->signature == NULL || scratch->bands == NULL) {
+		free(scratch->signature);
+		free(scratch->bands);
+		free(scratch);
+		return NULL;
+	}
+
+	return scratch;
+}
+
+static void scratch_give(struct MinHashIndex *index, struct Scratch *scratch) {
+
+	pthread_mutex_lock(&index->lock);
+
+	scratch->next = index->free_scratch;
+	index->free_scratch = scratch;
+
+	pthread_mutex_unlock(&index->lock);
+
+}
+
+static void compute_document(const struct MinHashIndex *index, struct Scratch *scratch, const char *data,
+							 size_t size) {
+
+	const struct MinHashParams *params = &index->params;
+
+	mh_document_signature(
+			data,
+			size,
+			&scratch->tokens,
+			params->dedup ? &scratch->dedup : NULL,
+			params->shingle_size,
+			params->shingle_chars ? SHINGLE_CHARS : SHINGLE_WORDS,
+			scratch->signature,
+			params->signature_size,
+			params->seed,
+			index->kernels
+	);
+
+	index->kernels->compute_bands(scratch->signature, scratch->bands, params->band_rows, index->n_bands);
+
+}
+
+static int first_equal_band(const uint64_t *p_bands1, const uint64_t *p_bands2, int n_bands) {
+
+	int j;
+	for (j = 0; j < n_bands && p_bands1[j] != p_bands2[j]; ++j);
+
+	return j;
+}
@@ -0,0 +1,193 @@
+#ifndef LIBMINHASH_H
+#define LIBMINHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exported from the shared library (everything else is hidden)
+#define MH_API __attribute__((visibility("default")))
+
+/**
+ * Error codes returned by the library (0 = success).
+ */
+enum MinHashError {
+	MH_OK = 0,
+	// Invalid parameters
+	MH_ERR_PARAMS = -1,
+	// Operation not allowed in the current state of the index (e.g. adding after finalizing)
+	MH_ERR_STATE = -2,
+	// Memory allocation failed
+	MH_ERR_MEMORY = -3,
+	// Stopped by the result callback
+	MH_ERR_STOPPED = -4,
+	// Index file missing, unreadable or not written
+	MH_ERR_IO = -5
+};
+
+/**
+ * Parameters of an index, fixed at creation.
+ */
+struct MinHashParams {
+	// How many words (or characters) in a shingle
+	int shingle_size;
+	// Whether shingles are made of characters (1) or words (0)
+	int shingle_chars;
+	// Number of hashes in a signature
+	int signature_size;
+	// Number of rows in each band (must divide the signature size)
+	int band_rows;
+	// Hash function seed
+	int seed;
+	// Whether repeated shingles of a document are hashed only once (same signatures, less work)
+	int dedup;
+	// Whether band keys mix the ordered rows (1) or XOR them (0)
+	int band_mix64;
+};
+
+/**
+ * Index of documents: documents are added (concurrently if needed), then the index is finalized
+ * and can be compared with itself or queried with other documents. <br>
+ * Adding is thread-safe. Once finalized, comparing / querying are thread-safe too, and documents can still be
+ * inserted one at a time (inserts must not run along with comparisons or queries).
+ */
+struct MinHashIndex;
+
+/**
+ * Called for every pair of documents above the similarity threshold.
+ *
+ * @param doc1 Identifier of the first document (the query one, when querying)
+ * @param doc2 Identifier of the second document
+ * @param similarity Estimated Jaccard similarity of the two documents
+ * @param user_data Pointer given along with the callback
+ * @return 0 to continue, anything else to stop (the call then returns MH_ERR_STOPPED)
+ */
+typedef int (*mh_result_fn)(int64_t doc1, int64_t doc2, float similarity, void *user_data);
+
+/**
+ * Fill the parameters with the defaults of the command line program.
+ *
+ * @param params Parameters to fill
+ */
+MH_API void mh_params_default(struct MinHashParams *params);
+
+/**
+ * Create an empty index.
+ *
+ * @param params Parameters of the index (copied)
+ * @param pp_index Where to store the created index, to be destroyed with mh_index_destroy
+ * @return MH_OK, MH_ERR_PARAMS or MH_ERR_MEMORY
+ */
+MH_API int mh_index_create(const struct MinHashParams *params, struct MinHashIndex **pp_index);
+
+/**
+ * Destroy an index and free its memory.
+ *
+ * @param index The index (can be NULL)
+ */
+MH_API void mh_index_destroy(struct MinHashIndex *index);
+
+/**
+ * Compute the signature of a document and add it to the index. <br>
+ * The buffer is read in place (no copy is made) and can be reused as soon as the call returns.
+ * It doesn't need to be null-terminated. Can be called by several threads at once.
+ *
+ * @param index The index
+ * @param doc_id Identifier of the document, given back in the results
+ * @param data Content of the document
+ * @param size Number of bytes in data
+ * @return MH_OK, MH_ERR_STATE (already finalized) or MH_ERR_MEMORY
+ */
+MH_API int mh_index_add(struct MinHashIndex *index, int64_t doc_id, const char *data, size_t size);
+
+/**
+ * Compute the bands of the added documents and their LSH buckets. No document can be added afterwards.
+ *
+ * @param index The index
+ * @return MH_OK, MH_ERR_STATE (already finalized) or MH_ERR_MEMORY
+ */
+MH_API int mh_index_finalize(struct MinHashIndex *index);
+
+/**
+ * Add a document to a finalized index, so that later comparisons and queries find it. <br>
+ * Inserted documents are scanned until enough of them are gathered, then all the buckets are built again.
+ * Must not be called while another thread is comparing or querying the index.
+ *
+ * @param index The finalized index
+ * @param doc_id Identifier of the document, given back in the results
+ * @param data Content of the document
+ * @param size Number of bytes in data
+ * @return MH_OK, MH_ERR_STATE (not finalized) or MH_ERR_MEMORY
+ */
+MH_API int mh_index_insert(struct MinHashIndex *index, int64_t doc_id, const char *data, size_t size);
+
+/**
+ * Save a finalized index to a file (parameters, identifiers and signatures).
+ *
+ * @param index The finalized index
+ * @param path Path of the file
+ * @return MH_OK, MH_ERR_STATE (not finalized) or MH_ERR_IO
+ */
+MH_API int mh_index_save(const struct MinHashIndex *index, const char *path);
+
+/**
+ * Load an index saved with mh_index_save. The loaded index is finalized.
+ *
+ * @param path Path of the file
+ * @param pp_index Where to store the loaded index, to be destroyed with mh_index_destroy
+ * @return MH_OK, MH_ERR_IO (missing or invalid file), MH_ERR_PARAMS or MH_ERR_MEMORY
+ */
+MH_API int mh_index_load(const char *path, struct MinHashIndex **pp_index);
+
+/**
+ * Returns the number of documents in the index.
+ *
+ * @param index The index
+ * @return Number of added documents
+ */
+MH_API size_t mh_index_size(const struct MinHashIndex *index);
+
+/**
+ * Find all pairs of indexed documents sharing at least one band, and report the ones above the threshold.
+ * Each pair is reported once.
+ *
+ * @param index The finalized index
+ * @param threshold Minimum similarity of the reported pairs
+ * @param callback Function called for each pair above the threshold
+ * @param user_data Pointer given to the callback
+ * @return MH_OK, MH_ERR_STATE (not finalized), MH_ERR_MEMORY or MH_ERR_STOPPED
+ */
+MH_API int mh_index_compare(const struct MinHashIndex *index, float threshold, mh_result_fn callback, void *user_data);
+
+/**
+ * Find the indexed documents similar to a document that is not added to the index.
+ * The buffer is read in place, as in mh_index_add.
+ *
+ * @param index The finalized index
+ * @param query_id Identifier of the query document, given back as first document of the results
+ * @param data Content of the query document
+ * @param size Number of bytes in data
+ * @param threshold Minimum similarity of the reported documents
+ * @param callback Function called for each indexed document above the threshold
+ * @param user_data Pointer given to the callback
+ * @return MH_OK, MH_ERR_STATE (not finalized), MH_ERR_MEMORY or MH_ERR_STOPPED
+ */
+MH_API int mh_index_query(const struct MinHashIndex *index, int64_t query_id, const char *data, size_t size,
+				   float threshold, mh_result_fn callback, void *user_data);
+
+/**
+ * Returns a description of an error code.
+ *
+ * @param error Error code
+ * @return Static string describing the error
+ */
+MH_API const char *mh_strerror(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBMINHASH_H
@@ -0,0 +1,71 @@
+import argparse
+import gzip
+import os
+
+parser = argparse.ArgumentParser(
+	description="Pack the documents of a directory in a single file, read with --pack (and --compression)."
+)
+
+parser.add_argument(
+	"-c", "--compression",
+	type=str,
+	choices=["none", "gzip", "zstd"],
+	default="none",
+	help="Compression of each document in the pack (each one is compressed on its own)",
+)
+parser.add_argument(
+	"--docs",
+	type=int,
+	default=0,
+	help="Number of documents to take from the directory (all if 0)",
+)
+parser.add_argument(
+	"--offset",
+	type=int,
+	default=0,
+	help="Number of the first document to take from the directory",
+)
+parser.add_argument(
+	"directory",
+	type=str,
+	help="Directory of the documents (<number>.txt, as for the other modes)",
+)
+parser.add_argument(
+	"output",
+	type=str,
+	help="Pack to write (its index is written to <output>.idx)",
+)
+
+args = parser.parse_args()
+
+if args.compression == "zstd":
+	import zstandard
+
+	compress = zstandard.ZstdCompressor().compress
+elif args.compression == "gzip":
+	compress = lambda data: gzip.compress(data, mtime=0)
+else:
+	compress = lambda data: data
+
+doc_number = args.offset
+offset = 0
+
+with open(args.output, "wb") as pack, open(args.output + ".idx", "w") as index:
+
+	while args.docs == 0 or doc_number < args.offset + args.docs:
+
+		path = os.path.join(args.directory, f"{doc_number}.txt")
+
+		if not os.path.exists(path):
+			break
+
+		with open(path, "rb") as document:
+			data = compress(document.read())
+
+		# Must match src/OMP/doc_loader.h: document number, offset and size in bytes
+		pack.write(data)
+		index.write(f"{doc_number} {offset} {len(data)}\n")
+		offset += len(data)
+		doc_number += 1
+
+print(f"Packed {doc_number - args.offset} documents ({offset} bytes) in {args.output}")
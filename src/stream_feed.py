@@ -0,0 +1,69 @@
+import argparse
+import os
+import struct
+import sys
+import time
+
+parser = argparse.ArgumentParser(
+	description="Write documents as length-prefixed records, the input of the streaming mode (--stream)."
+)
+
+parser.add_argument(
+	"-o", "--output",
+	type=str,
+	default="-",
+	help="FIFO or file where to write the records (- for the standard output)",
+)
+parser.add_argument(
+	"-r", "--rate",
+	type=float,
+	default=0,
+	help="Documents per second (0 to write them as fast as possible)",
+)
+parser.add_argument(
+	"--docs",
+	type=int,
+	default=0,
+	help="Number of documents to take from the directory (all if 0)",
+)
+parser.add_argument(
+	"--offset",
+	type=int,
+	default=0,
+	help="Number of the first document to take from the directory",
+)
+parser.add_argument(
+	"directory",
+	type=str,
+	help="Directory of the documents (<number>.txt, as for the other modes)",
+)
+
+args = parser.parse_args()
+
+output = sys.stdout.buffer if args.output == "-" else open(args.output, "wb")
+doc_number = args.offset
+start = time.monotonic()
+
+while args.docs == 0 or doc_number < args.offset + args.docs:
+
+	path = os.path.join(args.directory, f"{doc_number}.txt")
+
+	if not os.path.exists(path):
+		break
+
+	with open(path, "rb") as document:
+		data = document.read()
+
+	# Keep the requested rate
+	if args.rate > 0:
+		delay = start + (doc_number - args.offset) / args.rate - time.monotonic()
+		if delay > 0:
+			time.sleep(delay)
+
+	# Must match src/OMP/stream.h: 32-bit little-endian length, then the document
+	output.write(struct.pack("<I", len(data)) + data)
+	output.flush()
+	doc_number += 1
+
+if output is not sys.stdout.buffer:
+	output.close()